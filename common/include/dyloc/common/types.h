@@ -118,6 +118,11 @@ typedef struct
 
     int   numa_id;
 
+    /** Distances from the unit's NUMA domain to all NUMA domains of the
+     *  host as in the ACPI SLIT (local distance is 10), indexed by the
+     *  logical NUMA index like \c numa_id, -1 if unknown. */
+    int   numa_distances[DYLOC_LOCALITY_MAX_NUMA_ID];
+
     /** The unit's affine core, unique identifier within a processing
      *  module. */
     int   core_id;
@@ -9,7 +9,7 @@ extern "C" {
 #endif
 
 
-dyloc_ret_t dyloc_init();
+dyloc_ret_t dyloc_init(int * argc, char *** argv);
 
 dyloc_ret_t dyloc_finalize();
 
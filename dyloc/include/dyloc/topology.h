@@ -8,7 +8,91 @@
 extern "C" {
 #endif
 
+/**
+ * Handle of a team's locality domain hierarchy.
+ *
+ * The hierarchy is stored as a single array of domain records in
+ * breadth-first order, the root domain first and subdomains of every
+ * domain at consecutive positions. Pointers in domain records (\c parent,
+ * \c children, \c aliases, \c unit_ids) refer to buffers owned by the
+ * handle, domains can be traversed without any allocation or call into
+ * the library.
+ *
+ * The handle is a snapshot of the team's topology at the time it was
+ * created and remains valid until \c dyloc_topology_destroy.
+ *
+ * Example:
+ *
+ * \code
+ *   dyloc_topology_t                topo;
+ *   const dyloc_locality_domain_t * unit_domain;
+ *   const dyloc_locality_domain_t * numa_domain;
+ *   dyloc_team_topology(DART_TEAM_ALL, &topo);
+ *   dyloc_topology_unit_domain(topo, myid, &unit_domain);
+ *   for (numa_domain = unit_domain;
+ *        numa_domain != NULL &&
+ *        numa_domain->scope != DYLOC_LOCALITY_SCOPE_NUMA;
+ *        numa_domain = numa_domain->parent) { }
+ *   dyloc_topology_destroy(&topo);
+ * \endcode
+ */
+typedef struct dyloc_topology_s * dyloc_topology_t;
 
+/**
+ * Creates a snapshot of the locality domain hierarchy of the specified
+ * team.
+ */
+dyloc_ret_t dyloc_team_topology(
+  dart_team_t                       team,
+  dyloc_topology_t                * topo);
+
+dyloc_ret_t dyloc_topology_destroy(
+  dyloc_topology_t                * topo);
+
+/**
+ * All domains in the topology, the root domain at index 0.
+ */
+dyloc_ret_t dyloc_topology_domains(
+  dyloc_topology_t                  topo,
+  const dyloc_locality_domain_t  ** domains,
+  int                             * num_domains);
+
+/**
+ * Domain with the specified tag, \c DYLOC_ERR_INVALID if no such domain
+ * exists.
+ */
+dyloc_ret_t dyloc_topology_domain(
+  dyloc_topology_t                  topo,
+  const char                      * domain_tag,
+  const dyloc_locality_domain_t  ** domain);
+
+/**
+ * Domain of scope \c DYLOC_LOCALITY_SCOPE_UNIT of the specified unit.
+ */
+dyloc_ret_t dyloc_topology_unit_domain(
+  dyloc_topology_t                  topo,
+  dart_global_unit_t                unit_id,
+  const dyloc_locality_domain_t  ** domain);
+
+/**
+ * Domains in the specified scope in breadth-first order, \c num_domains
+ * is set to 0 if no domain in the scope exists.
+ */
+dyloc_ret_t dyloc_topology_scope_domains(
+  dyloc_topology_t                         topo,
+  dyloc_locality_scope_t                   scope,
+  const dyloc_locality_domain_t * const ** domains,
+  int                                    * num_domains);
+
+/**
+ * Lowest common ancestor of two domains in the topology, a domain is
+ * its own ancestor.
+ */
+dyloc_ret_t dyloc_topology_lca(
+  dyloc_topology_t                  topo,
+  const dyloc_locality_domain_t   * domain_a,
+  const dyloc_locality_domain_t   * domain_b,
+  const dyloc_locality_domain_t  ** lca);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -1,6 +0,0 @@
-
-#include <dyloc/topology.h>
-
-
-
-
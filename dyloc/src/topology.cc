@@ -0,0 +1,404 @@
+
+#include <dyloc/topology.h>
+
+#include <dyloc/common/types.h>
+
+#include <dylocxx/init.h>
+#include <dylocxx/topology.h>
+#include <dylocxx/exception.h>
+#include <dylocxx/adapter/dart.h>
+
+#include <dylocxx/internal/logging.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+struct dyloc_topology_s {
+  /// Domain records in breadth-first order.
+  std::vector<dyloc_locality_domain_t>   domains;
+  /// Children of all domains followed by aliases of all domains.
+  std::vector<dyloc_locality_domain_t *> domain_refs;
+  /// Unit ids of all domains.
+  std::vector<dart_global_unit_t>        unit_ids;
+  /// Domains ordered by tag.
+  std::vector<dyloc_locality_domain_t *> tag_index;
+  /// Domains ordered by scope, in breadth-first order within a scope.
+  std::vector<dyloc_locality_domain_t *> scope_index;
+  /// UNIT domains by global unit id.
+  std::vector<dyloc_locality_domain_t *> unit_index;
+};
+
+namespace {
+
+typedef dyloc::topology::graph_t        graph_t;
+typedef dyloc::topology::graph_vertex_t graph_vertex_t;
+
+struct scope_less {
+  bool operator()(const dyloc_locality_domain_t * d,
+                  dyloc_locality_scope_t          s) const {
+    return d->scope < s;
+  }
+  bool operator()(dyloc_locality_scope_t          s,
+                  const dyloc_locality_domain_t * d) const {
+    return s < d->scope;
+  }
+  bool operator()(const dyloc_locality_domain_t * a,
+                  const dyloc_locality_domain_t * b) const {
+    return a->scope < b->scope;
+  }
+};
+
+/*
+ * Size of shared memory from the hardware info of a domain's first unit,
+ * capacities in hardware info are in MB.
+ */
+int shared_mem_bytes(
+  const dyloc::topology                 & topo,
+  const dyloc::locality_domain          & domain,
+  const dyloc_locality_domain_t         & domain_rec) {
+  if (domain.unit_ids.empty() || domain_rec.node_id < 0) {
+    return 0;
+  }
+  dart_team_unit_t unit_lid;
+  unit_lid.id = domain.unit_ids[0].id;
+  if (domain.team != DART_TEAM_ALL) {
+    unit_lid = dyloc::g2l(domain.team, domain.unit_ids[0]);
+  }
+  const auto & unit_map = topo.unit_map();
+  if (unit_lid.id < 0 || unit_lid.id >= static_cast<int>(unit_map.size())) {
+    return 0;
+  }
+  const auto & unit_hwinfo = unit_map[unit_lid].data()->hwinfo;
+  long long shmem_mb = (domain.scope >= DYLOC_LOCALITY_SCOPE_NUMA)
+                       ? unit_hwinfo.numa_memory_bytes
+                       : unit_hwinfo.system_memory_bytes;
+  if (shmem_mb <= 0) {
+    return 0;
+  }
+  return static_cast<int>(std::min<long long>(shmem_mb * 1024 * 1024,
+                                              INT_MAX));
+}
+
+void build_arena(
+  const dyloc::topology & topo,
+  dyloc_topology_s      & arena) {
+  const auto & graph = topo.graph();
+
+  // Breadth-first order of visible domains, subdomains of every domain
+  // are appended consecutively:
+  std::vector<graph_vertex_t> order;
+  std::vector<int>            parents;
+  std::vector<int>            first_child;
+  std::vector<int>            arity;
+  for (auto vx_range = vertices(graph);
+       vx_range.first != vx_range.second;
+       ++vx_range.first) {
+    if (graph[*vx_range.first].domain_tag == "." &&
+        topo.is_visible(*vx_range.first)) {
+      order.push_back(*vx_range.first);
+      parents.push_back(-1);
+      break;
+    }
+  }
+  size_t num_unit_ids = 0;
+  size_t num_aliases  = 0;
+  for (size_t d = 0; d < order.size(); ++d) {
+    first_child.push_back(order.size());
+    arity.push_back(0);
+    num_unit_ids += topo.visible_domain(order[d])->unit_ids.size();
+    for (auto domain_edges = out_edges(order[d], graph);
+         domain_edges.first != domain_edges.second;
+         ++domain_edges.first) {
+      auto sub_vx = target(*domain_edges.first, graph);
+      if (!topo.is_visible(sub_vx)) {
+        continue;
+      }
+      if (graph[*domain_edges.first].type ==
+            dyloc::topology::edge_type::contains) {
+        order.push_back(sub_vx);
+        parents.push_back(d);
+        ++arity[d];
+      } else if (graph[*domain_edges.first].type ==
+                   dyloc::topology::edge_type::alias) {
+        ++num_aliases;
+      }
+    }
+  }
+
+  // Buffers are sized in advance as records refer to their elements:
+  std::unordered_map<graph_vertex_t, int> domain_indices;
+  for (size_t d = 0; d < order.size(); ++d) {
+    domain_indices[order[d]] = d;
+  }
+  arena.domains.assign(order.size(), dyloc_locality_domain_t());
+  arena.domain_refs.resize(order.size() + num_aliases);
+  arena.unit_ids.resize(num_unit_ids);
+
+  size_t unit_offset  = 0;
+  size_t alias_offset = order.size();
+  for (size_t d = 0; d < order.size(); ++d) {
+    const auto & domain     = *topo.visible_domain(order[d]);
+    auto       & domain_rec = arena.domains[d];
+    if (domain.domain_tag.size() >= DYLOC_LOCALITY_DOMAIN_TAG_MAX_SIZE ||
+        domain.host.size() >= DYLOC_LOCALITY_HOST_MAX_SIZE) {
+      DYLOC_THROW(
+        dyloc::exception::invalid_argument,
+        "domain tag or host name of domain " << domain.domain_tag <<
+        " exceeds size of dyloc_locality_domain_t fields");
+    }
+    std::memcpy(domain_rec.host, domain.host.c_str(),
+                domain.host.size() + 1);
+    std::memcpy(domain_rec.domain_tag, domain.domain_tag.c_str(),
+                domain.domain_tag.size() + 1);
+    domain_rec.scope          = domain.scope;
+    domain_rec.level          = domain.level;
+    domain_rec.global_index   = domain.g_index;
+    domain_rec.relative_index = domain.r_index;
+    domain_rec.team           = domain.team;
+    domain_rec.num_cores      = domain.num_cores;
+    domain_rec.parent         = (parents[d] < 0)
+                                ? nullptr
+                                : &arena.domains[parents[d]];
+    if (domain.scope == DYLOC_LOCALITY_SCOPE_NODE) {
+      domain_rec.node_id = domain.g_index;
+    } else if (domain_rec.parent != nullptr) {
+      domain_rec.node_id = domain_rec.parent->node_id;
+    } else {
+      domain_rec.node_id = -1;
+    }
+    domain_rec.shared_mem_bytes = shared_mem_bytes(topo, domain, domain_rec);
+
+    domain_rec.arity    = arity[d];
+    domain_rec.children = (arity[d] > 0)
+                          ? &arena.domain_refs[first_child[d] - 1]
+                          : nullptr;
+    for (int c = 0; c < arity[d]; ++c) {
+      arena.domain_refs[first_child[d] - 1 + c]
+        = &arena.domains[first_child[d] + c];
+    }
+
+    domain_rec.aliases     = nullptr;
+    domain_rec.num_aliases = 0;
+    for (auto domain_edges = out_edges(order[d], graph);
+         domain_edges.first != domain_edges.second;
+         ++domain_edges.first) {
+      auto alias_it = domain_indices.find(target(*domain_edges.first, graph));
+      if (graph[*domain_edges.first].type ==
+            dyloc::topology::edge_type::alias &&
+          alias_it != domain_indices.end()) {
+        if (domain_rec.num_aliases++ == 0) {
+          domain_rec.aliases = &arena.domain_refs[alias_offset];
+        }
+        arena.domain_refs[alias_offset++] = &arena.domains[alias_it->second];
+      }
+    }
+
+    domain_rec.num_units = domain.unit_ids.size();
+    domain_rec.unit_ids  = domain.unit_ids.empty()
+                           ? nullptr
+                           : &arena.unit_ids[unit_offset];
+    std::copy(domain.unit_ids.begin(), domain.unit_ids.end(),
+              arena.unit_ids.begin() + unit_offset);
+    unit_offset += domain.unit_ids.size();
+  }
+
+  // Properties of subtrees, subdomains are at higher positions than
+  // their parent:
+  for (size_t d = order.size(); d-- > 0; ) {
+    auto & domain_rec = arena.domains[d];
+    domain_rec.num_nodes    = (domain_rec.node_id >= 0) ? 1 : 0;
+    domain_rec.is_symmetric = (domain_rec.arity > 0) ? 1 : 0;
+    for (int c = 0; c < domain_rec.arity; ++c) {
+      const auto & child = *domain_rec.children[c];
+      const auto & first = *domain_rec.children[0];
+      if (domain_rec.node_id < 0) {
+        domain_rec.num_nodes += child.num_nodes;
+      }
+      if (child.scope     != first.scope     ||
+          child.arity     != first.arity     ||
+          child.num_cores != first.num_cores ||
+          child.num_units != first.num_units ||
+          !child.is_symmetric != !first.is_symmetric) {
+        domain_rec.is_symmetric = 0;
+      }
+    }
+  }
+
+  // Indices:
+  for (auto & domain_rec : arena.domains) {
+    arena.tag_index.push_back(&domain_rec);
+    if (domain_rec.scope == DYLOC_LOCALITY_SCOPE_UNIT &&
+        domain_rec.num_units > 0) {
+      size_t unit_gid = domain_rec.unit_ids[0].id;
+      if (arena.unit_index.size() <= unit_gid) {
+        arena.unit_index.resize(unit_gid + 1, nullptr);
+      }
+      arena.unit_index[unit_gid] = &domain_rec;
+    }
+  }
+  std::sort(arena.tag_index.begin(), arena.tag_index.end(),
+            [](const dyloc_locality_domain_t * a,
+               const dyloc_locality_domain_t * b) {
+              return std::strcmp(a->domain_tag, b->domain_tag) < 0;
+            });
+  for (auto & domain_rec : arena.domains) {
+    arena.scope_index.push_back(&domain_rec);
+  }
+  std::stable_sort(arena.scope_index.begin(), arena.scope_index.end(),
+                   scope_less());
+}
+
+} // namespace
+
+
+dyloc_ret_t dyloc_team_topology(
+  dart_team_t        team,
+  dyloc_topology_t * topo) {
+  if (topo == nullptr) {
+    return DYLOC_ERR_INVALID;
+  }
+  *topo = nullptr;
+  try {
+    auto                              snapshot  =
+                                        dyloc::team_topology_snapshot(team);
+    const dyloc::topology           & team_topo = *snapshot;
+    std::unique_ptr<dyloc::topology>  expanded;
+    if (team_topo.is_compressed()) {
+      expanded.reset(new dyloc::topology(team_topo));
+      expanded->expand();
+    }
+    std::unique_ptr<dyloc_topology_s> arena(new dyloc_topology_s());
+    build_arena(expanded ? *expanded : team_topo, *arena);
+    DYLOC_LOG_DEBUG("dyloc_team_topology",
+                    "domains:", arena->domains.size(),
+                    "units:",   arena->unit_ids.size());
+    *topo = arena.release();
+  } catch (const dyloc::exception::invalid_argument & e) {
+    DYLOC_LOG_ERROR("dyloc_team_topology", e.what());
+    return DYLOC_ERR_INVALID;
+  } catch (const std::exception & e) {
+    DYLOC_LOG_ERROR("dyloc_team_topology", e.what());
+    return DYLOC_ERR_OTHER;
+  }
+  return DYLOC_OK;
+}
+
+dyloc_ret_t dyloc_topology_destroy(
+  dyloc_topology_t * topo) {
+  if (topo == nullptr) {
+    return DYLOC_ERR_INVALID;
+  }
+  delete *topo;
+  *topo = nullptr;
+  return DYLOC_OK;
+}
+
+dyloc_ret_t dyloc_topology_domains(
+  dyloc_topology_t                 topo,
+  const dyloc_locality_domain_t ** domains,
+  int                            * num_domains) {
+  if (topo == nullptr || domains == nullptr || num_domains == nullptr) {
+    return DYLOC_ERR_INVALID;
+  }
+  *domains     = topo->domains.data();
+  *num_domains = topo->domains.size();
+  return DYLOC_OK;
+}
+
+dyloc_ret_t dyloc_topology_domain(
+  dyloc_topology_t                 topo,
+  const char                     * domain_tag,
+  const dyloc_locality_domain_t ** domain) {
+  if (topo == nullptr || domain_tag == nullptr || domain == nullptr) {
+    return DYLOC_ERR_INVALID;
+  }
+  *domain = nullptr;
+  auto domain_it = std::lower_bound(
+                     topo->tag_index.begin(),
+                     topo->tag_index.end(),
+                     domain_tag,
+                     [](const dyloc_locality_domain_t * d, const char * tag) {
+                       return std::strcmp(d->domain_tag, tag) < 0;
+                     });
+  if (domain_it == topo->tag_index.end() ||
+      std::strcmp((*domain_it)->domain_tag, domain_tag) != 0) {
+    return DYLOC_ERR_INVALID;
+  }
+  *domain = *domain_it;
+  return DYLOC_OK;
+}
+
+dyloc_ret_t dyloc_topology_unit_domain(
+  dyloc_topology_t                 topo,
+  dart_global_unit_t               unit_id,
+  const dyloc_locality_domain_t ** domain) {
+  if (topo == nullptr || domain == nullptr) {
+    return DYLOC_ERR_INVALID;
+  }
+  *domain = nullptr;
+  if (unit_id.id < 0 ||
+      unit_id.id >= static_cast<int>(topo->unit_index.size()) ||
+      topo->unit_index[unit_id.id] == nullptr) {
+    return DYLOC_ERR_INVALID;
+  }
+  *domain = topo->unit_index[unit_id.id];
+  return DYLOC_OK;
+}
+
+dyloc_ret_t dyloc_topology_scope_domains(
+  dyloc_topology_t                         topo,
+  dyloc_locality_scope_t                   scope,
+  const dyloc_locality_domain_t * const ** domains,
+  int                                    * num_domains) {
+  if (topo == nullptr || domains == nullptr || num_domains == nullptr) {
+    return DYLOC_ERR_INVALID;
+  }
+  auto scope_range = std::equal_range(
+                       topo->scope_index.begin(),
+                       topo->scope_index.end(),
+                       scope,
+                       scope_less());
+  *domains     = topo->scope_index.data() +
+                   (scope_range.first - topo->scope_index.begin());
+  *num_domains = scope_range.second - scope_range.first;
+  return DYLOC_OK;
+}
+
+dyloc_ret_t dyloc_topology_lca(
+  dyloc_topology_t                 topo,
+  const dyloc_locality_domain_t  * domain_a,
+  const dyloc_locality_domain_t  * domain_b,
+  const dyloc_locality_domain_t ** lca) {
+  if (topo == nullptr || domain_a == nullptr || domain_b == nullptr ||
+      lca == nullptr) {
+    return DYLOC_ERR_INVALID;
+  }
+  const auto * domains_begin = topo->domains.data();
+  const auto * domains_end   = domains_begin + topo->domains.size();
+  if (domain_a < domains_begin || domain_a >= domains_end ||
+      domain_b < domains_begin || domain_b >= domains_end) {
+    *lca = nullptr;
+    return DYLOC_ERR_INVALID;
+  }
+  // Ascend from the deeper domain until both paths meet, parents are
+  // at lower positions in the arena than their subdomains:
+  while (domain_a != domain_b) {
+    if (domain_a == nullptr || domain_b == nullptr) {
+      *lca = nullptr;
+      return DYLOC_ERR_INVALID;
+    }
+    if (domain_a > domain_b) {
+      domain_a = domain_a->parent;
+    } else {
+      domain_b = domain_b->parent;
+    }
+  }
+  *lca = domain_a;
+  return DYLOC_OK;
+}
+
@@ -7,9 +7,12 @@
 
 #include <dylocxx/hwinfo.h>
 #include <dylocxx/host_topology.h>
+#include <dylocxx/unit_placement.h>
 
 #include <dylocxx/topology.h>
 #include <dylocxx/topology_view.h>
+#include <dylocxx/frozen_topology.h>
+#include <dylocxx/versioned_topology.h>
 
 #include <dylocxx/runtime.h>
 
@@ -21,7 +21,7 @@ static inline dart_team_unit_t myid(dart_team_t t) {
 
 static inline dart_global_unit_t l2g(dart_team_t t, dart_team_unit_t lid) {
   dart_global_unit_t gid;
-  if (dart_team_unit_l2g(t, lid, &gid)) {
+  if (dart_team_unit_l2g(t, lid, &gid) == DART_OK) {
     return gid;
   }
   return DART_UNDEFINED_UNIT_ID;
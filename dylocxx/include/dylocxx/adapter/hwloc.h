@@ -15,24 +15,40 @@
 
 namespace dyloc {
 
+/**
+ * Restrict a loaded hwloc topology of the calling unit's host to the
+ * view of the host in the domain topology.
+ *
+ * The hwloc topology is restricted to the CPUs of domains at the host
+ * that are not hidden, for example the domains left after
+ * \c topology::select_domain or in a GROUP domain. Allocators and
+ * runtimes using the hwloc topology, e.g. with \c hwloc_set_membind,
+ * are then confined to the domains in the view.
+ *
+ * The hwloc topology is not modified if the view does not contain any
+ * domain at the calling unit's host.
+ */
 hwloc_topology_t & operator<<(
   hwloc_topology_t      & hwloc_topo,
-  const dyloc::topology & topo) {
-  // TODO: initialize hwloc topology from domain topology
-  dyloc__unused(topo);
-  return hwloc_topo;
-}
+  const dyloc::topology & topo);
 
 /**
  * Convert dyloc locality domain to hwloc topology object.
+ *
+ * Sets \c hwloc_obj to the shallowest object in the subtree of
+ * \c hwloc_obj that has the domain's scope and the domain's global
+ * index as logical index, or to \c NULL if no such object exists.
+ * NODE and MODULE domains resolve to the topology's root object,
+ * domains in scopes without corresponding hwloc object type (UNIT,
+ * GROUP) resolve to \c hwloc_obj itself.
+ *
+ * Domain indices of caches are not unique across cache levels, the
+ * object of a domain is therefore resolved starting from the object of
+ * its parent domain.
  */
 hwloc_obj_t & operator<<(
   hwloc_obj_t                  & hwloc_obj,
-  const dyloc::locality_domain & domain) {
-  // TODO: initialize hwloc object from locality domain
-  dyloc__unused(domain);
-  return hwloc_obj;
-}
+  const dyloc::locality_domain & domain);
 
 } // namespace dyloc
 
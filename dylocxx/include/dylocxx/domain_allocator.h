@@ -0,0 +1,174 @@
+#ifndef DYLOCXX__DOMAIN_ALLOCATOR_H__INCLUDED
+#define DYLOCXX__DOMAIN_ALLOCATOR_H__INCLUDED
+
+#include <dylocxx/topology.h>
+
+#include <vector>
+#include <string>
+#include <new>
+#include <cstddef>
+
+
+namespace dyloc {
+
+/**
+ * Placement of memory pages on the NUMA nodes of a domain.
+ */
+enum class numa_policy : int {
+  /// Pages are allocated on the domain's NUMA nodes only.
+  bind,
+  /// Pages are distributed round-robin across the domain's NUMA nodes.
+  interleave,
+  /// Pages are allocated on the NUMA node of the thread touching them
+  /// first.
+  first_touch
+};
+
+/**
+ * OS indices of the NUMA nodes of the domain's units at the calling
+ * unit's host, as expected by libnuma and \c mbind.
+ *
+ * Throws \c dyloc::exception::invalid_argument if the domain does not
+ * contain units at the calling unit's host.
+ */
+std::vector<int> domain_numa_nodes(
+  const topology        & topo,
+  const locality_domain & domain);
+
+/**
+ * Tags of the NUMA domains at the calling unit's host in the topology.
+ */
+std::vector<std::string> local_numa_domain_tags(
+  const topology & topo);
+
+/**
+ * Allocates memory on the NUMA nodes with the specified OS indices,
+ * returns \c nullptr on failure.
+ * Memory must be released using \c deallocate_numa.
+ */
+void * allocate_numa(
+  size_t                   nbytes,
+  const std::vector<int> & numa_nodes,
+  numa_policy              policy);
+
+void deallocate_numa(
+  void   * p,
+  size_t   nbytes);
+
+/**
+ * Allocator for memory on the NUMA nodes of a locality domain.
+ *
+ * Example:
+ *
+ * \code
+ *   auto & topo = dyloc::team_topology();
+ *   dyloc::domain_allocator<double> alloc(topo, ".0.1");
+ *   std::vector<double, dyloc::domain_allocator<double>> v(alloc);
+ *   v.resize(1024);
+ * \endcode
+ */
+template <class T>
+class domain_allocator {
+  template <class U>
+  friend class domain_allocator;
+
+  std::string      _domain_tag;
+  std::vector<int> _numa_nodes;
+  numa_policy      _policy;
+
+ public:
+  typedef T              value_type;
+  typedef T *            pointer;
+  typedef const T *      const_pointer;
+  typedef size_t         size_type;
+  typedef std::ptrdiff_t difference_type;
+
+  template <class U>
+  struct rebind {
+    typedef domain_allocator<U> other;
+  };
+
+ public:
+  domain_allocator() = delete;
+
+  domain_allocator(
+    const topology    & topo,
+    const std::string & domain_tag,
+    numa_policy         policy = numa_policy::bind)
+  : _domain_tag(domain_tag)
+  , _numa_nodes(domain_numa_nodes(topo, topo.domain(domain_tag)))
+  , _policy(policy)
+  { }
+
+  template <class U>
+  domain_allocator(const domain_allocator<U> & other)
+  : _domain_tag(other._domain_tag)
+  , _numa_nodes(other._numa_nodes)
+  , _policy(other._policy)
+  { }
+
+  T * allocate(size_t n) {
+    void * p = allocate_numa(n * sizeof(T), _numa_nodes, _policy);
+    if (p == nullptr && n > 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(p);
+  }
+
+  void deallocate(T * p, size_t n) noexcept {
+    deallocate_numa(p, n * sizeof(T));
+  }
+
+  inline const std::string & domain_tag() const noexcept {
+    return _domain_tag;
+  }
+
+  inline const std::vector<int> & numa_nodes() const noexcept {
+    return _numa_nodes;
+  }
+
+  inline numa_policy policy() const noexcept {
+    return _policy;
+  }
+};
+
+template <class T, class U>
+bool operator==(
+  const domain_allocator<T> & a,
+  const domain_allocator<U> & b) {
+  return a.numa_nodes() == b.numa_nodes() && a.policy() == b.policy();
+}
+
+template <class T, class U>
+bool operator!=(
+  const domain_allocator<T> & a,
+  const domain_allocator<U> & b) {
+  return !(a == b);
+}
+
+template <class T>
+using domain_vector = std::vector<T, domain_allocator<T> >;
+
+/**
+ * Allocates a buffer of the specified number of elements on every NUMA
+ * domain at the calling unit's host, in the order of
+ * \c local_numa_domain_tags.
+ * The tag of a buffer's domain is available from its allocator.
+ */
+template <class T>
+std::vector<domain_vector<T> > numa_buffers(
+  const topology & topo,
+  size_t           num_elements,
+  numa_policy      policy = numa_policy::bind) {
+  std::vector<domain_vector<T> > buffers;
+  for (const auto & numa_tag : local_numa_domain_tags(topo)) {
+    buffers.push_back(
+      domain_vector<T>(domain_allocator<T>(topo, numa_tag, policy)));
+    buffers.back().resize(num_elements);
+  }
+  return buffers;
+}
+
+} // namespace dyloc
+
+#endif // DYLOCXX__DOMAIN_ALLOCATOR_H__INCLUDED
@@ -0,0 +1,271 @@
+#ifndef DYLOCXX__FROZEN_TOPOLOGY_H__INCLUDED
+#define DYLOCXX__FROZEN_TOPOLOGY_H__INCLUDED
+
+#include <dylocxx/topology.h>
+
+#include <dyloc/common/types.h>
+
+#include <dash/dart/if/dart.h>
+
+#include <unordered_map>
+#include <vector>
+#include <string>
+
+
+namespace dyloc {
+
+/**
+ * Read-only snapshot of the domain hierarchy of a topology.
+ *
+ * Domains are stored in arrays indexed by their position in pre-order of
+ * the hierarchy with the root domain at index 0, so the descendants of
+ * a domain \c d are the domains in \c [d, subtree_end(d)).
+ * Subdomains are stored in compressed sparse row format and domain
+ * attributes in one array per attribute.
+ *
+ * Snapshots are not updated when the topology is modified.
+ *
+ * Example:
+ *
+ * \code
+ *   auto frozen = dyloc::team_topology().freeze();
+ *   int  unit_d = frozen.unit_index(dyloc::myid());
+ *   int  numa_d = frozen.find_ancestor(unit_d,
+ *                   [&](int d) {
+ *                     return frozen.scope(d) == DYLOC_LOCALITY_SCOPE_NUMA;
+ *                   });
+ * \endcode
+ */
+class frozen_topology {
+  typedef frozen_topology self_t;
+
+ public:
+  /**
+   * Range of domain indices.
+   */
+  struct index_range {
+    const int * first;
+    const int * last;
+
+    inline const int * begin() const noexcept { return first; }
+    inline const int * end()   const noexcept { return last;  }
+    inline int         size()  const noexcept { return last - first; }
+    inline bool        empty() const noexcept { return first == last; }
+  };
+
+ private:
+  /// Graph vertex of the domain at a pre-order index.
+  std::vector<topology::graph_vertex_t> _vertices;
+  std::vector<int>                      _parents;
+  std::vector<int>                      _subtree_ends;
+  std::vector<int>                      _child_offsets;
+  std::vector<int>                      _children;
+
+  std::vector<std::string>              _domain_tags;
+  std::vector<std::string>              _hosts;
+  std::vector<int>                      _host_ids;
+  std::vector<dyloc_locality_scope_t>   _scopes;
+  std::vector<int>                      _levels;
+  std::vector<int>                      _g_indices;
+  std::vector<int>                      _r_indices;
+  std::vector<int>                      _num_cores;
+  std::vector<int>                      _unit_offsets;
+  std::vector<dart_global_unit_t>       _unit_ids;
+
+  std::unordered_map<std::string, int>  _tag_indices;
+  /// Index of the UNIT domain of a global unit id, -1 if not contained.
+  std::vector<int>                      _unit_indices;
+
+ public:
+  frozen_topology()                                    = default;
+  frozen_topology(const frozen_topology &)             = default;
+  frozen_topology(frozen_topology &&)                  = default;
+  frozen_topology & operator=(const frozen_topology &) = default;
+  frozen_topology & operator=(frozen_topology &&)      = default;
+
+  /**
+   * Creates a snapshot of the visible domains in the topology.
+   * Unexpanded symmetric node instances are expanded in a copy of the
+   * topology.
+   */
+  explicit frozen_topology(const topology & topo);
+
+  inline int size() const noexcept {
+    return static_cast<int>(_parents.size());
+  }
+
+  /**
+   * Index of the domain with the specified tag, -1 if it is not
+   * contained in the snapshot.
+   */
+  int index(const std::string & domain_tag) const;
+
+  /**
+   * Index of the UNIT domain of the specified unit, -1 if it is not
+   * contained in the snapshot.
+   */
+  inline int unit_index(dart_global_unit_t unit_id) const noexcept {
+    return (unit_id.id >= 0 &&
+            unit_id.id < static_cast<int>(_unit_indices.size()))
+           ? _unit_indices[unit_id.id]
+           : -1;
+  }
+
+  /**
+   * Vertex of the domain in the graph of the topology, undefined for
+   * domains of symmetric instances that were unexpanded in the topology.
+   */
+  inline topology::graph_vertex_t vertex(int d) const noexcept {
+    return _vertices[d];
+  }
+
+  inline int parent(int d) const noexcept {
+    return _parents[d];
+  }
+
+  /**
+   * Pre-order index following the last descendant of the domain.
+   */
+  inline int subtree_end(int d) const noexcept {
+    return _subtree_ends[d];
+  }
+
+  inline index_range children(int d) const noexcept {
+    return index_range { _children.data() + _child_offsets[d],
+                         _children.data() + _child_offsets[d + 1] };
+  }
+
+  /**
+   * Whether domain \c a is domain \c d or one of its ancestors.
+   */
+  inline bool is_ancestor(int a, int d) const noexcept {
+    return a <= d && d < _subtree_ends[a];
+  }
+
+  /**
+   * Index of the lowest common ancestor of the specified domains.
+   */
+  inline int ancestor(int a, int b) const noexcept {
+    while (!is_ancestor(a, b)) {
+      a = _parents[a];
+    }
+    return a;
+  }
+
+  inline const std::string & domain_tag(int d) const noexcept {
+    return _domain_tags[d];
+  }
+
+  inline const std::string & host(int d) const noexcept {
+    return _hosts[d];
+  }
+
+  inline int host_id(int d) const noexcept {
+    return _host_ids[d];
+  }
+
+  inline dyloc_locality_scope_t scope(int d) const noexcept {
+    return _scopes[d];
+  }
+
+  inline int level(int d) const noexcept {
+    return _levels[d];
+  }
+
+  inline int g_index(int d) const noexcept {
+    return _g_indices[d];
+  }
+
+  inline int r_index(int d) const noexcept {
+    return _r_indices[d];
+  }
+
+  inline int num_cores(int d) const noexcept {
+    return _num_cores[d];
+  }
+
+  inline int num_units(int d) const noexcept {
+    return _unit_offsets[d + 1] - _unit_offsets[d];
+  }
+
+  inline const dart_global_unit_t * units_begin(int d) const noexcept {
+    return _unit_ids.data() + _unit_offsets[d];
+  }
+
+  inline const dart_global_unit_t * units_end(int d) const noexcept {
+    return _unit_ids.data() + _unit_offsets[d + 1];
+  }
+
+  /**
+   * Calls \c func for the domain \c d and all its descendants in
+   * pre-order.
+   */
+  template <class UnaryFunction>
+  void for_each_descendant(int d, UnaryFunction && func) const {
+    for (int sub_d = d; sub_d < _subtree_ends[d]; ++sub_d) {
+      func(sub_d);
+    }
+  }
+
+  /**
+   * Calls \c func for the domain \c d and all its ancestors, starting at
+   * \c d.
+   */
+  template <class UnaryFunction>
+  void for_each_ancestor(int d, UnaryFunction && func) const {
+    for (; d >= 0; d = _parents[d]) {
+      func(d);
+    }
+  }
+
+  /**
+   * Depth-first traversal of the subtree of domain \c d, calls
+   * \c discover for a domain before and \c finish after its descendants.
+   */
+  template <class DiscoverFunction, class FinishFunction>
+  void depth_first_search(
+    int                  d,
+    DiscoverFunction  && discover,
+    FinishFunction    && finish) const {
+    int open_d = -1;
+    for (int sub_d = d; sub_d < _subtree_ends[d]; ++sub_d) {
+      for (; open_d >= 0 && sub_d >= _subtree_ends[open_d];
+           open_d = _parents[open_d]) {
+        finish(open_d);
+      }
+      discover(sub_d);
+      open_d = sub_d;
+    }
+    for (; open_d >= 0 && open_d >= d; open_d = _parents[open_d]) {
+      finish(open_d);
+    }
+  }
+
+  /**
+   * Index of the first domain in pre-order of the subtree of domain \c d
+   * that satisfies the predicate, -1 if no domain matches.
+   */
+  template <class UnaryPredicate>
+  int find_descendant(int d, UnaryPredicate && pred) const {
+    for (int sub_d = d; sub_d < _subtree_ends[d]; ++sub_d) {
+      if (pred(sub_d)) { return sub_d; }
+    }
+    return -1;
+  }
+
+  /**
+   * Index of the nearest of domain \c d and its ancestors that satisfies
+   * the predicate, -1 if no domain matches.
+   */
+  template <class UnaryPredicate>
+  int find_ancestor(int d, UnaryPredicate && pred) const {
+    for (; d >= 0; d = _parents[d]) {
+      if (pred(d)) { return d; }
+    }
+    return -1;
+  }
+};
+
+} // namespace dyloc
+
+#endif // DYLOCXX__FROZEN_TOPOLOGY_H__INCLUDED
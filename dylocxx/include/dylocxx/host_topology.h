@@ -2,6 +2,7 @@
 #define DYLOCXX__HOST_TOPOLOGY_H__INCLUDED
 
 #include <dylocxx/unit_mapping.h>
+#include <dylocxx/network_topology.h>
 
 #include <dyloc/common/types.h>
 
@@ -24,85 +25,160 @@ typedef struct {
 }
 dyloc_host_domain_t;
 
+/**
+ * Classifies hosts as nodes and modules of nodes by their host names.
+ *
+ * A host is a module of a node if the node's host name is a prefix of the
+ * module's host name and the remaining suffix matches the pattern in
+ * environment variable DYLOC_MODULE_SUFFIX_PATTERN ("[-_][A-Za-z]+[0-9]*"
+ * by default), like "node1-mic0" of node "node1".
+ * Nodes of hosts that are known in advance can be specified by index in
+ * \c known_node_ids, -1 for hosts to be classified by name.
+ *
+ * Returns the index of the node of every module and -1 for every node.
+ */
+std::vector<int> classify_hosts(
+  const std::vector<std::string> & host_names,
+  const std::vector<int>         & known_node_ids = std::vector<int>());
+
+/**
+ * Host names are interned into dense host ids in the order in which
+ * units are mapped to hosts; all host data is indexed by host id.
+ */
 class host_topology {
-  using host_domain_map_t
-          = std::vector<dyloc_host_domain_t>;
   using host_units_map_t
-          = std::unordered_map<
-              std::string,
+          = std::vector<
               std::vector<dart_global_unit_t> >;
 
-  using module_domain_list_t
-          = std::vector<
-                std::reference_wrapper<dyloc_host_domain_t> >;
-
-  using module_hwinfo_t
-          = std::unordered_map<
-              std::string,
-              dyloc_hwinfo_t >;
-
-  // mapping <node host name> -> <node domain>
-  using node_domain_map_t
-          = std::unordered_map<
-              std::string,
-              std::reference_wrapper<dyloc_host_domain_t> >;
-  // mapping <module host name> -> <module domain>
-  using module_domain_map_t
-          = std::unordered_map<
-              std::string,
-              std::reference_wrapper<dyloc_host_domain_t> >;
-  // mapping <node host name> -> [ <module domain>, ... ]
-  using node_modules_domain_map_t
-          = std::unordered_map<
-              std::string,
-              module_domain_list_t >;
+  using host_domain_map_t
+          = std::vector<dyloc_host_domain_t>;
 
- private:
-  // Mapping host name to unit ids located at hosts.
-  host_units_map_t          _host_units;
-  // Mapping host name to basic host domain data.
-  host_domain_map_t         _host_domains;
+  using host_hwinfo_map_t
+          = std::vector<dyloc_hwinfo_t>;
 
-  module_hwinfo_t           _module_hwinfo;
+  // mapping <host id> -> <NUMA distance matrix>
+  using numa_distances_map_t
+          = std::vector<
+              std::vector<int> >;
 
-  node_domain_map_t         _node_domains;
-  module_domain_map_t       _module_domains;
+  // mapping <node host id> -> [ <module host id>, ... ]
+  using node_modules_map_t
+          = std::vector<
+              std::vector<int> >;
 
-  node_modules_domain_map_t _node_module_domains;
+ private:
+  // Host names by host id.
+  std::vector<std::string>             _host_names;
+  // Mapping host name to host id.
+  std::unordered_map<std::string, int> _host_ids;
+  // Unit ids located at hosts by host id.
+  host_units_map_t                     _host_units;
+  // Basic host domain data by host id.
+  host_domain_map_t                    _host_domains;
+  // Hardware info of first unit at host by host id.
+  host_hwinfo_map_t                    _module_hwinfo;
+  // Distances between NUMA domains at hosts, row-major matrices of
+  // DYLOC_LOCALITY_MAX_NUMA_ID x DYLOC_LOCALITY_MAX_NUMA_ID entries.
+  numa_distances_map_t                 _numa_distances;
+
+  // Host ids of nodes, ordered by host name.
+  std::vector<int>                     _node_host_ids;
+  // Host ids of modules, ordered by host name.
+  std::vector<int>                     _module_host_ids;
+  // Host ids of modules at node by node host id.
+  node_modules_map_t                   _node_module_host_ids;
+
+  // Interconnect of node hosts, read from file specified in environment
+  // variable DYLOC_NETWORK_TOPOLOGY.
+  network_topology                     _network_topology;
 
   int _num_host_levels = 0;
 
  public:
   host_topology() = delete;
+
+  /**
+   * Collectively resolves the host topology of units in the specified
+   * mapping, locations of modules like Xeon Phi devices are exchanged
+   * between one leader unit per host.
+   */
   host_topology(const unit_mapping & unit_map);
 
-  inline const node_domain_map_t & nodes() const noexcept {
-    return _node_domains;
+  /**
+   * Host topology of units in the specified mapping with locations of
+   * modules specified in advance. Not collective.
+   */
+  host_topology(
+    const unit_mapping                         & unit_map,
+    const std::vector<dyloc_module_location_t> & module_locations);
+
+  inline int num_hosts() const noexcept {
+    return _host_names.size();
   }
 
-  inline const module_domain_map_t & modules() const noexcept {
-    return _module_domains;
+  /**
+   * Id of the host with the specified name, or -1 if no unit is mapped
+   * to the host.
+   */
+  inline int host_id(const std::string & hostname) const {
+    auto host_id_it = _host_ids.find(hostname);
+    return (host_id_it == _host_ids.end()) ? -1 : host_id_it->second;
   }
 
-  inline const module_domain_list_t & node_modules(
-      const std::string & node_hostname) const noexcept {
-    return _node_module_domains.at(node_hostname);
+  inline const std::string & host_name(int host_id) const {
+    return _host_names.at(host_id);
+  }
+
+  inline const dyloc_host_domain_t & host_domain(int host_id) const {
+    return _host_domains.at(host_id);
+  }
+
+  inline const std::vector<int> & nodes() const noexcept {
+    return _node_host_ids;
+  }
+
+  inline const std::vector<int> & modules() const noexcept {
+    return _module_host_ids;
+  }
+
+  inline const network_topology & network() const noexcept {
+    return _network_topology;
+  }
+
+  inline const std::vector<int> & node_modules(
+      int node_host_id) const {
+    return _node_module_host_ids.at(node_host_id);
   }
 
   inline const std::vector<dart_global_unit_t> & unit_ids(
-      const std::string & hostname) const noexcept {
-    return _host_units.at(hostname);
+      int host_id) const {
+    return _host_units.at(host_id);
   }
 
   inline const dyloc_hwinfo_t & module_hwinfo(
-      const std::string & module_hostname) const noexcept {
-    return _module_hwinfo.at(module_hostname);
+      int module_host_id) const {
+    return _module_hwinfo.at(module_host_id);
   }
 
+  /**
+   * Distance between two NUMA domains at the specified host as in the
+   * ACPI SLIT, or -1 if unknown.
+   */
+  int numa_distance(
+      int host_id,
+      int numa_id_a,
+      int numa_id_b) const;
+
 
  private:
+  void map_units(
+         const unit_mapping & unit_map);
   void collect_topology(
          const unit_mapping & unit_map);
+  void locate_modules(
+         const std::vector<dyloc_module_location_t> & module_locations);
+  void classify_host_levels();
+  void load_network_topology();
   void local_topology(
          const unit_mapping                   & unit_map,
          std::vector<dyloc_module_location_t> & module_locations);
@@ -19,6 +19,7 @@ locality_domain & topology::group_domains(
        const Sentinel & group_domain_tag_last)
 {
   DYLOC_LOG_DEBUG("dylocxx::topology.group_domains", "(first,last)");
+  if (is_compressed()) { expand(); }
 
   if (std::distance(group_domain_tag_first, group_domain_tag_last) == 0) {
     DYLOC_THROW(
@@ -35,8 +36,8 @@ locality_domain & topology::group_domains(
 
   auto   group_domain_parent_vx    = _domain_vertices[
                                        group_domain_parent.domain_tag];
-  auto   group_domain_parent_arity = out_degree(
-                                       group_domain_parent_vx, _graph);
+  auto   group_domain_parent_arity = subdomain_arity(
+                                       group_domain_parent_vx);
 
   DYLOC_LOG_DEBUG("dylocxx::topology.group_domains",
                   "arity:", group_domain_parent_arity);
@@ -125,8 +126,9 @@ locality_domain & topology::group_domains(
                       group_domain_parent,
                       DYLOC_LOCALITY_SCOPE_GROUP,
                       group_domain_parent_arity);
-    group_domain.level = group_domain_parent.level;
-    group_domain.host  = group_domain_parent.host;
+    group_domain.level   = group_domain_parent.level;
+    group_domain.host    = group_domain_parent.host;
+    group_domain.host_id = group_domain_parent.host_id;
 
     DYLOC_LOG_TRACE("dylocxx::topology.group_domains", 
                     "add group domain:", group_domain);
@@ -141,6 +143,7 @@ locality_domain & topology::group_domains(
                _graph);
 
     _domain_vertices[group_domain.domain_tag] = group_domain_vertex;
+    index_domain(group_domain_vertex);
 
     boost::add_edge(group_domain_parent_vertex, group_domain_vertex,
                     { edge_type::contains, 0 },
@@ -175,8 +178,8 @@ void topology::split_to_parent(
                   "src:", src_domain_tag,
                   "dst:", dst_domain_tag);
   auto src_domain_tag_len  = htag(src_domain_tag).length();
-  int dst_subdomain_rindex = out_degree(_domain_vertices[dst_domain_tag],
-                                        _graph);
+  int dst_subdomain_rindex = subdomain_arity(
+                               _domain_vertices[dst_domain_tag]);
   locality_domain dst_subdomain(_domains[dst_domain_tag],
                                 _domains[src_domain_tag].scope,
                                 dst_subdomain_rindex);
@@ -196,6 +199,7 @@ void topology::split_to_parent(
              _graph);
 
   _domain_vertices[dst_subdomain.domain_tag] = dst_subdomain_vertex;
+  index_domain(dst_subdomain_vertex);
 
   boost::add_edge(dst_domain_vertex, dst_subdomain_vertex,
                   { edge_type::contains,
@@ -231,8 +235,9 @@ locality_domain & topology::group_subdomains(
        const locality_domain & domain,
        const Iterator & subdomain_tag_first,
        const Sentinel & subdomain_tag_last) {
+  if (is_compressed()) { expand(); }
   auto & domain_vx              = _domain_vertices[domain.domain_tag];
-  auto   num_subdomains         = out_degree(domain_vx, _graph);
+  auto   num_subdomains         = subdomain_arity(domain_vx);
   size_t num_grouped_subdomains = std::distance(subdomain_tag_first,
                                                 subdomain_tag_last);
   if (num_grouped_subdomains <= 0) {
@@ -261,6 +266,7 @@ locality_domain & topology::group_subdomains(
                            _graph);
 
   _domain_vertices[group_domain.domain_tag] = group_domain_vx;
+  index_domain(group_domain_vx);
 
   boost::add_edge(domain_vx, group_domain_vx,
                   { edge_type::contains, 0 },
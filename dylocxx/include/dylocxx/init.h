@@ -5,6 +5,10 @@
 
 #include <dyloc/common/types.h>
 
+#include <functional>
+#include <memory>
+#include <cstdint>
+
 
 namespace dyloc {
 
@@ -13,10 +17,10 @@ void finalize();
 bool is_initialized();
 
 #if 0
-const unit_locality & query_unit_locality(
+unit_locality query_unit_locality(
         dart_global_unit_t u);
 
-const unit_locality & query_unit_locality(
+unit_locality query_unit_locality(
         dart_team_t t,
         dart_team_unit_t u);
 #endif
@@ -24,6 +28,46 @@ const unit_locality & query_unit_locality(
 topology & team_topology(
   dart_team_t t = DART_TEAM_ALL);
 
+/**
+ * Current published version of the team's topology, safe to call from
+ * any thread while the topology is updated.
+ */
+std::shared_ptr<const topology> team_topology_snapshot(
+  dart_team_t t = DART_TEAM_ALL);
+
+/**
+ * Applies the specified function to the team's topology and publishes
+ * the result to \c team_topology_snapshot readers.
+ * Returns the number of the published version.
+ */
+uint64_t update_team_topology(
+  const std::function<void(topology &)> & mutate,
+  dart_team_t                             t = DART_TEAM_ALL);
+
+/**
+ * Publishes modifications of the topology reference obtained from
+ * \c team_topology to \c team_topology_snapshot readers.
+ */
+uint64_t publish_team_topology(
+  dart_team_t t = DART_TEAM_ALL);
+
+/**
+ * Detects whether the calling unit has been moved or rebound by the OS
+ * or resource manager and records its locality to be applied in all
+ * teams on their next resynchronization, see
+ * \c runtime::refresh_unit_locality.
+ * Returns whether the unit has been moved.
+ */
+bool refresh_unit_locality();
+
+/**
+ * Collectively updates the locality of moved units in the specified
+ * team, see \c runtime::resync_unit_localities.
+ * Returns the number of moved units.
+ */
+size_t resync_unit_localities(
+  dart_team_t t = DART_TEAM_ALL);
+
 const dyloc::host_topology & team_host_topology(
   dart_team_t t = DART_TEAM_ALL);
 
@@ -0,0 +1,40 @@
+#ifndef DYLOCXX__LATENCY_PROBE_H__INCLUDED
+#define DYLOCXX__LATENCY_PROBE_H__INCLUDED
+
+#include <vector>
+
+
+namespace dyloc {
+
+/**
+ * Measures the latency of cache line transfers between CPUs of the
+ * local host.
+ *
+ * Two threads pinned to the respective CPUs alternately update a
+ * counter in a shared cache line ("ping-pong").
+ * The transfer latency is half of the mean round-trip time.
+ */
+class latency_probe {
+  int              _num_rounds;
+  /// Maps logical CPU ids as in \c dyloc_hwinfo_t to OS CPU indices.
+  std::vector<int> _cpu_os_ids;
+
+ public:
+  latency_probe() = delete;
+
+  explicit latency_probe(int num_rounds);
+
+  /**
+   * One-way cache line transfer latency in nanoseconds between the CPUs
+   * with the specified logical ids, or -1 if the probe threads could not
+   * be pinned to the CPUs.
+   */
+  int cpu_latency(int cpu_id_a, int cpu_id_b) const;
+
+ private:
+  int os_cpu_id(int cpu_id) const;
+};
+
+} // namespace dyloc
+
+#endif // DYLOCXX__LATENCY_PROBE_H__INCLUDED
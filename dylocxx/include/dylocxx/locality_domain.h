@@ -26,6 +26,9 @@ class locality_domain {
  public:
   std::string                     domain_tag;
   std::string                     host;
+  /// Id of the domain's host in the team's host topology, -1 for
+  /// domains not located at a single host.
+  int                             host_id   = -1;
   dyloc_locality_scope_t          scope     = DYLOC_LOCALITY_SCOPE_UNDEFINED;
   int                             level     = -1;
   int                             g_index   = -1;
@@ -90,7 +93,7 @@ class locality_domain {
 
   inline const dyloc_hwinfo_t & hwinfo() const {
     DYLOC_LOG_DEBUG_VAR("dylocxx::locality_domain.hwinfo()", host);
-    return dyloc::team_host_topology(team).module_hwinfo(host);
+    return dyloc::team_host_topology(team).module_hwinfo(host_id);
   }
 
 };
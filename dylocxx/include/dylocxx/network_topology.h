@@ -0,0 +1,89 @@
+#ifndef DYLOCXX__NETWORK_TOPOLOGY_H__INCLUDED
+#define DYLOCXX__NETWORK_TOPOLOGY_H__INCLUDED
+
+#include <unordered_map>
+#include <vector>
+#include <string>
+
+
+namespace dyloc {
+
+/**
+ * Interconnect topology of compute nodes as a hierarchy of network
+ * switches, read from a switch layout in the format of Slurm's
+ * \c topology.conf:
+ *
+ *   SwitchName=s0 Nodes=node[01-16]
+ *   SwitchName=s1 Nodes=node[17-32]
+ *   SwitchName=s2 Switches=s[0-1]
+ *
+ * Switches, groups and cabinets of other interconnect layouts can be
+ * described in the same format.
+ */
+class network_topology {
+ public:
+  struct network_switch {
+    std::string              name;
+    int                      parent = -1;
+    std::vector<int>         switches;
+    std::vector<std::string> nodes;
+  };
+
+ private:
+  /// Switches in order of their definition.
+  std::vector<network_switch>          _switches;
+  /// Maps switch name to switch index.
+  std::unordered_map<std::string, int> _switch_ids;
+  /// Maps node host name to index of its leaf switch.
+  std::unordered_map<std::string, int> _node_switches;
+  /// Maps node host name to its position in depth-first order of the
+  /// switch hierarchy.
+  std::unordered_map<std::string, int> _node_ranks;
+
+ public:
+  network_topology() = default;
+
+  /**
+   * Reads the switch layout from the specified file.
+   *
+   * Throws \c dyloc::exception::runtime_config_error if the file cannot
+   * be read.
+   */
+  explicit network_topology(const std::string & config_file);
+
+  inline bool empty() const noexcept {
+    return _switches.empty();
+  }
+
+  inline const network_switch & at(int switch_id) const {
+    return _switches.at(switch_id);
+  }
+
+  /**
+   * Indices of the switches from the root switch to the leaf switch of
+   * the specified node, or empty if the node is not connected to any
+   * switch.
+   */
+  std::vector<int> switch_path(const std::string & hostname) const;
+
+  /**
+   * Position of the specified node in depth-first order of the switch
+   * hierarchy, or -1 if the node is not connected to any switch.
+   */
+  int node_rank(const std::string & hostname) const;
+
+  /**
+   * Expands a Slurm host list expression like \c "node[01-03,07],login"
+   * to a list of host names.
+   */
+  static std::vector<std::string> expand_hostlist(
+           const std::string & hostlist);
+
+ private:
+  int  switch_id(const std::string & switch_name);
+  void rank_nodes(int switch_id, int & rank);
+};
+
+} // namespace dyloc
+
+#endif // DYLOCXX__NETWORK_TOPOLOGY_H__INCLUDED
@@ -6,38 +6,99 @@
 #include <dylocxx/unit_locality.h>
 #include <dylocxx/locality_domain.h>
 #include <dylocxx/topology.h>
+#include <dylocxx/versioned_topology.h>
+#include <dylocxx/unit_placement.h>
 
 #include <dyloc/common/types.h>
 
 #include <dash/dart/if/dart_types.h>
 
+#include <unordered_set>
 #include <vector>
+#include <memory>
+#include <cstdint>
 
 
 namespace dyloc {
 
 class runtime {
   std::unordered_map<dart_team_t, host_topology>   _host_topologies;
-  std::unordered_map<dart_team_t, unit_mapping>    _unit_mappings;
-  std::unordered_map<dart_team_t, topology>        _topologies;
+  /// Current unit mappings, shared with the versions of the teams'
+  /// topologies and replaced instead of modified. Accessed by the thread
+  /// updating the topologies only, readers use the unit mapping of a
+  /// published topology version.
+  std::unordered_map<dart_team_t, std::shared_ptr<const unit_mapping>>
+                                                      _unit_mappings;
+  std::unordered_map<dart_team_t, versioned_topology> _topologies;
+  /// Placement of the calling unit when its locality was collected.
+  unit_placement                                      _placement;
+  /// Teams in which the calling unit has been moved since the last
+  /// resynchronization.
+  std::unordered_set<dart_team_t>                     _unsynced_teams;
+  /// Hardware information of the calling unit collected when it has been
+  /// moved, applied in unsynced teams on their next resynchronization.
+  dyloc_hwinfo_t                                      _moved_hwinfo;
 
  public:
   void initialize();
   void finalize();
 
+  /**
+   * Initialize locality information of the specified team.
+   *
+   * The topology is built by every unit unless specified otherwise in
+   * environment variable DYLOC_TOPOLOGY_BUILD:
+   *
+   * - "all":  every unit builds the topology (default)
+   * - "root": the team's first unit builds and broadcasts the topology
+   * - "node": the first unit at every node builds and broadcasts the
+   *           topology to the node's units
+   *
+   * Teams must not be initialized or finalized concurrently with
+   * queries of other teams.
+   */
   void initialize_locality(dart_team_t team);
   void finalize_locality(dart_team_t team);
 
-  const dyloc::unit_locality & unit_locality(
+  /**
+   * Checks whether the calling unit has been moved since its locality
+   * was collected. If so, collects the unit's hardware information and
+   * marks all teams as unsynced. Not collective, unit mappings and
+   * topologies are not modified until the team's next
+   * \c resync_unit_localities.
+   *
+   * Returns whether the unit has been moved.
+   */
+  bool refresh_unit_locality();
+
+  /**
+   * Collectively updates the locality of units in the specified team
+   * that have been moved since the team's last resynchronization,
+   * including the calling unit.
+   * Only moved units contribute to the exchange. Every unit creates an
+   * updated copy of its unit mapping and moves the UNIT domains of all
+   * moved units in the team's topology, publishing both in a single new
+   * version if any unit has been moved.
+   *
+   * Returns the number of moved units.
+   */
+  size_t resync_unit_localities(dart_team_t team);
+
+  /**
+   * Locality of a unit in the current published version of the team's
+   * topology, safe to call from any thread while the topology is
+   * updated.
+   */
+  dyloc::unit_locality unit_locality(
           dart_team_t t,
-          dart_team_unit_t u) {
-    return _unit_mappings.at(t)[u];
+          dart_team_unit_t u) const {
+    return team_topology_snapshot(t)->unit_map()[u];
   }
 
-  const dyloc::unit_locality & unit_locality(
-          dart_global_unit_t u) {
+  dyloc::unit_locality unit_locality(
+          dart_global_unit_t u) const {
     // Unit id in team ALL is identical to global unit id:
-    return _unit_mappings.at(DART_TEAM_ALL)[u.id];
+    return team_topology_snapshot(DART_TEAM_ALL)->unit_map()[u.id];
   }
 
   const dyloc::host_topology & team_host_topology(
@@ -46,10 +107,38 @@ class runtime {
     return _host_topologies.at(t);
   }
 
+  /**
+   * Working copy of the team's topology, modifications are visible in
+   * snapshots after \c publish_team_topology.
+   */
   dyloc::topology & team_topology(
     dart_team_t t) {
-    return _topologies.at(t);
+    return _topologies.at(t).working_copy();
+  }
+
+  /**
+   * Current published version of the team's topology, safe to call from
+   * any thread while the topology is updated.
+   */
+  std::shared_ptr<const dyloc::topology> team_topology_snapshot(
+    dart_team_t t) const {
+    return _topologies.at(t).snapshot();
+  }
+
+  template <class Mutation>
+  uint64_t update_team_topology(
+    dart_team_t   t,
+    Mutation   && mutate) {
+    return _topologies.at(t).update(std::forward<Mutation>(mutate));
+  }
+
+  uint64_t publish_team_topology(
+    dart_team_t t) {
+    return _topologies.at(t).publish();
   }
+
+ private:
+  void bcast_topology(dart_team_t team, bool per_node);
 };
 
 } // namespace dyloc
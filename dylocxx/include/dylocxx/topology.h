@@ -4,6 +4,7 @@
 #include <dylocxx/host_topology.h>
 #include <dylocxx/unit_mapping.h>
 #include <dylocxx/locality_domain.h>
+#include <dylocxx/topology_image.h>
 #include <dylocxx/exception.h>
 
 #include <dylocxx/internal/logging.h>
@@ -18,12 +19,16 @@
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/undirected_graph.hpp>
 #include <boost/graph/depth_first_search.hpp>
+#include <boost/graph/filtered_graph.hpp>
 #include <boost/graph/connected_components.hpp>
 #include <boost/graph/copy.hpp>
 #include <boost/graph/graph_traits.hpp>
 #include <boost/graph/properties.hpp>
 
 #include <unordered_map>
+#include <memory>
+#include <deque>
+#include <vector>
 #include <functional>
 #include <algorithm>
 #include <iterator>
@@ -33,6 +38,21 @@
 
 namespace dyloc {
 
+template <class DomainPredicate>
+class topology_view;
+
+class frozen_topology;
+
+/**
+ * Sizes of blocks of the specified number of elements proportional to
+ * the specified weights, rounded by largest remainder such that they add
+ * up to the number of elements. Blocks are equally sized unless every
+ * weight is positive.
+ */
+std::vector<size_t> weighted_block_sizes(
+  size_t                      total_elements,
+  const std::vector<double> & weights);
+
 /**
  * Extension to the hwloc topology data structure.
  */
@@ -56,11 +76,51 @@ class topology {
     selected
   };
 
+  /**
+   * Capacity of units used to weight their share of partitioned data.
+   */
+  enum class weight_policy : int {
+    /// Equal share for every unit.
+    uniform     = 0,
+    /// Number of cores of the unit.
+    num_cores,
+    /// Number of cores of the unit times their max. clock rate.
+    cpu_mhz,
+    /// NUMA memory capacity, shared among the units in a NUMA domain.
+    numa_memory,
+    /// Memory throughput, shared among the units in a NUMA domain.
+    throughput
+  };
+
+  /**
+   * Contiguous range of partitioned elements assigned to a unit.
+   */
+  struct unit_block {
+    dart_global_unit_t unit;
+    size_t             offset;
+    size_t             size;
+  };
+
   struct vertex_properties {
     std::string  domain_tag;
     vertex_state state;
   };
 
+  /*
+   * Edges of type \c contains define the domain hierarchy, any other edge
+   * type specifies a relation between domains at arbitrary positions in
+   * the hierarchy.
+   *
+   * The distance of a \c contains edge is the cost of communication
+   * between subdomains of its source domain, the distance of an
+   * \c adjacent edge is the cost of communication between its source
+   * and target domain.
+   * Distances are derived from domain levels unless measured values have
+   * been assigned, see \c topology::measure_latencies.
+   * NUMA domains of the same host are connected by \c adjacent edges
+   * with their relative distance as in the ACPI SLIT (local distance
+   * is 10) if available.
+   */
   struct edge_properties {
     edge_type    type;
     int          distance;
@@ -107,6 +167,334 @@ class topology {
   typedef boost::graph_traits<graph_t>::edge_descriptor
     graph_edge_t;
 
+  /**
+   * Edge predicate to restrict a graph to the domain hierarchy.
+   */
+  struct contains_edge_filter {
+    const graph_t * graph = nullptr;
+
+    contains_edge_filter() = default;
+    explicit contains_edge_filter(const graph_t & g) : graph(&g) { }
+
+    bool operator()(const graph_edge_t & e) const {
+      return (*graph)[e].type == edge_type::contains;
+    }
+  };
+
+  typedef boost::graph_traits<graph_t>::out_edge_iterator
+    graph_out_edge_iterator_t;
+
+  /**
+   * Iterator over the visible subdomains of a domain.
+   */
+  class children_iterator {
+    typedef children_iterator self_t;
+
+    const graph_t             * _graph = nullptr;
+    graph_out_edge_iterator_t   _it;
+    graph_out_edge_iterator_t   _end;
+
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef graph_vertex_t            value_type;
+    typedef std::ptrdiff_t            difference_type;
+    typedef const graph_vertex_t *    pointer;
+    typedef graph_vertex_t            reference;
+
+    children_iterator() = default;
+
+    children_iterator(const graph_t & g, graph_vertex_t vx, bool at_end)
+    : _graph(&g) {
+      auto edge_range = out_edges(vx, g);
+      _it  = at_end ? edge_range.second : edge_range.first;
+      _end = edge_range.second;
+      skip_invisible();
+    }
+
+    inline reference operator*() const {
+      return target(*_it, *_graph);
+    }
+
+    self_t & operator++() {
+      ++_it;
+      skip_invisible();
+      return *this;
+    }
+
+    self_t operator++(int) {
+      self_t prev = *this;
+      ++(*this);
+      return prev;
+    }
+
+    inline bool operator==(const self_t & rhs) const { return _it == rhs._it; }
+    inline bool operator!=(const self_t & rhs) const { return _it != rhs._it; }
+
+   private:
+    void skip_invisible() {
+      while (_it != _end &&
+             ((*_graph)[*_it].type != edge_type::contains ||
+              (*_graph)[target(*_it, *_graph)].state ==
+                vertex_state::hidden)) {
+        ++_it;
+      }
+    }
+  };
+
+  /**
+   * Iterator over the ancestors of a domain, starting at its parent.
+   */
+  class ancestors_iterator {
+    typedef ancestors_iterator self_t;
+
+    const graph_t  * _graph = nullptr;
+    graph_vertex_t   _vx    = boost::graph_traits<graph_t>::null_vertex();
+
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef graph_vertex_t            value_type;
+    typedef std::ptrdiff_t            difference_type;
+    typedef const graph_vertex_t *    pointer;
+    typedef const graph_vertex_t &    reference;
+
+    ancestors_iterator() = default;
+
+    ancestors_iterator(const graph_t & g, graph_vertex_t vx)
+    : _graph(&g)
+    , _vx(vx) {
+      ++(*this);
+    }
+
+    inline reference operator*() const { return _vx; }
+
+    self_t & operator++() {
+      auto vx = _vx;
+      _vx     = boost::graph_traits<graph_t>::null_vertex();
+      for (auto edge_range = in_edges(vx, *_graph);
+           edge_range.first != edge_range.second;
+           ++edge_range.first) {
+        if ((*_graph)[*edge_range.first].type == edge_type::contains) {
+          _vx = source(*edge_range.first, *_graph);
+          break;
+        }
+      }
+      return *this;
+    }
+
+    self_t operator++(int) {
+      self_t prev = *this;
+      ++(*this);
+      return prev;
+    }
+
+    inline bool operator==(const self_t & rhs) const { return _vx == rhs._vx; }
+    inline bool operator!=(const self_t & rhs) const { return _vx != rhs._vx; }
+  };
+
+  /**
+   * Traversal of the visible descendants of a domain in pre-order.
+   * Holds a stack of the subdomain edges of open domains.
+   */
+  class descendants_traversal {
+    const graph_t  * _graph;
+    graph_vertex_t   _vx;
+    std::vector<std::pair<graph_out_edge_iterator_t,
+                          graph_out_edge_iterator_t> >
+                     _open_edges;
+
+   public:
+    descendants_traversal(const graph_t & g, graph_vertex_t vx)
+    : _graph(&g)
+    , _vx(vx) {
+      advance();
+    }
+
+    /// Current descendant, null vertex when the traversal is complete.
+    inline graph_vertex_t vertex() const noexcept { return _vx; }
+
+    void advance() {
+      _open_edges.push_back(out_edges(_vx, *_graph));
+      _vx = boost::graph_traits<graph_t>::null_vertex();
+      while (!_open_edges.empty()) {
+        auto & edges = _open_edges.back();
+        for (; edges.first != edges.second; ++edges.first) {
+          auto sub_vx = target(*edges.first, *_graph);
+          if ((*_graph)[*edges.first].type == edge_type::contains &&
+              (*_graph)[sub_vx].state != vertex_state::hidden) {
+            ++edges.first;
+            _vx = sub_vx;
+            return;
+          }
+        }
+        _open_edges.pop_back();
+      }
+    }
+  };
+
+  /**
+   * Traversal of the visible descendants of a domain in post-order.
+   * Holds a stack of the open domains and their remaining subdomain
+   * edges, the bottom entry is the domain of the traversal.
+   */
+  class descendants_inv_traversal {
+    struct open_domain {
+      graph_vertex_t            vx;
+      graph_out_edge_iterator_t edges_it;
+      graph_out_edge_iterator_t edges_end;
+    };
+
+    const graph_t            * _graph;
+    std::vector<open_domain>   _open_domains;
+
+   public:
+    descendants_inv_traversal(const graph_t & g, graph_vertex_t vx)
+    : _graph(&g) {
+      open(vx);
+      descend();
+    }
+
+    /// Current descendant, null vertex when the traversal is complete.
+    inline graph_vertex_t vertex() const noexcept {
+      return _open_domains.empty()
+             ? boost::graph_traits<graph_t>::null_vertex()
+             : _open_domains.back().vx;
+    }
+
+    void advance() {
+      _open_domains.pop_back();
+      descend();
+    }
+
+   private:
+    void open(graph_vertex_t vx) {
+      auto edge_range = out_edges(vx, *_graph);
+      _open_domains.push_back(
+        open_domain { vx, edge_range.first, edge_range.second });
+    }
+
+    /* Open first visible subdomains down to a leaf, the traversal is
+     * complete when only the traversal's domain remains. */
+    void descend() {
+      while (!_open_domains.empty()) {
+        auto & top = _open_domains.back();
+        for (; top.edges_it != top.edges_end; ++top.edges_it) {
+          auto sub_vx = target(*top.edges_it, *_graph);
+          if ((*_graph)[*top.edges_it].type == edge_type::contains &&
+              (*_graph)[sub_vx].state != vertex_state::hidden) {
+            break;
+          }
+        }
+        if (top.edges_it == top.edges_end) {
+          break;
+        }
+        auto sub_vx = target(*top.edges_it++, *_graph);
+        open(sub_vx);
+      }
+      if (_open_domains.size() == 1) {
+        _open_domains.clear();
+      }
+    }
+  };
+
+  /**
+   * Single-pass iterator over the vertices of a traversal. Iterators of
+   * a range share the range's traversal state, copying an iterator does
+   * not copy the traversal's stack.
+   */
+  template <class Traversal>
+  class traversal_iterator {
+    typedef traversal_iterator<Traversal> self_t;
+
+    Traversal * _traversal = nullptr;
+
+   public:
+    typedef std::input_iterator_tag   iterator_category;
+    typedef graph_vertex_t            value_type;
+    typedef std::ptrdiff_t            difference_type;
+    typedef const graph_vertex_t *    pointer;
+    typedef graph_vertex_t            reference;
+
+    /// Result of postfix increment, refers to the previous vertex.
+    struct postfix_proxy {
+      graph_vertex_t vx;
+      inline reference operator*() const { return vx; }
+    };
+
+    traversal_iterator() = default;
+
+    explicit traversal_iterator(Traversal & traversal)
+    : _traversal(&traversal)
+    { }
+
+    inline reference operator*() const { return _traversal->vertex(); }
+
+    self_t & operator++() {
+      _traversal->advance();
+      return *this;
+    }
+
+    postfix_proxy operator++(int) {
+      postfix_proxy prev { **this };
+      ++(*this);
+      return prev;
+    }
+
+    inline bool operator==(const self_t & rhs) const {
+      return vertex() == rhs.vertex();
+    }
+    inline bool operator!=(const self_t & rhs) const {
+      return !(*this == rhs);
+    }
+
+   private:
+    inline graph_vertex_t vertex() const {
+      return (_traversal == nullptr)
+             ? boost::graph_traits<graph_t>::null_vertex()
+             : _traversal->vertex();
+    }
+  };
+
+  typedef traversal_iterator<descendants_traversal>
+    descendants_iterator;
+  typedef traversal_iterator<descendants_inv_traversal>
+    descendants_inv_iterator;
+
+  /**
+   * Single-pass range of vertices of a traversal that owns the
+   * traversal state of its iterators.
+   */
+  template <class Traversal>
+  class traversal_range {
+    Traversal _traversal;
+
+   public:
+    typedef traversal_iterator<Traversal> iterator;
+
+    traversal_range(const graph_t & g, graph_vertex_t vx)
+    : _traversal(g, vx)
+    { }
+
+    inline iterator begin() { return iterator(_traversal); }
+    inline iterator end()   { return iterator(); }
+    inline bool     empty() const {
+      return _traversal.vertex() ==
+               boost::graph_traits<graph_t>::null_vertex();
+    }
+  };
+
+  /**
+   * Range of domain vertices as pair of iterators.
+   */
+  template <class Iterator>
+  struct vertex_range {
+    Iterator first;
+    Iterator last;
+
+    inline Iterator begin() const { return first; }
+    inline Iterator end()   const { return last;  }
+    inline bool     empty() const { return first == last; }
+  };
+
   friend std::ostream & operator<<(
     std::ostream                  & os,
     const dyloc::topology         & topo);
@@ -176,7 +564,37 @@ class topology {
   typedef std::unordered_map<std::string, locality_domain> domain_map;
 
  private:
-  const unit_mapping                             * _unit_mapping;
+  /**
+   * Hosts and units of a node in the order in which the node's subtree
+   * is built: the node host followed by its module hosts, and units in
+   * order of their hosts.
+   */
+  struct node_layout {
+    std::vector<std::string>        hosts;
+    std::vector<int>                host_ids;
+    std::vector<dart_global_unit_t> unit_ids;
+    /// Position of units in \c unit_ids by global unit id, only
+    /// specified in layouts of template nodes.
+    std::unordered_map<int, int>    unit_positions;
+  };
+
+  /**
+   * Node subtree that is symmetric to the subtree of a template node and
+   * is not contained in the topology graph until it is expanded.
+   * Its domains are derived from the template's domains by substituting
+   * hosts and units at the same position in the nodes' layouts.
+   */
+  struct symmetric_instance {
+    graph_vertex_t node_vertex;
+    graph_vertex_t template_vertex;
+    node_layout    layout;
+    bool           expanded = false;
+  };
+
+ private:
+  /// Unit mapping of this topology, shared with copies of the topology
+  /// and replaced instead of modified.
+  std::shared_ptr<const unit_mapping>              _unit_mapping;
 
   /// Topological structure, represents connections between locality
   /// domains, disregarding locality domain properties.
@@ -188,23 +606,74 @@ class topology {
   std::unordered_map<std::string, graph_vertex_t>  _domain_vertices;
   /// Maps global unit id to topology graph vertex.
   std::unordered_map<int,         graph_vertex_t>  _unit_vertices;
-  
+  /// Layouts of template nodes of symmetric instances by node vertex.
+  std::unordered_map<graph_vertex_t, node_layout>  _symmetry_templates;
+  /// Node subtrees stored as instances of a template node subtree.
+  std::vector<symmetric_instance>                  _symmetric_instances;
+  /// Maps node domain tag to its unexpanded symmetric instance.
+  std::unordered_map<std::string, int>             _instance_nodes;
+  /// Maps global unit id to its unexpanded symmetric instance and the
+  /// unit's position in the instance's node layout.
+  std::unordered_map<int, std::pair<int, int> >    _instance_units;
+  /// Domains in unexpanded symmetric instances that have been accessed
+  /// via \c operator[], retained when their instance is expanded.
+  domain_map                                       _instance_domains;
+  /// Vertices of domains by scope, in order of vertex descriptors.
+  std::unordered_map<int, std::vector<graph_vertex_t> >
+                                                   _scope_index;
+  /// Vertices of domains by host id, in order of vertex descriptors.
+  std::vector<std::vector<graph_vertex_t> >        _host_index;
+  /// Vertices of domains by level, in order of vertex descriptors.
+  std::vector<std::vector<graph_vertex_t> >        _level_index;
+
  public:
   topology() = delete;
 
+  topology(
+    dart_team_t                         team,
+    const host_topology               & host_topo,
+    std::shared_ptr<const unit_mapping>   unit_map)
+  : _unit_mapping(std::move(unit_map)) {
+    build_hierarchy(team, host_topo);
+  }
+
+  /**
+   * Builds the topology with a copy of the specified unit mapping.
+   */
   topology(
     dart_team_t           team,
     const host_topology & host_topo,
     const unit_mapping  & unit_map)
-  : _unit_mapping(&unit_map) {
-    build_hierarchy(team, host_topo);
-  }
- 
+  : topology(team, host_topo, std::make_shared<const unit_mapping>(unit_map))
+  { }
+
+  /**
+   * Restore topology from a binary image created by
+   * \c topology::serialize.
+   */
+  topology(
+    const topology_image                & image,
+    std::shared_ptr<const unit_mapping>   unit_map);
+
+  topology(
+    const topology_image & image,
+    const unit_mapping   & unit_map)
+  : topology(image, std::make_shared<const unit_mapping>(unit_map))
+  { }
+
   topology(const topology & other)
   : _unit_mapping(other._unit_mapping)
   , _domains(other._domains)
   , _domain_vertices(other._domain_vertices)
-  , _unit_vertices(other._unit_vertices) {
+  , _unit_vertices(other._unit_vertices)
+  , _symmetry_templates(other._symmetry_templates)
+  , _symmetric_instances(other._symmetric_instances)
+  , _instance_nodes(other._instance_nodes)
+  , _instance_units(other._instance_units)
+  , _instance_domains(other._instance_domains)
+  , _scope_index(other._scope_index)
+  , _host_index(other._host_index)
+  , _level_index(other._level_index) {
     DYLOC_LOG_DEBUG("dylocxx::topology.topology(other)", "copy constructor");
   	typedef graph_t::vertex_descriptor vertex_t;
     typedef std::map<vertex_t, vertex_t> vertex_map_t;
@@ -218,23 +687,139 @@ class topology {
   topology(topology && other)           = default;
   topology & operator=(topology && rhs) = default;
 
+  /**
+   * Binary image of the topology's graph, domains and unit index in a
+   * flat, position-independent buffer, see \c topology_image.
+   * Unit localities of the topology's unit mapping are included if
+   * \c with_unit_mapping is set.
+   */
+  std::vector<char> serialize(bool with_unit_mapping = false) const;
+
   inline const graph_t & graph() const noexcept {
     return _graph;
   }
 
+  inline const unit_mapping & unit_map() const noexcept {
+    return *_unit_mapping;
+  }
+
+  inline const std::shared_ptr<const unit_mapping> &
+  shared_unit_map() const noexcept {
+    return _unit_mapping;
+  }
+
+  /**
+   * Replace the topology's unit mapping, e.g. by a mapping with updated
+   * localities of moved units. Copies of the topology keep the mapping
+   * they have been created with.
+   */
+  void replace_unit_map(std::shared_ptr<const unit_mapping> unit_map) {
+    _unit_mapping = std::move(unit_map);
+  }
+
+  /**
+   * Whether subtrees of nodes with identical hardware configuration are
+   * stored as instances of a single template subtree.
+   *
+   * Topologies are compressed if built with environment variable
+   * DYLOC_TOPOLOGY_SYMMETRY set to "compressed". Domains in instance
+   * subtrees are not contained in \c graph() and \c domains(), they are
+   * resolved by \c domain, \c unit_domain_tag, \c scope_domain_tags
+   * and \c distance. Operations that modify the domain hierarchy expand
+   * all instances first.
+   */
+  inline bool is_compressed() const noexcept {
+    return !_instance_nodes.empty();
+  }
+
+  /**
+   * Add the domains of all symmetric node instances to the topology
+   * graph.
+   */
+  void expand();
+
+  /**
+   * Rebuild the graph without vertices of hidden or removed domains and
+   * return the number of vertices removed.
+   * Invalidates graph vertex descriptors obtained from the topology.
+   *
+   * Compaction is on demand by default. If a ratio > 0 is specified in
+   * environment variable \c DYLOC_TOPOLOGY_GC_RATIO, domain removals
+   * compact the graph automatically when the share of removed vertices
+   * exceeds the ratio.
+   */
+  size_t compact();
+
+  /**
+   * Copy of the domain with the specified tag, also resolved in
+   * unexpanded symmetric node instances.
+   */
+  locality_domain domain(const std::string & domain_tag) const;
+
+  /**
+   * Tag of the UNIT domain of the specified unit, also resolved in
+   * unexpanded symmetric node instances.
+   */
+  std::string unit_domain_tag(dart_global_unit_t unit_id) const;
+
   const std::unordered_map<std::string, locality_domain> & domains() const {
     return _domains;
   }
 
+  const std::unordered_map<std::string, graph_vertex_t> &
+  domain_vertices() const {
+    return _domain_vertices;
+  }
+
+  /**
+   * Domain at the specified vertex, or \c nullptr if the domain is hidden
+   * or has been removed.
+   */
+  const locality_domain * visible_domain(graph_vertex_t vx) const {
+    if (_graph[vx].state == vertex_state::hidden) {
+      return nullptr;
+    }
+    auto domain_it = _domains.find(_graph[vx].domain_tag);
+    return (domain_it == _domains.end())
+           ? nullptr
+           : &domain_it->second;
+  }
+
+  inline bool is_visible(graph_vertex_t vx) const {
+    return visible_domain(vx) != nullptr;
+  }
+
+  /**
+   * Domain with the specified tag, also resolved in unexpanded symmetric
+   * node instances without expanding them.
+   * Throws \c dyloc::exception::invalid_argument if the topology
+   * contains no domain with the specified tag.
+   */
   locality_domain & operator[](const std::string & tag) {
-    return _domains[tag];
+    auto domain_it = _domains.find(tag);
+    if (domain_it != _domains.end()) {
+      return domain_it->second;
+    }
+    if (is_compressed() && symmetric_instance_of(tag, nullptr) >= 0) {
+      return accessed_instance_domain(tag);
+    }
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "no domain with tag " << tag);
   }
 
   const locality_domain & operator[](const std::string & tag) const {
     return _domains.at(tag);
   }
 
+  /**
+   * UNIT domain of the specified unit, also resolved in unexpanded
+   * symmetric node instances without expanding them.
+   */
   locality_domain & operator[](dart_global_unit_t uid) {
+    if (is_compressed() && _instance_units.count(uid.id) > 0) {
+      return accessed_instance_domain(unit_domain_tag(uid));
+    }
     return _domains.at(_graph[_unit_vertices.at(uid.id)].domain_tag);
   }
 
@@ -242,24 +827,74 @@ class topology {
     return _domains.at(_graph[_unit_vertices.at(uid.id)].domain_tag);
   }
 
+  /**
+   * Visible subdomains of the domain at the specified vertex.
+   *
+   * Vertex descriptors and ranges are invalidated by \c compact, also
+   * when called from domain removals, see \c DYLOC_TOPOLOGY_GC_RATIO.
+   */
+  vertex_range<children_iterator> children(graph_vertex_t vx) const {
+    return { children_iterator(_graph, vx, false),
+             children_iterator(_graph, vx, true) };
+  }
+
+  /**
+   * Ancestors of the domain at the specified vertex, from its parent up
+   * to the root domain. Invalidated by \c compact.
+   */
+  vertex_range<ancestors_iterator> ancestors(graph_vertex_t vx) const {
+    return { ancestors_iterator(_graph, vx), ancestors_iterator() };
+  }
+
+  /**
+   * Visible descendants of the domain at the specified vertex in
+   * pre-order, as single-pass range. Invalidated by \c compact.
+   */
+  traversal_range<descendants_traversal> descendants(
+    graph_vertex_t vx) const {
+    return traversal_range<descendants_traversal>(_graph, vx);
+  }
+
+  /**
+   * Visible descendants of the domain at the specified vertex in
+   * post-order, as single-pass range. Invalidated by \c compact.
+   */
+  traversal_range<descendants_inv_traversal> descendants_inv(
+    graph_vertex_t vx) const {
+    return traversal_range<descendants_inv_traversal>(_graph, vx);
+  }
+
   template <class Visitor>
   void depth_first_search(Visitor & vis) {
     selective_dfs_visitor<Visitor> sel_vis(vis);
-    boost::depth_first_search(_graph, visitor(sel_vis));
+    boost::filtered_graph<graph_t, contains_edge_filter>
+      hierarchy(_graph, contains_edge_filter(_graph));
+    boost::depth_first_search(hierarchy, visitor(sel_vis));
   }
 
   template <class Visitor>
   void depth_first_search(Visitor & vis) const {
     selective_dfs_visitor<Visitor> sel_vis(vis);
-    boost::depth_first_search(_graph, visitor(sel_vis));
+    boost::filtered_graph<const graph_t, contains_edge_filter>
+      hierarchy(_graph, contains_edge_filter(_graph));
+    boost::depth_first_search(hierarchy, visitor(sel_vis));
   }
 
-  template <class FilterPredicate>
-  void filter(
-         const FilterPredicate & filter) {
-    dyloc__unused(filter);
-    // filtered_graph<graph_t, filter> fg(_graph, filter);
-  }
+  /**
+   * Read-only snapshot of the domain hierarchy for traversals in
+   * contiguous memory.
+   * Defined in \c dylocxx/frozen_topology.h.
+   */
+  frozen_topology freeze() const;
+
+  /**
+   * View of the domains satisfying the specified predicate on
+   * \c locality_domain, evaluated lazily without copying the graph.
+   * Defined in \c dylocxx/topology_view.h.
+   */
+  template <class DomainPredicate>
+  topology_view<DomainPredicate> filter(
+         const DomainPredicate & pred) const;
 
   /**
    * Return lowest common ancestor of the domains specified by the given
@@ -294,6 +929,20 @@ class topology {
     const std::string & domain_tag,
     const std::string & domain_tag_new_parent);
 
+  /**
+   * Move the UNIT domain of the specified unit to the CORE domain at the
+   * locality scopes in the unit's updated hardware information.
+   * Missing domains on the path to the CORE domain are added, domains
+   * left without units are removed. Subdomains of the unit's module
+   * are relabeled and capacities of the unit's ancestors updated.
+   *
+   * Throws \c dyloc::exception::invalid_argument if the unit's host
+   * has changed.
+   */
+  void move_unit_domain(
+    dart_global_unit_t     unit_id,
+    const dyloc_hwinfo_t & unit_hwinfo);
+
   /**
    * Move domains with specified domain tags into separate group domain.
    * The group domain will be created as child node of the grouped domains'
@@ -318,134 +967,209 @@ class topology {
   void exclude_domains(
     const Iterator & domain_tag_first,
     const Sentinel & domain_tag_last) {
+    if (is_compressed()) { expand(); }
     for (auto it = domain_tag_first; it != domain_tag_last; ++it) {
-      exclude_domain(*it);
+      auto domain_vx_it = _domain_vertices.find(*it);
+      if (domain_vx_it != _domain_vertices.end() &&
+          _graph[domain_vx_it->second].state != vertex_state::hidden) {
+        remove_subtree(domain_vx_it->second);
+      }
     }
+    collect_garbage();
   }
 
+  /**
+   * Remove the domain with the specified tag and its subdomains.
+   */
   void exclude_domain(const std::string & tag) {
-    _graph[_domain_vertices[tag]].state = vertex_state::hidden;
-    auto sub_v_range = boost::adjacent_vertices(
-                         _domain_vertices[tag],
-                         _graph);
-    for (auto sv = sub_v_range.first; sv != sub_v_range.second; ++sv) {
-      _graph[*sv].state = vertex_state::hidden;
-      exclude_domain(_graph[*sv].domain_tag);
-    }
-    _domains.erase(_domains.find(tag));
+    const std::string * tag_first = &tag;
+    exclude_domains(tag_first, tag_first + 1);
   }
 
+  /**
+   * Restrict the topology to the specified domains, their ancestors and
+   * their subdomains.
+   * Subdomains of the selected domains are relabeled and capacities are
+   * accumulated once after all domains have been removed.
+   */
   template <class Iterator, class Sentinel>
   void select_domains(
          const Iterator & domain_tag_first,
          const Sentinel & domain_tag_last) {
+    if (is_compressed()) { expand(); }
+    std::vector<graph_vertex_t> selected_vxs;
     for (auto it = domain_tag_first; it != domain_tag_last; ++it) {
-      _graph[_domain_vertices[*it]].state = vertex_state::selected;
+      selected_vxs.push_back(_domain_vertices.at(*it));
     }
-    remove_domains([&](const std::string & tag) {
-                         return _graph[_domain_vertices[tag]].state !=
-                                  vertex_state::selected;
-                       });
+    select_subtrees(selected_vxs);
+    collect_garbage();
   }
 
   void select_domain(
          const std::string & domain_tag) {
-    _graph[_domain_vertices[domain_tag]].state = vertex_state::selected;
-    for_each_ancestor(
-      domain_tag,
-      [&](const locality_domain & ancestor_dom) {
-            _graph[_domain_vertices[ancestor_dom.domain_tag]].state
-               = vertex_state::selected;
-         });
-    for_each_descendant(
-      domain_tag,
-      [&](const locality_domain & desc_dom) {
-            _graph[_domain_vertices[desc_dom.domain_tag]].state
-               = vertex_state::selected;
-         });
-    remove_domains(
-      ".",
-      [&](const locality_domain & dom) {
-           return _graph[_domain_vertices[dom.domain_tag]].state !=
-                    vertex_state::selected;
-         });
-#if TMP_DEBUGGING
-    update_domain_attributes(".");
-#else
-    for_each_descendant(
-      domain_tag,
-      [&](const locality_domain & desc_dom) {
-        update_domain_attributes(desc_dom.domain_tag);
-      });
-#endif
-    update_domain_capacities(".");
+    const std::string * tag_first = &domain_tag;
+    select_domains(tag_first, tag_first + 1);
   }
 
+  /**
+   * Remove domains below the specified domain that satisfy the predicate,
+   * together with their subdomains.
+   */
   template <class UnaryPredicate>
   void remove_domains(const std::string & tag, UnaryPredicate pred) {
-    auto & domain = _domains[tag];
-    if (!pred(domain)) {
-      for_each_descendant_inv(
-        tag,
-        [&](const locality_domain & dom) {
-          remove_domains(dom.domain_tag, pred);
-        });
-    } else {
-      DYLOC_LOG_TRACE("dylocxx::topology.remove_domain",
-                      "remove:", tag);
-      _graph[_domain_vertices[tag]].state = vertex_state::hidden;
-      boost::clear_vertex(_domain_vertices[tag], _graph);
-      // boost::remove_vertex(_domain_vertices[tag], _graph);
-      _domains.erase(_domains.find(tag));
-      // _domain_vertices.erase(_domain_vertices.find(tag));
+    if (is_compressed()) { expand(); }
+    std::vector<graph_vertex_t> open_vxs(1, _domain_vertices.at(tag));
+    std::vector<graph_vertex_t> removed_vxs;
+    while (!open_vxs.empty()) {
+      auto vx = open_vxs.back();
+      open_vxs.pop_back();
+      if (pred(_domains.at(_graph[vx].domain_tag))) {
+        DYLOC_LOG_TRACE("dylocxx::topology.remove_domains",
+                        "remove:", _graph[vx].domain_tag);
+        removed_vxs.push_back(vx);
+        continue;
+      }
+      for (auto sub_vx : children(vx)) {
+        open_vxs.push_back(sub_vx);
+      }
+    }
+    for (auto vx : removed_vxs) {
+      remove_subtree(vx);
     }
   }
 
   template <class UnaryPredicate>
   void for_each_ancestor(const std::string & tag, UnaryPredicate func) {
-    auto & domain_vx = _domain_vertices[tag];
-    for (auto domain_edges = in_edges(domain_vx, _graph);
-         domain_edges.first != domain_edges.second;
-         ++domain_edges.first) {
-      auto   parent_vx = source(*domain_edges.first, _graph);
-      auto & parent    = _domains[_graph[parent_vx].domain_tag];
-      func(parent);
-      for_each_ancestor(parent.domain_tag, func);
+    for (auto ancestor_vx : ancestors(_domain_vertices.at(tag))) {
+      func(_domains.at(_graph[ancestor_vx].domain_tag));
     }
   }
 
   template <class UnaryPredicate>
   void for_each_descendant(const std::string & tag, UnaryPredicate func) {
-    auto & domain_vx = _domain_vertices[tag];
-    for (auto domain_edges = out_edges(domain_vx, _graph);
-         domain_edges.first != domain_edges.second;
-         ++domain_edges.first) {
-      auto   child_vx = target(*domain_edges.first, _graph);
-      auto & child    = _domains[_graph[child_vx].domain_tag];
-      func(child);
-      for_each_descendant(child.domain_tag, func);
+    for (auto desc_vx : descendants(_domain_vertices.at(tag))) {
+      func(_domains.at(_graph[desc_vx].domain_tag));
     }
   }
 
+  /**
+   * Calls the function for descendants in post-order, the function must
+   * not add or remove domains.
+   */
   template <class UnaryPredicate>
   void for_each_descendant_inv(const std::string & tag, UnaryPredicate func) {
-    auto & domain_vx = _domain_vertices[tag];
-    for (auto domain_edges = out_edges(domain_vx, _graph);
-         domain_edges.first != domain_edges.second;
-         ++domain_edges.first) {
-      auto   child_vx = target(*domain_edges.first, _graph);
-      auto & child    = _domains[_graph[child_vx].domain_tag];
-      for_each_descendant_inv(child.domain_tag, func);
-      func(child);
+    for (auto desc_vx : descendants_inv(_domain_vertices.at(tag))) {
+      func(_domains.at(_graph[desc_vx].domain_tag));
     }
   }
 
+
   /**
    * Resolve tags of all domains at specified scope.
    */
   std::vector<std::string> scope_domain_tags(
          dyloc_locality_scope_t scope) const;
 
+  /**
+   * Vertices of all domains at the specified scope.
+   *
+   * Domains are indexed by scope, host and level when added to the
+   * topology, queries do not depend on the total number of domains.
+   * Indices are not updated when attributes of a domain are modified
+   * via \c operator[], and do not contain domains of unexpanded
+   * symmetric instances, see \c is_compressed.
+   * Returned vectors are modified by domain removals and their vertices
+   * are invalidated by \c compact.
+   */
+  const std::vector<graph_vertex_t> & scope_domains(
+         dyloc_locality_scope_t scope) const;
+
+  /**
+   * Vertices of all domains at the host with the specified id, see
+   * \c locality_domain::host_id. Invalidated by \c compact.
+   */
+  const std::vector<graph_vertex_t> & host_domains(
+         int host_id) const;
+
+  /**
+   * Vertices of all domains at the specified host, resolved to its id
+   * in the specified host topology.
+   */
+  const std::vector<graph_vertex_t> & host_domains(
+         const host_topology & host_topo,
+         const std::string   & host) const {
+    return host_domains(host_topo.host_id(host));
+  }
+
+  /**
+   * Vertices of all domains at the specified level, invalidated by
+   * \c compact.
+   */
+  const std::vector<graph_vertex_t> & level_domains(
+         int level) const;
+
+  /**
+   * Domain of the specified vertex.
+   */
+  inline const locality_domain & domain(graph_vertex_t vx) const {
+    return _domains.at(_graph[vx].domain_tag);
+  }
+
+  /**
+   * Communication distance between two domains.
+   *
+   * Uses the \c adjacent edge between the domains or their lowest
+   * connected ancestors if available, otherwise the distance of the
+   * \c contains edges at the domains' lowest common ancestor.
+   */
+  int distance(
+         const std::string & domain_tag_a,
+         const std::string & domain_tag_b) const;
+
+  /**
+   * Measure cache line transfer latencies between representative cores
+   * of sibling CACHE, PACKAGE and NUMA domains and assign them in
+   * nanoseconds to the \c adjacent edges between sibling domains and the
+   * \c contains edges of their parent domain.
+   *
+   * Collective operation on the topology's team. The first unit at every
+   * host probes the host's domains while the other units wait, the
+   * measured latencies are exchanged such that all units assign the
+   * same distances to domains at all hosts.
+   */
+  void measure_latencies(int num_rounds = 1000);
+
+  /**
+   * Assign latencies like \c measure_latencies(int) with the latency in
+   * nanoseconds between two CPUs obtained from the specified function,
+   * or -1 if unknown.
+   */
+  void measure_latencies(
+    const std::function<int(int cpu_id_a, int cpu_id_b)> & cpu_latency);
+
+  /**
+   * Partition the specified number of elements into contiguous blocks
+   * of units in the order of the domain hierarchy, block sizes are
+   * proportional to the units' capacities.
+   *
+   * Capacities are obtained from the units' hardware info, blocks are
+   * equally sized if a capacity is not available for every unit.
+   */
+  std::vector<unit_block> partition(
+         size_t        total_elements,
+         weight_policy policy = weight_policy::num_cores) const;
+
+  /**
+   * Partition the specified number of elements into contiguous blocks
+   * of units in the order of the domain hierarchy, block sizes are
+   * proportional to the weights of the units' UNIT domains, e.g. from
+   * measured throughput.
+   */
+  std::vector<unit_block> partition(
+         size_t                                              total_elements,
+         const std::function<double(const locality_domain &)> & unit_weight)
+         const;
+
 // Jakub TODO
   void add_distance_metric(std::string metric_name, std::function<int(int)> fn){
     _distance_metrics[metric_name]=fn;
@@ -467,16 +1191,101 @@ class topology {
           dart_team_t           team,
           const host_topology & host_topo);
 
+  /**
+   * Domain hierarchy below a node domain, built independently from the
+   * topology graph and merged into it once complete.
+   * The subtree's root domain at index 0 is the node domain.
+   */
+  struct domain_subtree {
+    /// Domains in pre-order, deque for stable references on insertion.
+    std::deque<locality_domain> domains;
+    /// Index of parent domain by domain index, -1 for the root domain.
+    std::vector<int>            parents;
+    /// Distance of contains edge from parent domain by domain index.
+    std::vector<int>            distances;
+    /// Number of subdomains by domain index.
+    std::vector<int>            arities;
+
+    int add(int parent_idx, locality_domain && domain, int distance);
+  };
+
   void build_node_level(
-          const host_topology & host_topo,
-          locality_domain     & node_domain,
-          graph_vertex_t      & node_domain_vertex);
+          const host_topology                 & host_topo,
+          const std::vector<dart_team_unit_t> & unit_lids,
+          domain_subtree                      & node_subtree) const;
 
   void build_module_level(
+          const std::vector<dart_team_unit_t> & unit_lids,
+          domain_subtree                      & node_subtree,
+          int                                   module_domain_idx,
+          int                                   module_scope_level) const;
+
+  /**
+   * Add domains of a node subtree to the topology graph and domain
+   * tables below the node domain's vertex.
+   */
+  std::vector<graph_vertex_t> merge_subtree(
+          domain_subtree && node_subtree,
+          graph_vertex_t    node_domain_vertex);
+
+  node_layout build_node_layout(
           const host_topology & host_topo,
-          locality_domain     & module_domain,
-          graph_vertex_t      & node_domain_vertex,
-          int                   module_scope_level);
+          int                   node_host_id) const;
+
+  /**
+   * Hardware configuration of a node's hosts and units that determines
+   * the structure of the node's subtree, equal for symmetric nodes.
+   */
+  std::string node_shape(
+          const host_topology                 & host_topo,
+          const std::vector<dart_team_unit_t> & unit_lids,
+          const node_layout                   & layout) const;
+
+  /**
+   * Index of the unexpanded symmetric instance containing the specified
+   * domain below its node domain, or -1. Resolves the tag of the
+   * corresponding template domain if \c template_tag is specified.
+   */
+  int  symmetric_instance_of(
+          const std::string & domain_tag,
+          std::string       * template_tag) const;
+
+  /**
+   * Domain in a symmetric instance derived from the corresponding domain
+   * in the instance's template subtree.
+   */
+  locality_domain instance_domain(
+          const symmetric_instance & instance,
+          const locality_domain    & template_domain) const;
+
+  /**
+   * Domain in an unexpanded symmetric instance, derived from its
+   * template domain on first access.
+   */
+  locality_domain & accessed_instance_domain(const std::string & domain_tag);
+
+  void expand_instance(int instance_idx);
+
+  /**
+   * Add the domain of the specified vertex to the scope, host and level
+   * indices, or remove it before the domain is erased.
+   */
+  void index_domain(graph_vertex_t vx);
+
+  void unindex_domain(graph_vertex_t vx);
+
+  /**
+   * Compact the graph if the share of vertices of removed domains exceeds
+   * the configured garbage ratio.
+   */
+  void collect_garbage();
+
+  /**
+   * Add \c adjacent edges between NUMA domains of the same host
+   * weighted by their distance in the host's NUMA distance matrix.
+   */
+  void build_numa_adjacency(
+          const host_topology & host_topo);
 
   void relink_to_parent(
           const std::string & domain_tag,
@@ -496,13 +1305,62 @@ class topology {
   void update_domain_capacities(const std::string & tag);
   void update_domain_attributes(const std::string & tag);
 
+  /**
+   * Set capacities of the domain at the specified vertex to the sum of
+   * its subdomains' capacities.
+   */
+  void accumulate_domain_capacities(graph_vertex_t vx);
+
+  /**
+   * Hide the domain at the specified vertex and its subdomains, remove
+   * them from domains and indices and disconnect their vertices.
+   */
+  void remove_subtree(graph_vertex_t vx);
+
+  /**
+   * Remove all domains that are not ancestors or descendants of the
+   * specified domains in a single pass, then relabel the selected
+   * subtrees and update capacities.
+   */
+  void select_subtrees(const std::vector<graph_vertex_t> & selected_vxs);
+
   int  subdomain_distance(
           const std::string & parent_tag,
           const std::string & child_tag);
+
+  /**
+   * Number of immediate subdomains in the domain hierarchy.
+   */
+  int  subdomain_arity(graph_vertex_t domain_vx) const;
+
+  /**
+   * Vertices on the path from the specified domain up to the root
+   * domain, including both.
+   */
+  std::vector<graph_vertex_t> ancestor_path(graph_vertex_t domain_vx) const;
+
+  /**
+   * Assign distance to the \c adjacent edges between two domains,
+   * adding the edges if they do not exist.
+   */
+  void set_adjacent_distance(
+          graph_vertex_t domain_vx_a,
+          graph_vertex_t domain_vx_b,
+          int            distance);
+
+  /**
+   * Assign distance to the \c adjacent edge from source to target
+   * domain, adding the edge if it does not exist.
+   */
+  void set_adjacent_edge(
+          graph_vertex_t src_domain_vx,
+          graph_vertex_t dst_domain_vx,
+          int            distance);
 };
 
 } // namespace dyloc
 
 #include <dylocxx/impl/topology.impl.h>
+#include <dylocxx/topology_view.h>
 
 #endif // DYLOCXX__TOPOLOGY_H__INCLUDED
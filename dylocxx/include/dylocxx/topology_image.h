@@ -0,0 +1,202 @@
+#ifndef DYLOCXX__TOPOLOGY_IMAGE_H__INCLUDED
+#define DYLOCXX__TOPOLOGY_IMAGE_H__INCLUDED
+
+#include <dyloc/common/types.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+
+namespace dyloc {
+
+/*
+ * Binary image of a topology in a flat buffer.
+ *
+ * All references within the image are byte offsets relative to the
+ * beginning of the buffer, so images can be copied, broadcast and mapped
+ * at any address. Records are stored in host byte order and are 8-byte
+ * aligned.
+ *
+ *   [ header | domains | edges | unit index | unit ids | tag index |
+ *     unit localities | string pool ]
+ *
+ * Domain records are in order of their topology graph vertices, edges
+ * refer to domains by record index and are ordered by source domain.
+ * The unit index is ordered by unit id and the tag index lists visible
+ * domains in lexicographic order of their tags, so images can be queried
+ * in place without restoring the topology.
+ * Unit localities are optional and in order of team-relative unit ids.
+ */
+
+struct topology_image_header {
+  /// Identifies buffer as topology image, \c topology_image::magic.
+  uint32_t magic;
+  /// Image format version, \c topology_image::version.
+  uint32_t version;
+  /// Size of the image in bytes.
+  uint64_t size;
+  int32_t  team;
+  uint32_t num_domains;
+  uint32_t num_edges;
+  uint32_t num_units;
+  uint32_t num_unit_ids;
+  uint32_t num_tags;
+  uint32_t num_unit_localities;
+  /// Size of unit locality records, \c sizeof(dyloc_unit_locality_t).
+  uint32_t unit_locality_size;
+  uint64_t domains_offset;
+  uint64_t edges_offset;
+  uint64_t units_offset;
+  uint64_t unit_ids_offset;
+  uint64_t tags_offset;
+  uint64_t unit_localities_offset;
+  uint64_t strings_offset;
+  uint64_t strings_size;
+};
+
+struct topology_image_domain {
+  /// Offset of domain tag in the string pool.
+  uint64_t tag_offset;
+  /// Offset of host name in the string pool.
+  uint64_t host_offset;
+  /// Index of first unit id of the domain in the unit ids section.
+  uint64_t unit_ids_offset;
+  uint32_t num_unit_ids;
+  int32_t  scope;
+  int32_t  level;
+  int32_t  g_index;
+  int32_t  r_index;
+  int32_t  host_id;
+  int32_t  num_cores;
+  int32_t  state;
+};
+
+struct topology_image_edge {
+  uint32_t source;
+  uint32_t target;
+  int32_t  type;
+  int32_t  distance;
+};
+
+/// Maps global unit id to index of its UNIT domain record.
+struct topology_image_unit {
+  int32_t  unit_id;
+  uint32_t domain;
+};
+
+/**
+ * Non-owning read-only view of a topology image in a buffer.
+ *
+ * Only the header and section bounds are validated when the view is
+ * created. Records are checked when they are resolved via \c string,
+ * \c unit_ids, \c find_domain, \c unit_domain and \c out_edges, or all
+ * at once via \c validate_records.
+ */
+class topology_image {
+  const char * _data = nullptr;
+  size_t       _size = 0;
+
+ public:
+  static constexpr uint32_t magic   = 0x434f4c44; // "DLOC"
+  static constexpr uint32_t version = 2;
+
+ public:
+  /**
+   * Empty view that does not refer to an image and must not be queried.
+   */
+  topology_image() = default;
+
+  /**
+   * Throws \c dyloc::exception::invalid_argument if the buffer does not
+   * contain a topology image header or its sections exceed the buffer.
+   * O(1).
+   */
+  topology_image(const char * data, size_t size);
+
+  /**
+   * Throws \c dyloc::exception::invalid_argument if any record in the
+   * image refers to a string, unit id or domain record out of bounds.
+   * Required before records are accessed directly via \c domains,
+   * \c edges, \c units or \c tags. O(d + e + u + t).
+   */
+  void validate_records() const;
+
+  inline const char * data() const noexcept {
+    return _data;
+  }
+
+  inline size_t size() const noexcept {
+    return _size;
+  }
+
+  inline const topology_image_header & header() const noexcept {
+    return *reinterpret_cast<const topology_image_header *>(_data);
+  }
+
+  inline const topology_image_domain * domains() const noexcept {
+    return reinterpret_cast<const topology_image_domain *>(
+             _data + header().domains_offset);
+  }
+
+  inline const topology_image_edge * edges() const noexcept {
+    return reinterpret_cast<const topology_image_edge *>(
+             _data + header().edges_offset);
+  }
+
+  inline const topology_image_unit * units() const noexcept {
+    return reinterpret_cast<const topology_image_unit *>(
+             _data + header().units_offset);
+  }
+
+  /// Unit ids of the specified domain record, throws
+  /// \c dyloc::exception::invalid_argument if they exceed the image.
+  const int32_t * unit_ids(const topology_image_domain & domain) const;
+
+  /// Domain record indices in lexicographic order of domain tags.
+  inline const uint32_t * tags() const noexcept {
+    return reinterpret_cast<const uint32_t *>(
+             _data + header().tags_offset);
+  }
+
+  /// Unit localities by team-relative unit id, empty unless the image
+  /// has been created with unit mapping.
+  inline const dyloc_unit_locality_t * unit_localities() const noexcept {
+    return reinterpret_cast<const dyloc_unit_locality_t *>(
+             _data + header().unit_localities_offset);
+  }
+
+  /// Null-terminated string at the specified offset in the string pool,
+  /// throws \c dyloc::exception::invalid_argument if the offset exceeds
+  /// the string pool.
+  const char * string(uint64_t offset) const;
+
+  /**
+   * Domain record with the specified tag, or \c nullptr if the image
+   * contains no visible domain with this tag. O(log d).
+   */
+  const topology_image_domain * find_domain(const char * domain_tag) const;
+
+  /**
+   * Record of the UNIT domain of the unit with the specified global id,
+   * or \c nullptr if the unit is not contained in the image. O(log u).
+   */
+  const topology_image_domain * unit_domain(int32_t unit_id) const;
+
+  /**
+   * Range of edge records with the specified domain record as source.
+   * O(log e + k) for k edges in the range.
+   */
+  std::pair<const topology_image_edge *, const topology_image_edge *>
+  out_edges(uint32_t domain_index) const;
+
+ private:
+  /// Domain record at the specified index in the domain section or the
+  /// tag index, throws \c dyloc::exception::invalid_argument if the
+  /// index exceeds the domain section.
+  const topology_image_domain & domain_record(uint64_t domain_index) const;
+};
+
+} // namespace dyloc
+
+#endif // DYLOCXX__TOPOLOGY_IMAGE_H__INCLUDED
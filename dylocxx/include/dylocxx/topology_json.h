@@ -0,0 +1,39 @@
+#ifndef DYLOCXX__TOPOLOGY_JSON_H__INCLUDED
+#define DYLOCXX__TOPOLOGY_JSON_H__INCLUDED
+
+#include <iostream>
+
+
+namespace dyloc {
+
+class topology;
+
+struct json_options {
+  /// Write consecutive unit ids as ranges \c [first,last] in unit lists.
+  bool unit_ranges = false;
+  /// Indent nested domains, no whitespace is written if disabled.
+  bool indent      = true;
+};
+
+/**
+ * Writes the domain hierarchy of a topology in the JSON schema read by
+ * \c lslodo:
+ *
+ *   { "scope": "GLOBAL", "level": 0, "idx": 0, "units": [ ... ],
+ *     "hwinfo": { ... }, "ndomains": 1,
+ *     "domains": { ".0": { "scope": "NODE", ... } } }
+ *
+ * Domains are written to the stream while traversing the hierarchy,
+ * memory required does not depend on the number of domains or units.
+ * Compressed topologies are expanded into a full copy first, see
+ * \c topology::is_compressed, which requires memory proportional to
+ * the number of domains.
+ */
+void write_json(
+  std::ostream       & os,
+  const topology     & topo,
+  const json_options & options = json_options());
+
+} // namespace dyloc
+
+#endif // DYLOCXX__TOPOLOGY_JSON_H__INCLUDED
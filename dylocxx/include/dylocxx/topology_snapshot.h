@@ -0,0 +1,88 @@
+#ifndef DYLOCXX__TOPOLOGY_SNAPSHOT_H__INCLUDED
+#define DYLOCXX__TOPOLOGY_SNAPSHOT_H__INCLUDED
+
+#include <dylocxx/topology_image.h>
+#include <dylocxx/unit_mapping.h>
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+
+namespace dyloc {
+
+class topology;
+
+/**
+ * Read-only snapshot of a topology and its unit mapping in a file.
+ *
+ * Snapshot files contain a \c topology_image including unit localities.
+ * The file is mapped into memory and queried in place via \c image(),
+ * opening a snapshot does not depend on the size of the topology as only
+ * the image header and section bounds are validated, records are
+ * checked when they are accessed.
+ *
+ * Example:
+ *
+ * \code
+ *   dyloc::topology_snapshot::write("job.dloc", dyloc::team_topology());
+ *   // ... later, in a different process:
+ *   dyloc::topology_snapshot snapshot("job.dloc");
+ *   auto unit_domain = snapshot.image().unit_domain(42);
+ * \endcode
+ */
+class topology_snapshot {
+  const char *      _data = nullptr;
+  size_t            _size = 0;
+  // Copy of file contents on platforms without mmap:
+  std::vector<char> _buffer;
+  // View of the image, header validated once when the snapshot is
+  // opened:
+  topology_image    _image;
+
+ public:
+  topology_snapshot() = delete;
+
+  /**
+   * Maps the snapshot in the specified file.
+   *
+   * Throws \c dyloc::exception::runtime_config_error if the file cannot
+   * be read and \c dyloc::exception::invalid_argument if it does not
+   * contain a valid topology image.
+   */
+  explicit topology_snapshot(const std::string & file);
+
+  ~topology_snapshot();
+
+  topology_snapshot(const topology_snapshot &)             = delete;
+  topology_snapshot & operator=(const topology_snapshot &) = delete;
+
+  topology_snapshot(topology_snapshot && other);
+  topology_snapshot & operator=(topology_snapshot && other);
+
+  inline const topology_image & image() const noexcept {
+    return _image;
+  }
+
+  /**
+   * Copy of the unit mapping contained in the snapshot, required to
+   * restore the full topology from \c image().
+   */
+  dyloc::unit_mapping unit_map() const;
+
+  /**
+   * Writes a snapshot of the specified topology and its unit mapping to
+   * a file. The file is replaced atomically so processes that have
+   * mapped a previous snapshot in the same file are not affected.
+   */
+  static void write(
+    const std::string & file,
+    const topology    & topo);
+
+ private:
+  void release();
+};
+
+} // namespace dyloc
+
+#endif // DYLOCXX__TOPOLOGY_SNAPSHOT_H__INCLUDED
@@ -1,13 +1,317 @@
 #ifndef DYLOCXX__TOPOLOGY_VIEW_H__INCLUDED
 #define DYLOCXX__TOPOLOGY_VIEW_H__INCLUDED
 
+#include <dylocxx/topology.h>
+#include <dylocxx/locality_domain.h>
+#include <dylocxx/exception.h>
+
+#include <boost/graph/filtered_graph.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <string>
+
 
 namespace dyloc {
 
+/**
+ * Conjunction of domain predicates of composed views.
+ */
+template <class DomainPredicateA, class DomainPredicateB>
+struct domain_predicate_and {
+  DomainPredicateA pred_a;
+  DomainPredicateB pred_b;
+
+  bool operator()(const locality_domain & domain) const {
+    return pred_a(domain) && pred_b(domain);
+  }
+};
+
+/**
+ * View of the domains in a topology that satisfy a predicate.
+ *
+ * A domain is contained in the view if it and all its ancestors
+ * satisfy the predicate, like the domains remaining after
+ * \c topology::exclude_domain. Predicates are evaluated when the view
+ * is traversed, the topology is neither copied nor modified and must
+ * outlive the view.
+ *
+ * Example:
+ *
+ * \code
+ *   auto host_view = topo.filter(
+ *                      [&](const dyloc::locality_domain & d) {
+ *                        return d.host.empty() || d.host == my_host;
+ *                      });
+ *   auto numa_view = host_view.filter(
+ *                      [&](const dyloc::locality_domain & d) {
+ *                        return d.scope != DYLOC_LOCALITY_SCOPE_NUMA ||
+ *                               d.g_index == 0;
+ *                      });
+ *   int num_cores  = numa_view.num_cores(".");
+ * \endcode
+ *
+ * Domains of unexpanded symmetric instances are not contained in
+ * views, see \c topology::is_compressed.
+ */
+template <class DomainPredicate>
 class topology_view {
+  typedef topology_view<DomainPredicate> self_t;
+
+ public:
+  typedef topology::graph_t        graph_t;
+  typedef topology::graph_vertex_t graph_vertex_t;
+
+  /**
+   * Vertex predicate restricting the topology graph to the view.
+   * Holds a copy of the view so filtered graphs remain valid when the
+   * view they have been obtained from is destroyed.
+   */
+  struct vertex_filter {
+    std::shared_ptr<const self_t> view;
+
+    vertex_filter() = default;
+    explicit vertex_filter(const self_t & v)
+    : view(std::make_shared<const self_t>(v))
+    { }
+
+    bool operator()(const graph_vertex_t & vx) const {
+      return view->is_visible(vx);
+    }
+  };
+
+  typedef boost::filtered_graph<
+            const graph_t,
+            topology::contains_edge_filter,
+            vertex_filter >
+    hierarchy_t;
+
+ private:
+  const topology  * _topo;
+  DomainPredicate   _pred;
+
+ public:
+  topology_view() = delete;
+
+  topology_view(
+    const topology        & topo,
+    const DomainPredicate & pred)
+  : _topo(&topo)
+  , _pred(pred)
+  { }
 
+  inline const topology & topo() const noexcept {
+    return *_topo;
+  }
+
+  /**
+   * View of the domains in this view that also satisfy the specified
+   * predicate.
+   */
+  template <class SubDomainPredicate>
+  topology_view<domain_predicate_and<DomainPredicate, SubDomainPredicate> >
+  filter(const SubDomainPredicate & pred) const {
+    typedef domain_predicate_and<DomainPredicate, SubDomainPredicate>
+      view_predicate;
+    return topology_view<view_predicate>(*_topo, view_predicate { _pred, pred });
+  }
+
+  /**
+   * Whether the domain of the specified vertex is contained in the view.
+   */
+  bool is_visible(graph_vertex_t vx) const {
+    const auto & graph = _topo->graph();
+    for (;;) {
+      const auto * domain = satisfied_domain(vx);
+      if (domain == nullptr) {
+        return false;
+      }
+      bool has_parent = false;
+      for (auto domain_edges = in_edges(vx, graph);
+           domain_edges.first != domain_edges.second;
+           ++domain_edges.first) {
+        if (graph[*domain_edges.first].type ==
+              topology::edge_type::contains) {
+          vx         = source(*domain_edges.first, graph);
+          has_parent = true;
+          break;
+        }
+      }
+      if (!has_parent) {
+        return true;
+      }
+    }
+  }
+
+  bool contains(const std::string & domain_tag) const {
+    if (_topo->domains().count(domain_tag) == 0) {
+      return false;
+    }
+    return is_visible(_topo->domain_vertices().at(domain_tag));
+  }
+
+  /**
+   * Domain hierarchy restricted to the view as filtered graph, vertices
+   * and edges are filtered on access. The filtered graph references the
+   * topology but not the view.
+   */
+  hierarchy_t hierarchy() const {
+    return hierarchy_t(_topo->graph(),
+                       topology::contains_edge_filter(_topo->graph()),
+                       vertex_filter(*this));
+  }
+
+  /**
+   * Call the specified function for every domain in the view in
+   * pre-order of the domain hierarchy below the specified domain.
+   */
+  template <class UnaryFunction>
+  void for_each_domain(
+    const std::string & domain_tag,
+    UnaryFunction       func) const {
+    if (!contains(domain_tag)) {
+      return;
+    }
+    std::vector<graph_vertex_t> domain_vxs(
+                                  1, _topo->domain_vertices().at(domain_tag));
+    std::vector<graph_vertex_t> sub_vxs;
+    while (!domain_vxs.empty()) {
+      auto vx = domain_vxs.back();
+      domain_vxs.pop_back();
+      func(*satisfied_domain(vx));
+      sub_vxs.clear();
+      for_each_subdomain(vx, [&](graph_vertex_t sub_vx) {
+                               sub_vxs.push_back(sub_vx);
+                             });
+      domain_vxs.insert(domain_vxs.end(), sub_vxs.rbegin(), sub_vxs.rend());
+    }
+  }
+
+  template <class UnaryFunction>
+  void for_each_domain(UnaryFunction func) const {
+    for_each_domain(".", func);
+  }
+
+  /**
+   * Tags of all domains in the view at the specified scope.
+   */
+  std::vector<std::string> scope_domain_tags(
+    dyloc_locality_scope_t scope) const {
+    std::vector<std::string> scope_tags;
+    for (auto vx : _topo->scope_domains(scope)) {
+      if (is_visible(vx)) {
+        scope_tags.push_back(_topo->graph()[vx].domain_tag);
+      }
+    }
+    return scope_tags;
+  }
+
+  /**
+   * Number of cores in the specified domain, aggregated over the
+   * leaf domains in the view.
+   */
+  int num_cores(const std::string & domain_tag) const {
+    int num_cores = 0;
+    for_each_leaf(domain_tag, [&](const locality_domain & leaf) {
+                                num_cores += leaf.num_cores;
+                              });
+    return num_cores;
+  }
+
+  /**
+   * Units in the specified domain, aggregated over the leaf domains in
+   * the view.
+   */
+  std::vector<dart_global_unit_t> unit_ids(
+    const std::string & domain_tag) const {
+    std::vector<dart_global_unit_t> unit_ids;
+    for_each_leaf(domain_tag, [&](const locality_domain & leaf) {
+                                unit_ids.insert(unit_ids.end(),
+                                                leaf.unit_ids.begin(),
+                                                leaf.unit_ids.end());
+                              });
+    std::sort(unit_ids.begin(), unit_ids.end(),
+              [](dart_global_unit_t a, dart_global_unit_t b) {
+                return a.id < b.id;
+              });
+    unit_ids.erase(std::unique(unit_ids.begin(), unit_ids.end(),
+                               [](dart_global_unit_t a,
+                                  dart_global_unit_t b) {
+                                 return a.id == b.id;
+                               }),
+                   unit_ids.end());
+    return unit_ids;
+  }
+
+ private:
+  /**
+   * Domain of the specified vertex if it is not hidden and satisfies the
+   * view's predicate, independent of its ancestors.
+   */
+  const locality_domain * satisfied_domain(graph_vertex_t vx) const {
+    const auto & graph = _topo->graph();
+    if (graph[vx].state == topology::vertex_state::hidden) {
+      return nullptr;
+    }
+    auto domain_it = _topo->domains().find(graph[vx].domain_tag);
+    if (domain_it == _topo->domains().end() || !_pred(domain_it->second)) {
+      return nullptr;
+    }
+    return &domain_it->second;
+  }
+
+  template <class UnaryFunction>
+  void for_each_subdomain(
+    graph_vertex_t vx,
+    UnaryFunction  func) const {
+    const auto & graph = _topo->graph();
+    for (auto domain_edges = out_edges(vx, graph);
+         domain_edges.first != domain_edges.second;
+         ++domain_edges.first) {
+      auto sub_vx = target(*domain_edges.first, graph);
+      if (graph[*domain_edges.first].type == topology::edge_type::contains &&
+          satisfied_domain(sub_vx) != nullptr) {
+        func(sub_vx);
+      }
+    }
+  }
+
+  /**
+   * Calls the specified function for domains in the view below the
+   * specified domain that have no subdomains in the topology.
+   * Domains with all subdomains filtered from the view do not contribute
+   * to aggregates.
+   */
+  template <class UnaryFunction>
+  void for_each_leaf(
+    const std::string & domain_tag,
+    UnaryFunction       func) const {
+    const auto & graph    = _topo->graph();
+    const auto & vertices = _topo->domain_vertices();
+    for_each_domain(domain_tag, [&](const locality_domain & domain) {
+      bool is_leaf = true;
+      for (auto domain_edges = out_edges(vertices.at(domain.domain_tag),
+                                         graph);
+           is_leaf && domain_edges.first != domain_edges.second;
+           ++domain_edges.first) {
+        auto sub_vx = target(*domain_edges.first, graph);
+        is_leaf     = graph[*domain_edges.first].type !=
+                        topology::edge_type::contains ||
+                      graph[sub_vx].state == topology::vertex_state::hidden ||
+                      _topo->domains().count(graph[sub_vx].domain_tag) == 0;
+      }
+      if (is_leaf) { func(domain); }
+    });
+  }
 };
 
+template <class DomainPredicate>
+topology_view<DomainPredicate> topology::filter(
+  const DomainPredicate & pred) const {
+  return topology_view<DomainPredicate>(*this, pred);
+}
+
 } // namespace dyloc
 
 #endif // DYLOCXX__TOPOLOGY_VIEW_H__INCLUDED
@@ -51,6 +51,20 @@ struct unit_mapping {
     return unit_localities.size();
   }
 
+  /**
+   * Collectively exchanges updated hardware information of units in the
+   * team and patches the mapping in place.
+   *
+   * Units with changed locality specify their updated hardware
+   * information, other units specify \c nullptr. Only changed units
+   * contribute to the exchange, each with a fixed-size record of its
+   * unit id, CPU and NUMA affinity and locality scopes.
+   *
+   * Returns the ids of units with updated locality in ascending order.
+   */
+  std::vector<dart_team_unit_t> resync(
+    const dyloc_hwinfo_t * unit_hwinfo);
+
   inline const unit_locality & operator[](
       dart_team_unit_t luid) const {
     return unit_localities[luid.id];
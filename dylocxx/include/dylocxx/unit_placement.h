@@ -0,0 +1,42 @@
+#ifndef DYLOCXX__UNIT_PLACEMENT_H__INCLUDED
+#define DYLOCXX__UNIT_PLACEMENT_H__INCLUDED
+
+#include <vector>
+
+
+namespace dyloc {
+
+/**
+ * Placement of the calling unit's thread on CPUs, sampled without
+ * loading the hardware topology.
+ *
+ * Used to detect when the OS or resource manager has moved or rebound
+ * a unit after its hardware information has been collected.
+ */
+struct unit_placement {
+  /// OS indices of the CPUs in the thread's affinity mask, ascending.
+  std::vector<int> cpu_set;
+  /// OS indices of NUMA nodes of the CPUs the thread was found running
+  /// on, ascending and unique. Empty if NUMA support is not enabled.
+  std::vector<int> numa_nodes;
+
+  /**
+   * Samples the CPU affinity mask and the CPU the calling thread is
+   * running on the specified number of times.
+   * Empty on platforms other than Linux.
+   */
+  static unit_placement sample(int num_samples = 8);
+};
+
+/**
+ * Whether the unit has been moved between the specified placements,
+ * that is if its affinity mask changed or it no longer runs on any of
+ * the NUMA nodes it was found running on before.
+ */
+bool is_migrated(
+  const unit_placement & previous,
+  const unit_placement & current);
+
+} // namespace dyloc
+
+#endif // DYLOCXX__UNIT_PLACEMENT_H__INCLUDED
@@ -0,0 +1,112 @@
+#ifndef DYLOCXX__VERSIONED_TOPOLOGY_H__INCLUDED
+#define DYLOCXX__VERSIONED_TOPOLOGY_H__INCLUDED
+
+#include <dylocxx/topology.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+
+namespace dyloc {
+
+/**
+ * Topology with immutable versions published for concurrent readers.
+ *
+ * Readers on any thread obtain the current version as shared pointer to
+ * a constant topology which remains valid and unchanged while it is
+ * referenced. Mutations are applied to a working copy of the topology
+ * and published as new version by replacing the shared pointer
+ * atomically, readers are never blocked by writers and writers are
+ * serialized.
+ *
+ * Example:
+ *
+ * \code
+ *   // Worker threads:
+ *   auto topo = dyloc::team_topology_snapshot();
+ *   auto unit_tag = topo->unit_domain_tag(u);
+ *
+ *   // Control thread:
+ *   dyloc::update_team_topology(
+ *     [&](dyloc::topology & topo) {
+ *       topo.select_domain(numa_tag);
+ *     });
+ * \endcode
+ */
+class versioned_topology {
+  struct version {
+    uint64_t number;
+    topology topo;
+
+    version(uint64_t n, const topology & t) : number(n), topo(t) { }
+  };
+
+  /// Working copy modified by writers only.
+  topology                        _topology;
+  /// Last published version, accessed atomically.
+  std::shared_ptr<const version>  _published;
+  std::mutex                      _update_mutex;
+
+ public:
+  versioned_topology() = delete;
+
+  explicit versioned_topology(topology && topo);
+
+  versioned_topology(const versioned_topology &)             = delete;
+  versioned_topology & operator=(const versioned_topology &) = delete;
+
+  /**
+   * Current version of the topology, safe to call concurrently with
+   * updates.
+   */
+  std::shared_ptr<const topology> snapshot() const {
+    auto published = std::atomic_load(&_published);
+    return std::shared_ptr<const topology>(published, &published->topo);
+  }
+
+  /**
+   * Number of the current version, incremented for every published
+   * update.
+   */
+  uint64_t version_number() const {
+    return std::atomic_load(&_published)->number;
+  }
+
+  /**
+   * Applies the specified function to the working copy of the topology
+   * and publishes the result as new version.
+   * Returns the number of the published version.
+   */
+  template <class Mutation>
+  uint64_t update(Mutation && mutate) {
+    std::lock_guard<std::mutex> lock(_update_mutex);
+    mutate(_topology);
+    return publish_locked();
+  }
+
+  /**
+   * Publishes modifications of the working copy obtained from
+   * \c working_copy as new version.
+   */
+  uint64_t publish() {
+    std::lock_guard<std::mutex> lock(_update_mutex);
+    return publish_locked();
+  }
+
+  /**
+   * Working copy of the topology, not synchronized with concurrent
+   * updates. Modifications are visible to readers after \c publish.
+   */
+  inline topology & working_copy() noexcept {
+    return _topology;
+  }
+
+ private:
+  uint64_t publish_locked();
+};
+
+} // namespace dyloc
+
+#endif // DYLOCXX__VERSIONED_TOPOLOGY_H__INCLUDED
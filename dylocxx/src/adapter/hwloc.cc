@@ -0,0 +1,178 @@
+
+#ifdef DYLOC_ENABLE_HWLOC
+
+#include <dylocxx/adapter/hwloc.h>
+#include <dylocxx/adapter/dart.h>
+#include <dylocxx/topology.h>
+#include <dylocxx/exception.h>
+
+#include <dyloc/common/internal/hwloc.h>
+
+#include <dylocxx/internal/logging.h>
+
+#include <deque>
+#include <string>
+
+
+namespace dyloc {
+
+namespace {
+
+typedef topology::graph_t        graph_t;
+typedef topology::graph_vertex_t graph_vertex_t;
+
+/*
+ * Restrict set of the host's view: union of the CPU sets of the hwloc
+ * objects of visible domains without visible subdomains.
+ */
+void add_view_cpuset(
+  const topology & topo,
+  graph_vertex_t   vx,
+  hwloc_obj_t      parent_obj,
+  hwloc_bitmap_t   view_cpuset) {
+  const auto & graph  = topo.graph();
+  const auto * domain = topo.visible_domain(vx);
+  if (domain == nullptr) {
+    return;
+  }
+  hwloc_obj_t  obj    = parent_obj;
+  obj << *domain;
+  if (obj == nullptr) {
+    DYLOC_LOG_WARN("dylocxx::operator<<(hwloc_topology_t)",
+                   "no hwloc object for domain", graph[vx].domain_tag);
+    return;
+  }
+  int num_subdomains = 0;
+  for (auto domain_edges = out_edges(vx, graph);
+       domain_edges.first != domain_edges.second;
+       ++domain_edges.first) {
+    auto sub_vx = target(*domain_edges.first, graph);
+    if (graph[*domain_edges.first].type == topology::edge_type::contains &&
+        topo.is_visible(sub_vx)) {
+      add_view_cpuset(topo, sub_vx, obj, view_cpuset);
+      ++num_subdomains;
+    }
+  }
+  if (num_subdomains == 0 && obj->cpuset != nullptr) {
+    hwloc_bitmap_or(view_cpuset, view_cpuset, obj->cpuset);
+  }
+}
+
+} // namespace
+
+hwloc_topology_t & operator<<(
+  hwloc_topology_t      & hwloc_topo,
+  const dyloc::topology & topo) {
+  const auto & unit_map  = topo.unit_map();
+  const auto & my_hwinfo = unit_map[dyloc::myid(unit_map.team)]
+                             .data()->hwinfo;
+  const std::string my_host(my_hwinfo.host);
+  DYLOC_LOG_DEBUG("dylocxx::operator<<(hwloc_topology_t)",
+                  "host:", my_host);
+
+  // Visible NODE and MODULE domains of the local host are the roots of
+  // the host's view, the view is empty if the root domain is hidden:
+  const auto &   graph       = topo.graph();
+  hwloc_bitmap_t view_cpuset = hwloc_bitmap_alloc();
+  std::deque<graph_vertex_t> vertices;
+  auto root_vx_it = topo.domain_vertices().find(".");
+  if (root_vx_it != topo.domain_vertices().end() &&
+      topo.is_visible(root_vx_it->second)) {
+    vertices.push_back(root_vx_it->second);
+  }
+  while (!vertices.empty()) {
+    auto vx = vertices.front();
+    vertices.pop_front();
+    const auto & domain = *topo.visible_domain(vx);
+    if ((domain.scope == DYLOC_LOCALITY_SCOPE_NODE ||
+         domain.scope == DYLOC_LOCALITY_SCOPE_MODULE) &&
+        domain.host == my_host) {
+      add_view_cpuset(topo, vx, hwloc_get_root_obj(hwloc_topo),
+                      view_cpuset);
+      continue;
+    }
+    for (auto domain_edges = out_edges(vx, graph);
+         domain_edges.first != domain_edges.second;
+         ++domain_edges.first) {
+      auto sub_vx = target(*domain_edges.first, graph);
+      if (graph[*domain_edges.first].type == topology::edge_type::contains &&
+          topo.is_visible(sub_vx)) {
+        vertices.push_back(sub_vx);
+      }
+    }
+  }
+
+  if (hwloc_bitmap_iszero(view_cpuset)) {
+    DYLOC_LOG_WARN("dylocxx::operator<<(hwloc_topology_t)",
+                   "no domains at host", my_host, "in view");
+    hwloc_bitmap_free(view_cpuset);
+    return hwloc_topo;
+  }
+  int ret = hwloc_topology_restrict(hwloc_topo, view_cpuset, 0);
+  hwloc_bitmap_free(view_cpuset);
+  if (ret != 0) {
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "could not restrict hwloc topology of host " << my_host);
+  }
+  return hwloc_topo;
+}
+
+hwloc_obj_t & operator<<(
+  hwloc_obj_t                  & hwloc_obj,
+  const dyloc::locality_domain & domain) {
+  if (hwloc_obj == nullptr) {
+    return hwloc_obj;
+  }
+  if (domain.scope == DYLOC_LOCALITY_SCOPE_NODE ||
+      domain.scope == DYLOC_LOCALITY_SCOPE_MODULE) {
+    while (hwloc_obj->parent != nullptr) {
+      hwloc_obj = hwloc_obj->parent;
+    }
+    return hwloc_obj;
+  }
+  if (domain.scope != DYLOC_LOCALITY_SCOPE_NUMA    &&
+      domain.scope != DYLOC_LOCALITY_SCOPE_PACKAGE &&
+      domain.scope != DYLOC_LOCALITY_SCOPE_CACHE   &&
+      domain.scope != DYLOC_LOCALITY_SCOPE_CORE    &&
+      domain.scope != DYLOC_LOCALITY_SCOPE_CPU) {
+    return hwloc_obj;
+  }
+#if HWLOC_API_VERSION >= 0x00020000
+  // Since hwloc 2, NUMA nodes are memory children without children,
+  // objects of NUMA subdomains are children of the NUMA node's parent:
+  if (hwloc_obj->type == HWLOC_OBJ_NUMANODE &&
+      domain.scope != DYLOC_LOCALITY_SCOPE_NUMA &&
+      hwloc_obj->parent != nullptr) {
+    hwloc_obj = hwloc_obj->parent;
+  }
+#endif
+  // Breadth-first search yields the shallowest matching object:
+  std::deque<hwloc_obj_t> objs(1, hwloc_obj);
+  hwloc_obj = nullptr;
+  while (!objs.empty()) {
+    auto obj = objs.front();
+    objs.pop_front();
+    if (dyloc__hwloc_obj_type_to_scope(obj->type) == domain.scope &&
+        static_cast<int>(obj->logical_index) == domain.g_index) {
+      hwloc_obj = obj;
+      break;
+    }
+    for (unsigned c = 0; c < obj->arity; ++c) {
+      objs.push_back(obj->children[c]);
+    }
+#if HWLOC_API_VERSION >= 0x00020000
+    // NUMA nodes are memory children since hwloc 2:
+    for (auto mem_obj = obj->memory_first_child;
+         mem_obj != nullptr;
+         mem_obj = mem_obj->next_sibling) {
+      objs.push_back(mem_obj);
+    }
+#endif
+  }
+  return hwloc_obj;
+}
+
+} // namespace dyloc
+
+#endif // DYLOC_ENABLE_HWLOC
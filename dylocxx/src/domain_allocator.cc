@@ -0,0 +1,235 @@
+
+#include <dylocxx/domain_allocator.h>
+#include <dylocxx/topology.h>
+#include <dylocxx/exception.h>
+
+#include <dylocxx/adapter/dart.h>
+
+#include <dylocxx/internal/logging.h>
+
+#ifdef DYLOC_ENABLE_NUMA
+#  include <numa.h>
+#endif
+
+#ifdef DYLOC_ENABLE_HWLOC
+#  include <hwloc.h>
+#  include <hwloc/helper.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+namespace dyloc {
+
+namespace {
+
+#ifdef DYLOC_ENABLE_HWLOC
+/*
+ * hwloc topology of the local host, loaded once as it is required for
+ * every translation of logical NUMA indices and for hwloc allocations.
+ */
+class host_hwloc_topology {
+  hwloc_topology_t _topology;
+
+ public:
+  host_hwloc_topology() {
+    hwloc_topology_init(&_topology);
+    hwloc_topology_load(_topology);
+  }
+
+  ~host_hwloc_topology() {
+    hwloc_topology_destroy(_topology);
+  }
+
+  host_hwloc_topology(const host_hwloc_topology &)             = delete;
+  host_hwloc_topology & operator=(const host_hwloc_topology &) = delete;
+
+  static hwloc_topology_t get() {
+    static host_hwloc_topology host_topology;
+    return host_topology._topology;
+  }
+};
+#endif
+
+/*
+ * Unit localities contain logical NUMA indices, i.e. the position of the
+ * node in ascending order of the OS indices of configured nodes, both if
+ * hwinfo is collected using hwloc and using libnuma.
+ */
+int numa_os_index(int numa_id) {
+#if defined(DYLOC_ENABLE_HWLOC)
+  hwloc_obj_t numa_obj = hwloc_get_obj_by_type(
+                           host_hwloc_topology::get(),
+#  if HWLOC_API_VERSION < 0x00011100
+                           HWLOC_OBJ_NODE,
+#  else
+                           HWLOC_OBJ_NUMANODE,
+#  endif
+                           numa_id);
+  return (numa_obj == nullptr) ? -1 : static_cast<int>(numa_obj->os_index);
+#elif defined(DYLOC_ENABLE_NUMA)
+  if (numa_available() < 0) {
+    return numa_id;
+  }
+  int numa_idx = 0;
+  for (int n = 0; n <= numa_max_node(); n++) {
+    if (numa_bitmask_isbitset(numa_all_nodes_ptr, n) &&
+        numa_idx++ == numa_id) {
+      return n;
+    }
+  }
+  return -1;
+#else
+  return numa_id;
+#endif
+}
+
+const dyloc_hwinfo_t & unit_hwinfo(
+  const topology     & topo,
+  dart_team_t          team,
+  dart_global_unit_t   unit_gid) {
+  dart_team_unit_t unit_lid;
+  unit_lid.id = unit_gid.id;
+  if (team != DART_TEAM_ALL) {
+    unit_lid = dyloc::g2l(team, unit_gid);
+  }
+  return topo.unit_map()[unit_lid].data()->hwinfo;
+}
+
+std::string local_host(const topology & topo) {
+  dart_team_t team = topo.domains().at(".").team;
+  return unit_hwinfo(topo, team, dyloc::myid()).host;
+}
+
+} // namespace
+
+std::vector<int> domain_numa_nodes(
+  const topology        & topo,
+  const locality_domain & domain) {
+  const std::string host = local_host(topo);
+  std::vector<int>  numa_nodes;
+  bool              has_local_units = false;
+  for (auto unit_gid : domain.unit_ids) {
+    const auto & hwinfo = unit_hwinfo(topo, domain.team, unit_gid);
+    if (host != hwinfo.host) {
+      continue;
+    }
+    has_local_units = true;
+    int numa_node   = (hwinfo.numa_id >= 0)
+                      ? numa_os_index(hwinfo.numa_id)
+                      : -1;
+    if (numa_node >= 0 &&
+        std::find(numa_nodes.begin(), numa_nodes.end(), numa_node)
+          == numa_nodes.end()) {
+      numa_nodes.push_back(numa_node);
+    }
+  }
+  if (!has_local_units) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "domain " << domain.domain_tag << " has no units at host " << host);
+  }
+  std::sort(numa_nodes.begin(), numa_nodes.end());
+  DYLOC_LOG_DEBUG("dylocxx::domain_numa_nodes",
+                  "domain:", domain.domain_tag,
+                  "NUMA nodes:", numa_nodes.size());
+  return numa_nodes;
+}
+
+std::vector<std::string> local_numa_domain_tags(
+  const topology & topo) {
+  const std::string host = local_host(topo);
+  std::vector<std::string> numa_tags;
+  for (const auto & numa_tag :
+         topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NUMA)) {
+    if (topo.domain(numa_tag).host == host) {
+      numa_tags.push_back(numa_tag);
+    }
+  }
+  std::sort(numa_tags.begin(), numa_tags.end());
+  return numa_tags;
+}
+
+void * allocate_numa(
+  size_t                   nbytes,
+  const std::vector<int> & numa_nodes,
+  numa_policy              policy) {
+  if (nbytes == 0) {
+    return nullptr;
+  }
+#if defined(DYLOC_ENABLE_NUMA)
+  if (numa_available() < 0 || numa_nodes.empty() ||
+      policy == numa_policy::first_touch) {
+    return numa_alloc(nbytes);
+  }
+  if (policy == numa_policy::bind && numa_nodes.size() == 1) {
+    return numa_alloc_onnode(nbytes, numa_nodes.front());
+  }
+  struct bitmask * nodemask = numa_allocate_nodemask();
+  for (int numa_node : numa_nodes) {
+    numa_bitmask_setbit(nodemask, numa_node);
+  }
+  void * p = nullptr;
+  if (policy == numa_policy::interleave) {
+    p = numa_alloc_interleaved_subset(nbytes, nodemask);
+  } else {
+    p = numa_alloc(nbytes);
+    if (p != nullptr) {
+      numa_tonodemask_memory(p, nbytes, nodemask);
+    }
+  }
+  numa_free_nodemask(nodemask);
+  return p;
+#elif defined(DYLOC_ENABLE_HWLOC)
+  hwloc_membind_policy_t membind_policy = HWLOC_MEMBIND_BIND;
+  if (policy == numa_policy::interleave) {
+    membind_policy = HWLOC_MEMBIND_INTERLEAVE;
+  } else if (policy == numa_policy::first_touch || numa_nodes.empty()) {
+    membind_policy = HWLOC_MEMBIND_FIRSTTOUCH;
+  }
+  hwloc_nodeset_t nodeset = hwloc_bitmap_alloc();
+  for (int numa_node : numa_nodes) {
+    hwloc_bitmap_set(nodeset, numa_node);
+  }
+  if (numa_nodes.empty()) {
+    hwloc_bitmap_fill(nodeset);
+  }
+#  if HWLOC_API_VERSION >= 0x00020000
+  void * p = hwloc_alloc_membind(host_hwloc_topology::get(), nbytes,
+                                 nodeset, membind_policy,
+                                 HWLOC_MEMBIND_BYNODESET);
+#  else
+  void * p = hwloc_alloc_membind_nodeset(host_hwloc_topology::get(), nbytes,
+                                         nodeset, membind_policy, 0);
+#  endif
+  hwloc_bitmap_free(nodeset);
+  return p;
+#else
+  dyloc__unused(numa_nodes);
+  dyloc__unused(policy);
+  return std::malloc(nbytes);
+#endif
+}
+
+void deallocate_numa(
+  void   * p,
+  size_t   nbytes) {
+  if (p == nullptr) {
+    return;
+  }
+#if defined(DYLOC_ENABLE_NUMA)
+  numa_free(p, nbytes);
+#elif defined(DYLOC_ENABLE_HWLOC)
+  hwloc_free(host_hwloc_topology::get(), p, nbytes);
+#else
+  dyloc__unused(nbytes);
+  std::free(p);
+#endif
+}
+
+} // namespace dyloc
+
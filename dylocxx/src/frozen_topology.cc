@@ -0,0 +1,144 @@
+
+#include <dylocxx/frozen_topology.h>
+#include <dylocxx/topology.h>
+
+#include <dylocxx/internal/logging.h>
+#include <dylocxx/internal/assert.h>
+
+#include <algorithm>
+#include <vector>
+#include <string>
+
+
+namespace dyloc {
+
+frozen_topology::frozen_topology(const topology & topo) {
+  if (topo.is_compressed()) {
+    topology expanded_topo(topo);
+    expanded_topo.expand();
+    *this = frozen_topology(expanded_topo);
+    return;
+  }
+  typedef topology::graph_vertex_t graph_vertex_t;
+
+  const auto & graph   = topo.graph();
+  const auto & domains = topo.domains();
+
+  auto is_visible = [&](graph_vertex_t vx) {
+                      return graph[vx].state !=
+                               topology::vertex_state::hidden &&
+                             domains.count(graph[vx].domain_tag) > 0;
+                    };
+
+  const auto root_vx_it = topo.domain_vertices().find(".");
+  if (root_vx_it == topo.domain_vertices().end() ||
+      !is_visible(root_vx_it->second)) {
+    _child_offsets.push_back(0);
+    _unit_offsets.push_back(0);
+    return;
+  }
+  _vertices.reserve(domains.size());
+  _parents.reserve(domains.size());
+
+  // Pre-order of visible domains, subdomains in order of edges:
+  std::vector<std::pair<graph_vertex_t, int> > open_vxs;
+  std::vector<graph_vertex_t>                  sub_vxs;
+  open_vxs.push_back(std::make_pair(root_vx_it->second, -1));
+  while (!open_vxs.empty()) {
+    auto vx     = open_vxs.back().first;
+    int  parent = open_vxs.back().second;
+    int  d      = size();
+    open_vxs.pop_back();
+    _vertices.push_back(vx);
+    _parents.push_back(parent);
+
+    sub_vxs.clear();
+    for (auto domain_edges = out_edges(vx, graph);
+         domain_edges.first != domain_edges.second;
+         ++domain_edges.first) {
+      auto sub_vx = target(*domain_edges.first, graph);
+      if (graph[*domain_edges.first].type == topology::edge_type::contains &&
+          is_visible(sub_vx)) {
+        sub_vxs.push_back(sub_vx);
+      }
+    }
+    for (auto sub_it = sub_vxs.rbegin(); sub_it != sub_vxs.rend(); ++sub_it) {
+      open_vxs.push_back(std::make_pair(*sub_it, d));
+    }
+  }
+
+  const int num_domains = size();
+  _subtree_ends.resize(num_domains);
+  _child_offsets.assign(num_domains + 1, 0);
+  for (int d = num_domains - 1; d >= 0; --d) {
+    if (_subtree_ends[d] == 0) {
+      _subtree_ends[d] = d + 1;
+    }
+    int parent = _parents[d];
+    if (parent >= 0) {
+      _subtree_ends[parent] = std::max(_subtree_ends[parent],
+                                       _subtree_ends[d]);
+      ++_child_offsets[parent + 1];
+    }
+  }
+  for (int d = 0; d < num_domains; ++d) {
+    _child_offsets[d + 1] += _child_offsets[d];
+  }
+  // Children are discovered in ascending pre-order:
+  _children.resize(_child_offsets[num_domains]);
+  std::vector<int> child_pos(_child_offsets.begin(), _child_offsets.end() - 1);
+  for (int d = 1; d < num_domains; ++d) {
+    _children[child_pos[_parents[d]]++] = d;
+  }
+
+  _domain_tags.reserve(num_domains);
+  _hosts.reserve(num_domains);
+  _host_ids.reserve(num_domains);
+  _scopes.reserve(num_domains);
+  _levels.reserve(num_domains);
+  _g_indices.reserve(num_domains);
+  _r_indices.reserve(num_domains);
+  _num_cores.reserve(num_domains);
+  _unit_offsets.reserve(num_domains + 1);
+  _unit_offsets.push_back(0);
+  _tag_indices.reserve(num_domains);
+  for (int d = 0; d < num_domains; ++d) {
+    const auto & domain = domains.at(graph[_vertices[d]].domain_tag);
+    _domain_tags.push_back(domain.domain_tag);
+    _hosts.push_back(domain.host);
+    _host_ids.push_back(domain.host_id);
+    _scopes.push_back(domain.scope);
+    _levels.push_back(domain.level);
+    _g_indices.push_back(domain.g_index);
+    _r_indices.push_back(domain.r_index);
+    _num_cores.push_back(domain.num_cores);
+    _unit_ids.insert(_unit_ids.end(),
+                     domain.unit_ids.begin(), domain.unit_ids.end());
+    _unit_offsets.push_back(static_cast<int>(_unit_ids.size()));
+    _tag_indices[domain.domain_tag] = d;
+
+    if (domain.scope == DYLOC_LOCALITY_SCOPE_UNIT) {
+      for (auto unit_id : domain.unit_ids) {
+        if (unit_id.id >= static_cast<int>(_unit_indices.size())) {
+          _unit_indices.resize(unit_id.id + 1, -1);
+        }
+        _unit_indices[unit_id.id] = d;
+      }
+    }
+  }
+  DYLOC_LOG_DEBUG("dylocxx::frozen_topology.frozen_topology",
+                  "domains:", num_domains,
+                  "units:",   _unit_indices.size());
+}
+
+int frozen_topology::index(const std::string & domain_tag) const {
+  auto tag_it = _tag_indices.find(domain_tag);
+  return (tag_it == _tag_indices.end()) ? -1 : tag_it->second;
+}
+
+frozen_topology topology::freeze() const {
+  return frozen_topology(*this);
+}
+
+} // namespace dyloc
+
@@ -2,6 +2,8 @@
 #include <dylocxx/unit_mapping.h>
 #include <dylocxx/host_topology.h>
 
+#include <dylocxx/exception.h>
+
 #include <dylocxx/internal/logging.h>
 #include <dylocxx/internal/assert.h>
 
@@ -13,6 +15,10 @@
 #include <set>
 #include <algorithm>
 #include <functional>
+#include <numeric>
+#include <regex>
+#include <cstdlib>
+#include <cstring>
 
 #ifdef DART_ENABLE_HWLOC
 #  include <hwloc.h>
@@ -22,20 +28,130 @@
 
 namespace dyloc {
 
+namespace {
+
+/*
+ * Pattern of hostname suffixes that identify a host as module of the
+ * node with the remaining hostname prefix, e.g. "-mic0" or "_sys".
+ * Can be overridden in environment variable DYLOC_MODULE_SUFFIX_PATTERN.
+ */
+const char * default_module_suffix_pattern = "[-_][A-Za-z]+[0-9]*";
+
+std::regex module_suffix_pattern() {
+  const char * pattern = std::getenv("DYLOC_MODULE_SUFFIX_PATTERN");
+  if (pattern == nullptr || *pattern == '\0') {
+    pattern = default_module_suffix_pattern;
+  }
+  try {
+    return std::regex(pattern);
+  } catch (const std::regex_error & e) {
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "invalid module suffix pattern '" << pattern << "': " << e.what());
+  }
+}
+
+} // namespace
+
+std::vector<int> classify_hosts(
+  const std::vector<std::string> & host_names,
+  const std::vector<int>         & known_node_ids) {
+  /* Classify hostnames into categories 'node' and 'module'.
+   * Typically, modules have the hostname of their nodes as prefix in their
+   * hostname, e.g.:
+   *
+   *   compute-node-124            <-- node, heterogenous
+   *   |- compute-node-124-sys     <-- module, homogenous
+   *   |- compute-node-124-mic0    <-- module, homogenous
+   *   '- compute-node-124-mic1    <-- module, homogenous
+   *
+   * A host is classified as module of a node if the node's hostname is a
+   * prefix of the module's hostname and the remaining suffix matches the
+   * module suffix pattern, such that for example host 'node1' is not
+   * classified as module of host 'node10'.
+   *
+   * In lexicographic order, hostnames with a common prefix are adjacent
+   * and follow the prefix hostname. Node candidates are kept in a stack
+   * of prefixes of the current hostname.
+   */
+  const std::regex module_suffix_regex = module_suffix_pattern();
+
+  int num_hosts = host_names.size();
+  std::vector<int> sorted_host_ids(num_hosts);
+  std::iota(sorted_host_ids.begin(), sorted_host_ids.end(), 0);
+  std::sort(sorted_host_ids.begin(),
+            sorted_host_ids.end(),
+            [&](int a, int b) {
+              return host_names[a] < host_names[b];
+            });
+
+  std::vector<int> node_ids(num_hosts, -1);
+  std::vector<int> node_prefix_ids;
+  for (int host_id : sorted_host_ids) {
+    const auto & host_name = host_names[host_id];
+    while (!node_prefix_ids.empty() &&
+           host_name.compare(0, host_names[node_prefix_ids.back()].size(),
+                             host_names[node_prefix_ids.back()]) != 0) {
+      node_prefix_ids.pop_back();
+    }
+    int node_id = (host_id < static_cast<int>(known_node_ids.size()))
+                  ? known_node_ids[host_id]
+                  : -1;
+    for (auto node_it = node_prefix_ids.rbegin();
+         node_id < 0 && node_it != node_prefix_ids.rend();
+         ++node_it) {
+      if (std::regex_match(
+            host_name.begin() + host_names[*node_it].size(),
+            host_name.end(),
+            module_suffix_regex)) {
+        node_id = *node_it;
+      }
+    }
+    node_ids[host_id] = node_id;
+    if (node_id < 0) {
+      node_prefix_ids.push_back(host_id);
+    }
+  }
+  return node_ids;
+}
+
 host_topology::host_topology(const unit_mapping & unit_map) {
   DYLOC_LOG_DEBUG("dylocxx::host_topology.()", "()");
 
-  dart_team_t team = unit_map.team;
-  DYLOC_LOG_TRACE("dylocxx::host_topology.()", "team:", team);
-
   size_t num_units;
-  DYLOC_ASSERT_RETURNS(dart_team_size(team, &num_units), DART_OK);
+  DYLOC_ASSERT_RETURNS(dart_team_size(unit_map.team, &num_units), DART_OK);
   DYLOC_ASSERT_MSG(num_units == unit_map.size(),
                    "Number of units in mapping differs from team size");
 
-  // Map unit ids to their host name:
+  map_units(unit_map);
+  collect_topology(unit_map);
+  load_network_topology();
+
+  DYLOC_LOG_DEBUG("dylocxx::host_topology.()", ">");
+}
+
+host_topology::host_topology(
+  const unit_mapping                         & unit_map,
+  const std::vector<dyloc_module_location_t> & module_locations) {
+  DYLOC_LOG_DEBUG("dylocxx::host_topology.()", "()",
+                  "module locations:", module_locations.size());
+
+  map_units(unit_map);
+  locate_modules(module_locations);
+  classify_host_levels();
+  load_network_topology();
+
+  DYLOC_LOG_DEBUG("dylocxx::host_topology.()", ">");
+}
+
+void host_topology::map_units(const unit_mapping & unit_map) {
+  dart_team_t team      = unit_map.team;
+  size_t      num_units = unit_map.size();
+  DYLOC_LOG_TRACE("dylocxx::host_topology.map_units", "team:", team);
+
+  // Intern host names and map unit ids to their host:
   //
-  DYLOC_LOG_TRACE("dylocxx::host_topology.()",
+  DYLOC_LOG_TRACE("dylocxx::host_topology.map_units",
                   "copying host names from", num_units, "units");
   for (size_t luid = 0; luid < num_units; ++luid) {
     dart_global_unit_t guid;
@@ -43,32 +159,39 @@ host_topology::host_topology(const unit_mapping & unit_map) {
       dart_team_unit_l2g(team, luid, &guid),
       DART_OK);
     // Add global unit id to list of units of its host:
-    std::string unit_hostname(unit_map[guid.id].data()->hwinfo.host);
-    DYLOC_LOG_TRACE("dylocxx::host_topology.()",
+    dart_team_unit_t unit_lid(luid);
+    std::string unit_hostname(unit_map[unit_lid].data()->hwinfo.host);
+    auto host_id_ins = _host_ids.insert(
+                         std::make_pair(unit_hostname, _host_names.size()));
+    if (host_id_ins.second) {
+      _host_names.push_back(unit_hostname);
+      _host_units.push_back(std::vector<dart_global_unit_t>());
+    }
+    int unit_host_id = host_id_ins.first->second;
+    DYLOC_LOG_TRACE("dylocxx::host_topology.map_units",
                     "team unit id:",   luid,
                     "global unit id:", guid.id,
-                    "host:",           unit_hostname);
+                    "host:",           unit_hostname,
+                    "host id:",        unit_host_id);
 
-    _host_units.insert(
-        std::make_pair(unit_hostname,
-                       std::vector<dart_global_unit_t>()));
-    _host_units[unit_hostname].push_back(guid);
+    _host_units[unit_host_id].push_back(guid);
   }
 
+  int num_hosts = _host_names.size();
+  _host_domains.resize(num_hosts);
+  _module_hwinfo.resize(num_hosts);
+  _numa_distances.resize(num_hosts);
+
   // Iterate hosts:
   //
-  for (const auto & host_units_mapping : _host_units) {
-    const auto  & host_name       = host_units_mapping.first;
-    const auto  & host_unit_gids  = host_units_mapping.second;
-    dyloc_host_domain_t host_dom;
-
-    if (host_unit_gids.empty()) {
-      DYLOC_LOG_WARN("dylocxx::host_topology.()",
-                     "no units mapped to", host_name);
-      continue;
-    }
+  for (int host_id = 0; host_id < num_hosts; ++host_id) {
+    const auto  & host_name       = _host_names[host_id];
+    const auto  & host_unit_gids  = _host_units[host_id];
+    auto        & host_dom        = _host_domains[host_id];
 
     // host domain data:
+    host_dom.parent[0]       = '\0';
+    host_dom.num_cores       = -1;
     host_dom.level           = 0;
     host_dom.scope_pos.scope = DYLOC_LOCALITY_SCOPE_NODE;
     host_dom.scope_pos.index = 0;
@@ -77,7 +200,7 @@ host_topology::host_topology(const unit_mapping & unit_map) {
     host_name.copy(host_dom.host, host_name.size());
     host_dom.host[host_name.size()] = '\0';
 
-    DYLOC_LOG_TRACE("dylocxx::host_topology.()",
+    DYLOC_LOG_TRACE("dylocxx::host_topology.map_units",
                     "mapping units to", host_name);
 
     // NUMA ids occupied by units on the host:
@@ -91,7 +214,7 @@ host_topology::host_topology(const unit_mapping & unit_map) {
       int unit_numa_id   = ul.data()->hwinfo.numa_id;
       int unit_num_numa  = ul.data()->hwinfo.num_numa;
 
-      DYLOC_LOG_TRACE_VAR("dylocxx::host_topology.()", ul.data()->hwinfo);
+      DYLOC_LOG_TRACE_VAR("dylocxx::host_topology.map_units", ul.data()->hwinfo);
 
       if (unit_num_numa <= 0) {
         unit_numa_id = 0;
@@ -101,11 +224,24 @@ host_topology::host_topology(const unit_mapping & unit_map) {
       if (host_dom.num_cores <= 0) {
         host_dom.num_cores        = ul.data()->hwinfo.num_cores;
       }
-      if (_module_hwinfo.count(host_name) == 0) {
-        _module_hwinfo[host_name] = ul.data()->hwinfo;
+      if (host_unit_gid.id == host_unit_gids[0].id) {
+        _module_hwinfo[host_id] = ul.data()->hwinfo;
+      }
+      // NUMA distances from the unit's NUMA domain:
+      if (unit_numa_id >= 0 && unit_numa_id < DYLOC_LOCALITY_MAX_NUMA_ID) {
+        auto & host_numa_dist = _numa_distances[host_id];
+        if (host_numa_dist.empty()) {
+          host_numa_dist.resize(
+            DYLOC_LOCALITY_MAX_NUMA_ID * DYLOC_LOCALITY_MAX_NUMA_ID, -1);
+        }
+        std::copy(ul.data()->hwinfo.numa_distances,
+                  ul.data()->hwinfo.numa_distances +
+                    DYLOC_LOCALITY_MAX_NUMA_ID,
+                  host_numa_dist.begin() +
+                    unit_numa_id * DYLOC_LOCALITY_MAX_NUMA_ID);
       }
 
-      DYLOC_LOG_TRACE("dylocxx::host_topology.()",
+      DYLOC_LOG_TRACE("dylocxx::host_topology.map_units",
                       "mapping unit", luid.id,
                       "to host",      host_name,
                       "num. cores:",  host_dom.num_cores,
@@ -118,15 +254,30 @@ host_topology::host_topology(const unit_mapping & unit_map) {
     std::copy(host_numa_ids.begin(),
               host_numa_ids.end(),
               host_dom.numa_ids);
-
-    _host_domains.push_back(std::move(host_dom));
   }
 
   _num_host_levels = 0;
+}
 
-  collect_topology(unit_map);
+void host_topology::load_network_topology() {
+  const char * network_topology_file = std::getenv("DYLOC_NETWORK_TOPOLOGY");
+  if (network_topology_file != nullptr && *network_topology_file != '\0') {
+    _network_topology = network_topology(network_topology_file);
+  }
+}
 
-  DYLOC_LOG_DEBUG("dylocxx::host_topology.()", ">");
+int host_topology::numa_distance(
+  int host_id,
+  int numa_id_a,
+  int numa_id_b) const {
+  if (host_id < 0 || host_id >= num_hosts() ||
+      _numa_distances[host_id].empty() ||
+      numa_id_a < 0 || numa_id_a >= DYLOC_LOCALITY_MAX_NUMA_ID ||
+      numa_id_b < 0 || numa_id_b >= DYLOC_LOCALITY_MAX_NUMA_ID) {
+    return -1;
+  }
+  return _numa_distances[host_id][
+           numa_id_a * DYLOC_LOCALITY_MAX_NUMA_ID + numa_id_b];
 }
 
 void host_topology::collect_topology(
@@ -170,28 +321,21 @@ void host_topology::collect_topology(
    * leader unit at units 3,4,5: 3
    */
 
-  const auto & my_uloc        = unit_map[my_id];
-  const auto & local_hostname = my_uloc.data()->hwinfo.host;
+  const auto & my_uloc       = unit_map[my_id];
+  int          local_host_id = host_id(my_uloc.data()->hwinfo.host);
 
   DYLOC_LOG_TRACE("dylocxx::host_topology.collect_topology",
-                  "local host:", local_hostname);
-
-  for (const auto & host_dom : _host_domains) {
-    std::string  host_name(host_dom.host);
-    const auto & host_unit_gids = _host_units[host_name];
+                  "local host:", my_uloc.data()->hwinfo.host);
 
-    if (host_unit_gids.size() == 0) {
-      DYLOC_LOG_WARN("dylocxx::host_topology.collect_topology",
-                     "no units at host", host_name);
-      continue;
-    }
+  for (int host_id = 0; host_id < num_hosts; ++host_id) {
+    const auto & host_unit_gids = _host_units[host_id];
 
     const dart_global_unit_t & leader_unit_gid = host_unit_gids[0];
     DYLOC_ASSERT_RETURNS(
       dart_group_addmember(leader_group, leader_unit_gid),
       DART_OK);
 
-    if (host_name == local_hostname) {
+    if (host_id == local_host_id) {
       /* set local leader: */
       DYLOC_ASSERT_RETURNS(
         dart_team_unit_g2l(team, leader_unit_gid,
@@ -289,28 +433,19 @@ void host_topology::collect_topology(
       module_locations = local_modules;
     }
 
+    // Module locations received from leader units, ordered by leader:
+    std::vector<dyloc_module_location_t> received_locations;
     for (size_t lu = 0; lu < num_leaders; lu++) {
       /* Number of modules received from leader unit lu: */
       size_t lu_num_modules = recvcounts[lu] /
                               sizeof(dyloc_module_location_t);
-      for (size_t m = 0; m < lu_num_modules; m++) {
-        int m_displ = displs[lu] / sizeof(dyloc_module_location_t);
-        const dyloc_module_location_t & module_loc =
-                module_locations[m_displ + m];
-        for (auto & host_dom : _host_domains) {
-          if (host_dom.host == module_loc.module) {
-            /* Classify host as module: */
-            std::strcpy(host_dom.parent, module_loc.host);
-            host_dom.scope_pos = module_loc.pos;
-            host_dom.level     = 1;
-            if (_num_host_levels < host_dom.level) {
-              _num_host_levels = host_dom.level;
-            }
-            break;
-          }
-        }
-      }
+      int    m_displ        = displs[lu] / sizeof(dyloc_module_location_t);
+      received_locations.insert(
+        received_locations.end(),
+        module_locations.begin() + m_displ,
+        module_locations.begin() + m_displ + lu_num_modules);
     }
+    locate_modules(received_locations);
     // Wait for exchange of module locations between all leaders and
     // finalize leader team:
     if (num_leaders > 1) {
@@ -363,79 +498,74 @@ void host_topology::collect_topology(
     dart_group_destroy(&local_group),
     DART_OK);
 
-  /* Classify hostnames into categories 'node' and 'module'.
-   * Typically, modules have the hostname of their nodes as prefix in their
-   * hostname, e.g.:
-   *
-   *   computer-node-124           <-- node, heterogenous
-   *   |- compute_node-124-sys     <-- module, homogenous
-   *   |- compute-node-124-mic0    <-- module, homogenous
-   *   '- compute-node-124-mic1    <-- module, homogenous
-   *
-   * Find shortest strings in array of distinct host names:
-   */
-  int hostname_min_len = std::numeric_limits<int>::max();
-  int hostname_max_len = 0;
-  for (auto & host_dom : _host_domains) {
-    host_dom.level     = 0;
-    host_dom.parent[0] = '\0';
-    int hostname_len = strlen(host_dom.host);
-    if (hostname_len < hostname_min_len) {
-      hostname_min_len = hostname_len;
-    }
-    if (hostname_len > hostname_max_len) {
-      hostname_max_len = hostname_len;
+  classify_host_levels();
+}
+
+void host_topology::locate_modules(
+  const std::vector<dyloc_module_location_t> & module_locations) {
+  for (const auto & module_loc : module_locations) {
+    for (auto & host_dom : _host_domains) {
+      if (std::strcmp(host_dom.host, module_loc.module) == 0) {
+        /* Classify host as module: */
+        std::strcpy(host_dom.parent, module_loc.host);
+        host_dom.scope_pos = module_loc.pos;
+        host_dom.level     = 1;
+        if (_num_host_levels < host_dom.level) {
+          _num_host_levels = host_dom.level;
+        }
+        break;
+      }
     }
   }
+}
 
-  _num_host_levels = 0;
-
-  // TODO: Intermediate, only works if node host names have identical
-  //       length:
-  if (hostname_min_len != hostname_max_len) {
-    // Match short hostnames as prefix of every other hostname:
-    for (auto & host_dom_top : _host_domains) {
-      _node_module_domains[host_dom_top.host] = module_domain_list_t();
-      if (strlen(host_dom_top.host) == (size_t)hostname_min_len) {
-        // Host name is node:
-        _node_domains.insert(
-            std::make_pair(
-              std::string(host_dom_top.host),
-              std::ref(host_dom_top)));
-        // Find node modules in all other hostnames:
-        char * short_name = host_dom_top.host;
-        for (auto & host_dom_sub : _host_domains) {
-          char * other_name = host_dom_sub.host;
-          /* Other hostname is longer and has short host name in prefix: */
-          if (strlen(other_name) > (size_t)hostname_min_len &&
-              strncmp(short_name, other_name, hostname_min_len) == 0) {
-            // Found module of node host:
-            _module_domains.insert(
-                std::make_pair(
-                  std::string(host_dom_sub.host),
-                  std::ref(host_dom_sub)));
-            _node_module_domains[host_dom_top.host].push_back(
-                std::ref(host_dom_sub));
-            /* Increment topology level of other host: */
-            int node_level = host_dom_top.level + 1;
-            if (node_level > _num_host_levels) {
-              _num_host_levels = node_level;
-            }
-            host_dom_sub.level = node_level;
-            /* Set short hostname as parent: */
-            strncpy(host_dom_sub.parent, short_name,
-                    DART_LOCALITY_HOST_MAX_SIZE);
-          }
-        }
+void host_topology::classify_host_levels() {
+  int num_hosts = _host_names.size();
+
+  // Classify hosts as nodes and modules, parents of modules resolved
+  // from module locations like Xeon Phi devices take precedence:
+  std::vector<int> known_node_host_ids(num_hosts, -1);
+  for (int host_id = 0; host_id < num_hosts; ++host_id) {
+    const auto & host_dom = _host_domains[host_id];
+    if (host_dom.parent[0] != '\0') {
+      int node_host_id = this->host_id(host_dom.parent);
+      if (node_host_id != host_id) {
+        known_node_host_ids[host_id] = node_host_id;
       }
     }
-  } else {
-    for (auto & host_dom_top : _host_domains) {
-      _node_module_domains[host_dom_top.host] = module_domain_list_t();
-      _node_domains.insert(
-          std::make_pair(
-            std::string(host_dom_top.host),
-            std::ref(host_dom_top)));
+  }
+  std::vector<int> node_host_ids = classify_hosts(_host_names,
+                                                  known_node_host_ids);
+
+  std::vector<int> sorted_host_ids(num_hosts);
+  std::iota(sorted_host_ids.begin(), sorted_host_ids.end(), 0);
+  std::sort(sorted_host_ids.begin(),
+            sorted_host_ids.end(),
+            [&](int a, int b) {
+              return _host_names[a] < _host_names[b];
+            });
+
+  _num_host_levels = 0;
+  _node_module_host_ids.resize(num_hosts);
+
+  for (int host_id : sorted_host_ids) {
+    auto & host_dom     = _host_domains[host_id];
+    int    node_host_id = node_host_ids[host_id];
+    if (node_host_id >= 0) {
+      // Found module of node host:
+      _module_host_ids.push_back(host_id);
+      _node_module_host_ids[node_host_id].push_back(host_id);
+      /* Set node hostname as parent: */
+      strncpy(host_dom.parent, _host_names[node_host_id].c_str(),
+              DART_LOCALITY_HOST_MAX_SIZE - 1);
+      host_dom.parent[DART_LOCALITY_HOST_MAX_SIZE - 1] = '\0';
+      host_dom.level   = 1;
+      _num_host_levels = 1;
+    } else {
+      // Host name is node:
+      _node_host_ids.push_back(host_id);
+      host_dom.parent[0] = '\0';
+      host_dom.level     = 0;
     }
   }
 }
@@ -37,8 +37,10 @@
 #  include <numa.h>
 #endif
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 
 namespace dyloc {
@@ -114,6 +116,10 @@ hwinfo::hwinfo() {
   _hw.numa_memory_bytes   = -1;
   _hw.num_scopes          = -1;
 
+  for (int n = 0; n < DYLOC_LOCALITY_MAX_NUMA_ID; n++) {
+    _hw.numa_distances[n] = -1;
+  }
+
   dyloc_locality_scope_pos_t undef_scope;
   undef_scope.scope = DYLOC_LOCALITY_SCOPE_UNDEFINED;
   undef_scope.index = -1;
@@ -197,16 +203,37 @@ void hwinfo::collect() {
          obj;
          obj = obj->parent) {
 
+#if HWLOC_API_VERSION >= 0x00020000
+      /* Since hwloc 2, NUMA nodes are memory children of the object
+       * with their cpuset instead of being contained in the parent
+       * hierarchy. Add the NUMA scope above this object as in the
+       * hwloc 1 hierarchy: */
+      hwloc_obj_t numa_child_obj = NULL;
+      if (obj->memory_arity > 0 &&
+          obj->memory_first_child->type == HWLOC_OBJ_NUMANODE) {
+        numa_child_obj = obj->memory_first_child;
+      }
+#endif
+      if (obj->type != HWLOC_OBJ_MACHINE) {
+        _hw.scopes[_hw.num_scopes].scope =
+          dyloc__hwloc_obj_type_to_scope(obj->type);
+        _hw.scopes[_hw.num_scopes].index = obj->logical_index;
+        DYLOC_LOG_TRACE("dylocxx::hwinfo.collect",
+                        "hwloc: parent[", _hw.num_scopes, "](",
+                        "scope:", _hw.scopes[_hw.num_scopes].scope,
+                        "index:", _hw.scopes[_hw.num_scopes].index,
+                        ")");
+        _hw.num_scopes++;
+      }
+#if HWLOC_API_VERSION >= 0x00020000
+      if (numa_child_obj != NULL) {
+        _hw.numa_id = numa_child_obj->logical_index;
+        _hw.scopes[_hw.num_scopes].scope = DYLOC_LOCALITY_SCOPE_NUMA;
+        _hw.scopes[_hw.num_scopes].index = _hw.numa_id;
+        _hw.num_scopes++;
+      }
+#endif
       if (obj->type == HWLOC_OBJ_MACHINE) { break; }
-      _hw.scopes[_hw.num_scopes].scope =
-        dyloc__hwloc_obj_type_to_scope(obj->type);
-      _hw.scopes[_hw.num_scopes].index = obj->logical_index;
-      DYLOC_LOG_TRACE("dylocxx::hwinfo.collect",
-                      "hwloc: parent[", _hw.num_scopes, "](",
-                      "scope:", _hw.scopes[_hw.num_scopes].scope,
-                      "index:", _hw.scopes[_hw.num_scopes].index,
-                      ")");
-      _hw.num_scopes++;
 
 #if HWLOC_API_VERSION < 0x00020000
       if (obj->type == HWLOC_OBJ_CACHE) {
@@ -283,19 +310,67 @@ void hwinfo::collect() {
   if (_hw.system_memory_bytes < 0) {
     hwloc_obj_t obj;
     obj = hwloc_get_obj_by_type(topology, HWLOC_OBJ_MACHINE, 0);
+#if HWLOC_API_VERSION < 0x00020000
     _hw.system_memory_bytes = obj->memory.total_memory / MBYTES;
+#else
+    _hw.system_memory_bytes = obj->total_memory / MBYTES;
+#endif
   }
   if (_hw.numa_memory_bytes < 0) {
     hwloc_obj_t obj;
     obj = hwloc_get_obj_by_type(topology, DYLOC__HWLOC_OBJ_NUMANODE, 0);
     if(obj != NULL) {
+#if HWLOC_API_VERSION < 0x00020000
       _hw.numa_memory_bytes = obj->memory.total_memory / MBYTES;
+#else
+      _hw.numa_memory_bytes = obj->attr->numanode.local_memory / MBYTES;
+#endif
     } else {
       /* No NUMA domain: */
       _hw.numa_memory_bytes = _hw.system_memory_bytes;
     }
   }
 
+  if (_hw.numa_id >= 0 && _hw.numa_id < DYLOC_LOCALITY_MAX_NUMA_ID) {
+    /* Row of the NUMA distance matrix (ACPI SLIT) for the unit's NUMA
+     * domain, matrix entries are in logical index order: */
+#if HWLOC_API_VERSION < 0x00020000
+    const struct hwloc_distances_s * numa_dist =
+      hwloc_get_whole_distance_matrix_by_type(topology, HWLOC_OBJ_NODE);
+    if (numa_dist != NULL && numa_dist->latency != NULL &&
+        _hw.numa_id < (int)numa_dist->nbobjs) {
+      int n_numa = numa_dist->nbobjs;
+      for (int n = 0; n < n_numa && n < DYLOC_LOCALITY_MAX_NUMA_ID; n++) {
+        /* Latencies are normalized such that local distance is 1.0: */
+        _hw.numa_distances[n] = (int)(
+          10 * numa_dist->latency[_hw.numa_id * n_numa + n] + 0.5);
+      }
+    }
+#else
+    struct hwloc_distances_s * numa_dist;
+    unsigned n_dist = 1;
+    if (hwloc_distances_get_by_type(
+          topology, HWLOC_OBJ_NUMANODE, &n_dist, &numa_dist,
+          HWLOC_DISTANCES_KIND_MEANS_LATENCY, 0) == 0 && n_dist > 0) {
+      int n_numa = numa_dist->nbobjs;
+      int row    = -1;
+      for (int n = 0; n < n_numa; n++) {
+        if ((int)numa_dist->objs[n]->logical_index == _hw.numa_id) {
+          row = n;
+        }
+      }
+      for (int n = 0; row >= 0 && n < n_numa; n++) {
+        int numa_idx = numa_dist->objs[n]->logical_index;
+        if (numa_idx < DYLOC_LOCALITY_MAX_NUMA_ID) {
+          _hw.numa_distances[numa_idx] =
+            (int)(numa_dist->values[row * n_numa + n]);
+        }
+      }
+      hwloc_distances_release(topology, numa_dist);
+    }
+#endif
+  }
+
   hwloc_topology_destroy(topology);
   DYLOC_LOG_TRACE("dylocxx::hwinfo.collect", "hwloc:",
                   "num_numa:",    _hw.num_numa,
@@ -384,11 +459,39 @@ void hwinfo::collect() {
 
 #ifdef DYLOC_ENABLE_NUMA
   DYLOC_LOG_TRACE("dylocxx::hwinfo: using numalib");
-  if (_hw.num_numa < 0) {
-    _hw.num_numa = numa_max_node() + 1;
-  }
-  if (_hw.numa_id < 0 && _hw.cpu_id >= 0) {
-    _hw.numa_id = numa_node_of_cpu(_hw.cpu_id);
+  if (numa_available() >= 0) {
+    /* NUMA ids are logical indices like in hwloc, i.e. the position of
+     * the node in ascending order of the OS ids of configured nodes: */
+    std::vector<int> numa_os_ids;
+    for (int n = 0; n <= numa_max_node(); n++) {
+      if (numa_bitmask_isbitset(numa_all_nodes_ptr, n)) {
+        numa_os_ids.push_back(n);
+      }
+    }
+    if (_hw.num_numa < 0) {
+      _hw.num_numa = numa_os_ids.size();
+    }
+    if (_hw.numa_id < 0) {
+      int cpu_os_id  = sched_getcpu();
+      int numa_os_id = (cpu_os_id >= 0) ? numa_node_of_cpu(cpu_os_id) : -1;
+      auto numa_os_id_it = std::lower_bound(numa_os_ids.begin(),
+                                            numa_os_ids.end(),
+                                            numa_os_id);
+      if (numa_os_id_it != numa_os_ids.end() &&
+          *numa_os_id_it == numa_os_id) {
+        _hw.numa_id = numa_os_id_it - numa_os_ids.begin();
+      }
+    }
+    if (_hw.numa_distances[0] < 0 && _hw.numa_id >= 0 &&
+        _hw.numa_id < static_cast<int>(numa_os_ids.size())) {
+      for (int n = 0; n < static_cast<int>(numa_os_ids.size()) &&
+                      n < DYLOC_LOCALITY_MAX_NUMA_ID;
+           n++) {
+        int numa_dist = numa_distance(numa_os_ids[_hw.numa_id],
+                                      numa_os_ids[n]);
+        _hw.numa_distances[n] = (numa_dist > 0) ? numa_dist : -1;
+      }
+    }
   }
 #endif
 
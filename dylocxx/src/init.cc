@@ -51,12 +51,12 @@ bool is_initialized() {
 }
 
 #if 0
-const unit_locality & query_unit_locality(
+unit_locality query_unit_locality(
   dart_global_unit_t u) {
   return rt.unit_locality(u);
 }
 
-const unit_locality & query_unit_locality(
+unit_locality query_unit_locality(
   dart_team_t t,
   dart_team_unit_t u) {
   return rt.unit_locality(t, u);
@@ -68,6 +68,31 @@ dyloc::topology & team_topology(
   return rt.team_topology(t);
 }
 
+std::shared_ptr<const topology> team_topology_snapshot(
+  dart_team_t t) {
+  return rt.team_topology_snapshot(t);
+}
+
+uint64_t update_team_topology(
+  const std::function<void(topology &)> & mutate,
+  dart_team_t                             t) {
+  return rt.update_team_topology(t, mutate);
+}
+
+uint64_t publish_team_topology(
+  dart_team_t t) {
+  return rt.publish_team_topology(t);
+}
+
+bool refresh_unit_locality() {
+  return rt.refresh_unit_locality();
+}
+
+size_t resync_unit_localities(
+  dart_team_t t) {
+  return rt.resync_unit_localities(t);
+}
+
 const dyloc::host_topology & team_host_topology(
   dart_team_t t) {
   return rt.team_host_topology(t);
@@ -0,0 +1,150 @@
+
+#include <dyloc/common/config.h>
+
+#ifdef DYLOC__PLATFORM__LINUX
+/* _GNU_SOURCE required for pthread_setaffinity_np() */
+#  ifndef _GNU_SOURCE
+#    define _GNU_SOURCE
+#  endif
+#  include <sched.h>
+#  include <pthread.h>
+#endif
+
+#include <dylocxx/latency_probe.h>
+#include <dylocxx/exception.h>
+
+#include <dylocxx/internal/logging.h>
+
+#ifdef DYLOC_ENABLE_HWLOC
+#  include <hwloc.h>
+#  include <hwloc/helper.h>
+#endif
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+
+namespace dyloc {
+
+namespace {
+
+/* Counter in a dedicated cache line, prevents false sharing with the
+ * stack frames of the probe threads: */
+struct alignas(64) cache_line_counter {
+  std::atomic<int> value;
+};
+
+bool pin_current_thread(int cpu_os_id) {
+#ifdef DYLOC__PLATFORM__LINUX
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu_os_id, &cpuset);
+  return (pthread_setaffinity_np(
+            pthread_self(), sizeof(cpu_set_t), &cpuset) == 0);
+#else
+  dyloc__unused(cpu_os_id);
+  return false;
+#endif
+}
+
+} // namespace
+
+
+latency_probe::latency_probe(int num_rounds)
+: _num_rounds(num_rounds) {
+  if (_num_rounds <= 0) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "number of latency probe rounds must be positive");
+  }
+#ifdef DYLOC_ENABLE_HWLOC
+  hwloc_topology_t topology;
+  hwloc_topology_init(&topology);
+  hwloc_topology_load(topology);
+  int n_cpus = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_PU);
+  _cpu_os_ids.resize(n_cpus > 0 ? n_cpus : 0);
+  for (int cpu = 0; cpu < n_cpus; ++cpu) {
+    hwloc_obj_t cpu_obj = hwloc_get_obj_by_type(
+                            topology, HWLOC_OBJ_PU, cpu);
+    _cpu_os_ids[cpu] = static_cast<int>(cpu_obj->os_index);
+  }
+  hwloc_topology_destroy(topology);
+#endif
+}
+
+int latency_probe::os_cpu_id(int cpu_id) const {
+  if (_cpu_os_ids.empty()) {
+    // CPU ids have been resolved using sched_getcpu():
+    return cpu_id;
+  }
+  if (cpu_id < 0 || cpu_id >= static_cast<int>(_cpu_os_ids.size())) {
+    return -1;
+  }
+  return _cpu_os_ids[cpu_id];
+}
+
+int latency_probe::cpu_latency(int cpu_id_a, int cpu_id_b) const {
+  int cpu_os_id_a = os_cpu_id(cpu_id_a);
+  int cpu_os_id_b = os_cpu_id(cpu_id_b);
+  if (cpu_os_id_a < 0 || cpu_os_id_b < 0) {
+    return -1;
+  }
+  if (cpu_os_id_a == cpu_os_id_b) {
+    return 0;
+  }
+
+  const int num_warmup = _num_rounds / 10 + 1;
+  const int num_rounds = _num_rounds + num_warmup;
+
+  cache_line_counter counter;
+  counter.value.store(0);
+
+  std::atomic<bool> pinned(true);
+  std::chrono::steady_clock::duration elapsed;
+
+  // Both threads complete the protocol even if pinning failed to avoid
+  // a deadlock, the result is discarded then:
+  std::thread pong([&]() {
+      if (!pin_current_thread(cpu_os_id_b)) { pinned.store(false); }
+      for (int r = 0; r < num_rounds; ++r) {
+        while (counter.value.load(std::memory_order_acquire) != 2 * r + 1)
+        { }
+        counter.value.store(2 * r + 2, std::memory_order_release);
+      }
+    });
+  std::thread ping([&]() {
+      if (!pin_current_thread(cpu_os_id_a)) { pinned.store(false); }
+      auto ts_start = std::chrono::steady_clock::now();
+      for (int r = 0; r < num_rounds; ++r) {
+        if (r == num_warmup) {
+          ts_start = std::chrono::steady_clock::now();
+        }
+        counter.value.store(2 * r + 1, std::memory_order_release);
+        while (counter.value.load(std::memory_order_acquire) != 2 * r + 2)
+        { }
+      }
+      elapsed = std::chrono::steady_clock::now() - ts_start;
+    });
+  ping.join();
+  pong.join();
+
+  if (!pinned.load()) {
+    DYLOC_LOG_WARN("dylocxx::latency_probe.cpu_latency",
+                   "could not pin probe threads to CPUs",
+                   cpu_os_id_a, cpu_os_id_b);
+    return -1;
+  }
+  auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      elapsed).count();
+  int  latency_ns = static_cast<int>(elapsed_ns / (2 * _num_rounds));
+
+  DYLOC_LOG_TRACE("dylocxx::latency_probe.cpu_latency",
+                  "cpu:", cpu_id_a, "<->", cpu_id_b,
+                  "latency:", latency_ns, "ns");
+  return latency_ns;
+}
+
+} // namespace dyloc
+
@@ -52,6 +52,7 @@ locality_domain::locality_domain(
   g_index    = child_index;
   team       = parent.team;
   host       = parent.host;
+  host_id    = parent.host_id;
   domain_tag = ss.str();
 }
 
@@ -0,0 +1,199 @@
+
+#include <dylocxx/network_topology.h>
+#include <dylocxx/exception.h>
+
+#include <dylocxx/internal/logging.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cstdlib>
+
+
+namespace dyloc {
+
+namespace {
+
+std::string to_lower(std::string str) {
+  std::transform(str.begin(), str.end(), str.begin(),
+                 [](char c) { return std::tolower(c); });
+  return str;
+}
+
+/* Split at separator characters that are not enclosed in brackets: */
+std::vector<std::string> split_toplevel(
+  const std::string & str,
+  char                sep) {
+  std::vector<std::string> items;
+  std::string              item;
+  int                      depth = 0;
+  for (char c : str) {
+    if (c == '[') { ++depth; }
+    if (c == ']') { --depth; }
+    if (c == sep && depth == 0) {
+      if (!item.empty()) { items.push_back(item); }
+      item.clear();
+    } else {
+      item.push_back(c);
+    }
+  }
+  if (!item.empty()) { items.push_back(item); }
+  return items;
+}
+
+} // namespace
+
+network_topology::network_topology(const std::string & config_file) {
+  DYLOC_LOG_DEBUG("dylocxx::network_topology.()", "file:", config_file);
+
+  std::ifstream is(config_file);
+  if (!is) {
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "could not read network topology from " << config_file);
+  }
+  std::string line;
+  while (std::getline(is, line)) {
+    auto comment_pos = line.find('#');
+    if (comment_pos != std::string::npos) {
+      line.resize(comment_pos);
+    }
+    std::istringstream ls(line);
+    std::string        token;
+    std::string        switch_name;
+    std::string        nodes;
+    std::string        switches;
+    while (ls >> token) {
+      auto assign_pos = token.find('=');
+      if (assign_pos == std::string::npos) {
+        continue;
+      }
+      auto key   = to_lower(token.substr(0, assign_pos));
+      auto value = token.substr(assign_pos + 1);
+      if (key == "switchname") { switch_name = value; }
+      if (key == "nodes")      { nodes       = value; }
+      if (key == "switches")   { switches    = value; }
+    }
+    if (switch_name.empty()) {
+      continue;
+    }
+    int sw_id = switch_id(switch_name);
+    for (const auto & sub_switch_name : expand_hostlist(switches)) {
+      int sub_sw_id = switch_id(sub_switch_name);
+      _switches[sub_sw_id].parent = sw_id;
+      _switches[sw_id].switches.push_back(sub_sw_id);
+    }
+    for (const auto & node_hostname : expand_hostlist(nodes)) {
+      if (_node_switches.count(node_hostname) > 0) {
+        DYLOC_LOG_WARN("dylocxx::network_topology.()",
+                       "node", node_hostname, "connected to",
+                       "multiple switches, using first");
+        continue;
+      }
+      _node_switches[node_hostname] = sw_id;
+      _switches[sw_id].nodes.push_back(node_hostname);
+    }
+  }
+
+  int rank = 0;
+  for (int sw_id = 0; sw_id < static_cast<int>(_switches.size()); ++sw_id) {
+    if (_switches[sw_id].parent < 0) {
+      rank_nodes(sw_id, rank);
+    }
+  }
+  DYLOC_LOG_DEBUG("dylocxx::network_topology.()",
+                  "switches:", _switches.size(),
+                  "nodes:",    _node_switches.size());
+}
+
+std::vector<int> network_topology::switch_path(
+  const std::string & hostname) const {
+  std::vector<int> path;
+  auto node_switch_it = _node_switches.find(hostname);
+  if (node_switch_it == _node_switches.end()) {
+    return path;
+  }
+  for (int sw_id = node_switch_it->second;
+       sw_id >= 0 &&
+       // Guard against cyclic switch definitions:
+       path.size() < _switches.size();
+       sw_id = _switches[sw_id].parent) {
+    path.push_back(sw_id);
+  }
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+int network_topology::node_rank(const std::string & hostname) const {
+  auto node_rank_it = _node_ranks.find(hostname);
+  return (node_rank_it == _node_ranks.end()) ? -1 : node_rank_it->second;
+}
+
+std::vector<std::string> network_topology::expand_hostlist(
+  const std::string & hostlist) {
+  std::vector<std::string> hostnames;
+  for (const auto & item : split_toplevel(hostlist, ',')) {
+    auto range_begin = item.find('[');
+    auto range_end   = item.find(']', range_begin);
+    if (range_begin == std::string::npos || range_end == std::string::npos) {
+      hostnames.push_back(item);
+      continue;
+    }
+    auto prefix = item.substr(0, range_begin);
+    auto ranges = item.substr(range_begin + 1, range_end - range_begin - 1);
+    // Suffix may contain further ranges:
+    auto suffixes = expand_hostlist(item.substr(range_end + 1));
+    if (suffixes.empty()) {
+      suffixes.push_back("");
+    }
+    for (const auto & range : split_toplevel(ranges, ',')) {
+      auto sep_pos = range.find('-');
+      auto first   = range.substr(0, sep_pos);
+      auto last    = (sep_pos == std::string::npos)
+                     ? first
+                     : range.substr(sep_pos + 1);
+      // Zero-padded width of indices:
+      int  width   = first.size();
+      long idx_end = std::strtol(last.c_str(), nullptr, 10);
+      for (long idx = std::strtol(first.c_str(), nullptr, 10);
+           idx <= idx_end; ++idx) {
+        auto idx_str = std::to_string(idx);
+        if (static_cast<int>(idx_str.size()) < width) {
+          idx_str.insert(0, width - idx_str.size(), '0');
+        }
+        for (const auto & suffix : suffixes) {
+          hostnames.push_back(prefix + idx_str + suffix);
+        }
+      }
+    }
+  }
+  return hostnames;
+}
+
+int network_topology::switch_id(const std::string & switch_name) {
+  auto switch_id_it = _switch_ids.find(switch_name);
+  if (switch_id_it != _switch_ids.end()) {
+    return switch_id_it->second;
+  }
+  int sw_id = _switches.size();
+  network_switch sw;
+  sw.name = switch_name;
+  _switches.push_back(sw);
+  _switch_ids[switch_name] = sw_id;
+  return sw_id;
+}
+
+void network_topology::rank_nodes(int sw_id, int & rank) {
+  for (const auto & node_hostname : _switches[sw_id].nodes) {
+    _node_ranks[node_hostname] = rank++;
+  }
+  for (int sub_sw_id : _switches[sw_id].switches) {
+    rank_nodes(sub_sw_id, rank);
+  }
+}
+
+} // namespace dyloc
+
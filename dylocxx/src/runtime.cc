@@ -5,10 +5,13 @@
 #include <dylocxx/unit_mapping.h>
 #include <dylocxx/unit_locality.h>
 #include <dylocxx/locality_domain.h>
+#include <dylocxx/hwinfo.h>
+#include <dylocxx/unit_placement.h>
 
 #include <dylocxx/topology.h>
 
 #include <dylocxx/adapter/dart.h>
+#include <dylocxx/exception.h>
 
 #include <dylocxx/internal/logging.h>
 #include <dylocxx/internal/assert.h>
@@ -17,15 +20,23 @@
 
 #include <dash/dart/if/dart.h>
 
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <cstdlib>
+#include <cstring>
+
 
 namespace dyloc {
 
 void runtime::initialize() {
   // TODO: initialize global host (hardware) topology here
+  _placement = unit_placement::sample();
   initialize_locality(DART_TEAM_ALL);
 }
 
 void runtime::finalize() {
+  _topologies.clear();
   _unit_mappings.clear();
   _host_topologies.clear();
 }
@@ -35,27 +46,140 @@ void runtime::initialize_locality(dart_team_t team) {
 
   DYLOC_LOG_DEBUG("dylocxx::runtime.initialize_locality", "unit mappings");
   _unit_mappings.insert(
-      std::make_pair(team, unit_mapping(team)));
+      std::make_pair(team, std::make_shared<const unit_mapping>(team)));
 
   DYLOC_LOG_DEBUG("dylocxx::runtime.initialize_locality", "host topologies");
   _host_topologies.insert(
       std::make_pair(
         team,
-        host_topology(_unit_mappings.at(team))));
+        host_topology(*_unit_mappings.at(team))));
 
   DYLOC_LOG_DEBUG("dylocxx::runtime.initialize_locality", "domain graph");
-  _topologies.insert(
-      std::make_pair(
-        team,
+  const char * build_mode = std::getenv("DYLOC_TOPOLOGY_BUILD");
+  if (build_mode == nullptr || std::strcmp(build_mode, "all") == 0) {
+    _topologies.emplace(
+        std::piecewise_construct,
+        std::forward_as_tuple(team),
+        std::forward_as_tuple(
+          topology(
+            team,
+            _host_topologies.at(team),
+            _unit_mappings.at(team))));
+  } else if (std::strcmp(build_mode, "root") == 0 ||
+             std::strcmp(build_mode, "node") == 0) {
+    bcast_topology(team, std::strcmp(build_mode, "node") == 0);
+  } else {
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "invalid DYLOC_TOPOLOGY_BUILD mode '" << build_mode << "', " <<
+      "expected 'all', 'root' or 'node'");
+  }
+
+  DYLOC_LOG_DEBUG("dylocxx::runtime.initialize_locality", ">");
+}
+
+void runtime::bcast_topology(dart_team_t team, bool per_node) {
+  const auto & host_topo = _host_topologies.at(team);
+  const auto & unit_map  = *_unit_mappings.at(team);
+
+  // Team of units sharing the image, unit 0 in the team builds the
+  // topology:
+  dart_team_t bcast_team = team;
+  if (per_node && host_topo.num_hosts() > 1) {
+    dart_group_t local_group;
+    DYLOC_ASSERT_RETURNS(dart_group_create(&local_group), DART_OK);
+    const auto & my_hwinfo = unit_map[dyloc::myid(team)].data()->hwinfo;
+    for (auto local_unit_gid :
+           host_topo.unit_ids(host_topo.host_id(my_hwinfo.host))) {
+      DYLOC_ASSERT_RETURNS(
+        dart_group_addmember(local_group, local_unit_gid),
+        DART_OK);
+    }
+    DYLOC_ASSERT_RETURNS(
+      dart_team_create(team, local_group, &bcast_team),
+      DART_OK);
+    DYLOC_ASSERT_RETURNS(dart_group_destroy(&local_group), DART_OK);
+  }
+  dart_team_unit_t bcast_root;
+  bcast_root.id = 0;
+
+  std::vector<char> image;
+  if (dyloc::myid(bcast_team).id == bcast_root.id) {
+    image = topology(team, host_topo, unit_map).serialize();
+  }
+  size_t image_size = image.size();
+  DYLOC_ASSERT_RETURNS(
+    dart_bcast(&image_size, 1, DART_TYPE_SIZET, bcast_root, bcast_team),
+    DART_OK);
+  image.resize(image_size);
+  DYLOC_ASSERT_RETURNS(
+    dart_bcast(image.data(), image_size, DART_TYPE_BYTE,
+               bcast_root, bcast_team),
+    DART_OK);
+  DYLOC_LOG_DEBUG("dylocxx::runtime.bcast_topology",
+                  "per node:",   per_node,
+                  "image size:", image_size);
+
+  if (bcast_team != team) {
+    DYLOC_ASSERT_RETURNS(dart_team_destroy(&bcast_team), DART_OK);
+  }
+
+  _topologies.emplace(
+      std::piecewise_construct,
+      std::forward_as_tuple(team),
+      std::forward_as_tuple(
         topology(
-          team,
-          _host_topologies.at(team),
+          topology_image(image.data(), image.size()),
           _unit_mappings.at(team))));
+}
 
-  DYLOC_LOG_DEBUG("dylocxx::runtime.initialize_locality", ">");
+bool runtime::refresh_unit_locality() {
+  auto placement = unit_placement::sample();
+  if (!is_migrated(_placement, placement)) {
+    return false;
+  }
+  _placement = placement;
+
+  hwinfo unit_hwinfo;
+  unit_hwinfo.collect();
+  DYLOC_LOG_DEBUG("dylocxx::runtime.refresh_unit_locality",
+                  "unit moved:", *unit_hwinfo.data());
+  _moved_hwinfo = *unit_hwinfo.data();
+  for (const auto & team_unit_mapping : _unit_mappings) {
+    _unsynced_teams.insert(team_unit_mapping.first);
+  }
+  return true;
+}
+
+size_t runtime::resync_unit_localities(dart_team_t team) {
+  refresh_unit_locality();
+
+  // Published topology versions share the current mapping, resync a
+  // copy:
+  auto unit_map = std::make_shared<unit_mapping>(*_unit_mappings.at(team));
+  // Locality of the calling unit is applied together with the other
+  // moved units' localities in the exchange:
+  const dyloc_hwinfo_t * my_hwinfo = nullptr;
+  if (_unsynced_teams.erase(team) > 0) {
+    my_hwinfo = &_moved_hwinfo;
+  }
+  auto moved_units = unit_map->resync(my_hwinfo);
+  if (moved_units.empty()) {
+    return 0;
+  }
+  _unit_mappings[team] = unit_map;
+  _topologies.at(team).update([&](topology & topo) {
+      topo.replace_unit_map(unit_map);
+      for (auto moved_unit : moved_units) {
+        topo.move_unit_domain(dyloc::l2g(team, moved_unit),
+                              (*unit_map)[moved_unit].data()->hwinfo);
+      }
+    });
+  return moved_units.size();
 }
 
 void runtime::finalize_locality(dart_team_t team) {
+  _unsynced_teams.erase(team);
   _topologies.erase(
       _topologies.find(team));
   _unit_mappings.erase(
@@ -2,6 +2,11 @@
 #include <dylocxx/topology.h>
 #include <dylocxx/utility.h>
 #include <dylocxx/hwinfo.h>
+#include <dylocxx/latency_probe.h>
+
+#include <dylocxx/adapter/dart.h>
+
+#include <dash/dart/if/dart.h>
 
 #include <dylocxx/internal/logging.h>
 #include <dylocxx/internal/assert.h>
@@ -17,12 +22,93 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <numeric>
 #include <iostream>
 #include <sstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <cstdlib>
+#include <cstring>
 
 
 namespace dyloc {
 
+namespace {
+
+/*
+ * Number of threads used to build node subtrees, specified in environment
+ * variable DYLOC_BUILD_THREADS:
+ *
+ * - "<n>":  n threads, including the calling thread
+ * - "auto": the share of hardware threads of every unit at the local host
+ *
+ * Node subtrees are built by the calling thread only by default.
+ */
+int num_build_threads(int num_local_units) {
+  const char * build_threads_env = std::getenv("DYLOC_BUILD_THREADS");
+  if (build_threads_env == nullptr || *build_threads_env == '\0') {
+    return 1;
+  }
+  if (std::string(build_threads_env) == "auto") {
+    int num_hw_threads = std::thread::hardware_concurrency();
+    return std::max(1, num_hw_threads / std::max(1, num_local_units));
+  }
+  int num_threads = std::atoi(build_threads_env);
+  if (num_threads <= 0) {
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "invalid value of DYLOC_BUILD_THREADS: " << build_threads_env);
+  }
+  return num_threads;
+}
+
+/*
+ * Whether symmetric node subtrees are stored as instances of a template
+ * subtree, specified in environment variable DYLOC_TOPOLOGY_SYMMETRY:
+ *
+ * - "explicit":   every node subtree is built (default)
+ * - "compressed": only subtrees of distinct node configurations are built
+ */
+bool compress_symmetric_nodes() {
+  const char * symmetry_env = std::getenv("DYLOC_TOPOLOGY_SYMMETRY");
+  if (symmetry_env == nullptr || *symmetry_env == '\0' ||
+      std::string(symmetry_env) == "explicit") {
+    return false;
+  }
+  if (std::string(symmetry_env) == "compressed") {
+    return true;
+  }
+  DYLOC_THROW(
+    dyloc::exception::runtime_config_error,
+    "invalid value of DYLOC_TOPOLOGY_SYMMETRY: " << symmetry_env);
+}
+
+/*
+ * Share of vertices of removed domains in the topology graph above which
+ * the graph is compacted, specified in environment variable
+ * DYLOC_TOPOLOGY_GC_RATIO. Automatic compaction invalidates vertex
+ * descriptors held by callers and is disabled by default and for ratios
+ * <= 0.
+ */
+double garbage_ratio() {
+  const char * gc_ratio_env = std::getenv("DYLOC_TOPOLOGY_GC_RATIO");
+  if (gc_ratio_env == nullptr || *gc_ratio_env == '\0') {
+    return 0;
+  }
+  char * gc_ratio_end = nullptr;
+  double gc_ratio     = std::strtod(gc_ratio_env, &gc_ratio_end);
+  if (*gc_ratio_end != '\0') {
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "invalid value of DYLOC_TOPOLOGY_GC_RATIO: " << gc_ratio_env);
+  }
+  return gc_ratio;
+}
+
+} // namespace
+
 std::ostream & operator<<(
   std::ostream   & os,
   const topology & topo) {
@@ -46,6 +132,220 @@ std::ostream & operator<<(
   return operator<<(os, ss.str());
 }
 
+topology::topology(
+  const topology_image                & image,
+  std::shared_ptr<const unit_mapping>   unit_map)
+: _unit_mapping(std::move(unit_map)) {
+  const auto & hdr = image.header();
+  DYLOC_LOG_DEBUG("dylocxx::topology.topology(image)",
+                  "image size:", hdr.size,
+                  "domains:",    hdr.num_domains,
+                  "edges:",      hdr.num_edges);
+  // Restoring accesses all records directly:
+  image.validate_records();
+
+  for (uint32_t d = 0; d < hdr.num_domains; ++d) {
+    const auto & domain_rec = image.domains()[d];
+    std::string  domain_tag(image.string(domain_rec.tag_offset));
+    auto         state      = static_cast<vertex_state>(domain_rec.state);
+
+    auto domain_vertex = boost::add_vertex({ domain_tag, state }, _graph);
+    if (state == vertex_state::hidden) {
+      continue;
+    }
+    _domain_vertices[domain_tag] = domain_vertex;
+
+    locality_domain domain;
+    domain.domain_tag = domain_tag;
+    domain.host       = image.string(domain_rec.host_offset);
+    domain.host_id    = domain_rec.host_id;
+    domain.scope      = static_cast<dyloc_locality_scope_t>(
+                          domain_rec.scope);
+    domain.level      = domain_rec.level;
+    domain.g_index    = domain_rec.g_index;
+    domain.r_index    = domain_rec.r_index;
+    domain.num_cores  = domain_rec.num_cores;
+    domain.team       = hdr.team;
+    const int32_t * domain_unit_ids = image.unit_ids(domain_rec);
+    domain.unit_ids.resize(domain_rec.num_unit_ids);
+    for (uint32_t u = 0; u < domain_rec.num_unit_ids; ++u) {
+      domain.unit_ids[u].id = domain_unit_ids[u];
+    }
+    _domains.insert(std::make_pair(domain_tag, std::move(domain)));
+    index_domain(domain_vertex);
+  }
+  for (uint32_t e = 0; e < hdr.num_edges; ++e) {
+    const auto & edge_rec = image.edges()[e];
+    boost::add_edge(edge_rec.source, edge_rec.target,
+                    { static_cast<edge_type>(edge_rec.type),
+                      edge_rec.distance },
+                    _graph);
+  }
+  for (uint32_t u = 0; u < hdr.num_units; ++u) {
+    _unit_vertices[image.units()[u].unit_id] = image.units()[u].domain;
+  }
+}
+
+std::vector<char> topology::serialize(bool with_unit_mapping) const {
+  if (is_compressed()) {
+    topology expanded(*this);
+    expanded.expand();
+    return expanded.serialize(with_unit_mapping);
+  }
+  topology_image_header hdr;
+  std::memset(&hdr, 0, sizeof(hdr));
+
+  auto aligned = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+
+  // Collect string pool and unit ids, hosts are shared by many domains:
+  std::string                               strings;
+  std::unordered_map<std::string, uint64_t> string_offsets;
+  auto add_string = [&](const std::string & str) {
+      auto str_it = string_offsets.find(str);
+      if (str_it != string_offsets.end()) {
+        return str_it->second;
+      }
+      uint64_t offset = strings.size();
+      strings.append(str);
+      strings.push_back('\0');
+      string_offsets[str] = offset;
+      return offset;
+    };
+  add_string("");
+
+  std::vector<topology_image_domain> domain_recs(num_vertices(_graph));
+  std::vector<int32_t>               unit_ids;
+  for (size_t vx = 0; vx < domain_recs.size(); ++vx) {
+    auto & domain_rec = domain_recs[vx];
+    std::memset(&domain_rec, 0, sizeof(domain_rec));
+    const auto & vx_props = _graph[vx];
+    domain_rec.tag_offset = add_string(vx_props.domain_tag);
+    domain_rec.state      = static_cast<int32_t>(vx_props.state);
+    auto domain_it        = _domains.find(vx_props.domain_tag);
+    if (vx_props.state == vertex_state::hidden ||
+        domain_it == _domains.end()) {
+      domain_rec.state = static_cast<int32_t>(vertex_state::hidden);
+      domain_rec.scope = DYLOC_LOCALITY_SCOPE_UNDEFINED;
+      continue;
+    }
+    const auto & domain        = domain_it->second;
+    domain_rec.host_offset     = add_string(domain.host);
+    domain_rec.host_id         = domain.host_id;
+    domain_rec.scope           = domain.scope;
+    domain_rec.level           = domain.level;
+    domain_rec.g_index         = domain.g_index;
+    domain_rec.r_index         = domain.r_index;
+    domain_rec.num_cores       = domain.num_cores;
+    domain_rec.unit_ids_offset = unit_ids.size();
+    domain_rec.num_unit_ids    = domain.unit_ids.size();
+    for (auto unit_id : domain.unit_ids) {
+      unit_ids.push_back(unit_id.id);
+    }
+  }
+
+  std::vector<uint32_t> tag_recs;
+  tag_recs.reserve(_domain_vertices.size());
+  for (const auto & domain_vertex : _domain_vertices) {
+    if (domain_recs[domain_vertex.second].state !=
+          static_cast<int32_t>(vertex_state::hidden)) {
+      tag_recs.push_back(domain_vertex.second);
+    }
+  }
+  std::sort(tag_recs.begin(), tag_recs.end(),
+            [&](uint32_t a, uint32_t b) {
+              return _graph[a].domain_tag < _graph[b].domain_tag;
+            });
+
+  std::vector<topology_image_edge> edge_recs;
+  edge_recs.reserve(num_edges(_graph));
+  for (auto edge_range = edges(_graph);
+       edge_range.first != edge_range.second;
+       ++edge_range.first) {
+    topology_image_edge edge_rec;
+    edge_rec.source   = source(*edge_range.first, _graph);
+    edge_rec.target   = target(*edge_range.first, _graph);
+    edge_rec.type     = static_cast<int32_t>(_graph[*edge_range.first].type);
+    edge_rec.distance = _graph[*edge_range.first].distance;
+    edge_recs.push_back(edge_rec);
+  }
+  std::stable_sort(edge_recs.begin(), edge_recs.end(),
+                   [](const topology_image_edge & a,
+                      const topology_image_edge & b) {
+                     return a.source < b.source;
+                   });
+
+  std::vector<topology_image_unit> unit_recs;
+  unit_recs.reserve(_unit_vertices.size());
+  for (const auto & unit_vertex : _unit_vertices) {
+    topology_image_unit unit_rec;
+    unit_rec.unit_id = unit_vertex.first;
+    unit_rec.domain  = unit_vertex.second;
+    unit_recs.push_back(unit_rec);
+  }
+  std::sort(unit_recs.begin(), unit_recs.end(),
+            [](const topology_image_unit & a,
+               const topology_image_unit & b) {
+              return a.unit_id < b.unit_id;
+            });
+
+  hdr.magic           = topology_image::magic;
+  hdr.version         = topology_image::version;
+  hdr.team            = _domains.at(".").team;
+  hdr.num_domains     = domain_recs.size();
+  hdr.num_edges       = edge_recs.size();
+  hdr.num_units       = unit_recs.size();
+  hdr.num_unit_ids    = unit_ids.size();
+  hdr.num_tags        = tag_recs.size();
+  hdr.num_unit_localities
+                      = with_unit_mapping ? _unit_mapping->size() : 0;
+  hdr.unit_locality_size
+                      = sizeof(dyloc_unit_locality_t);
+  hdr.domains_offset  = aligned(sizeof(hdr));
+  hdr.edges_offset    = aligned(hdr.domains_offset +
+                                domain_recs.size() * sizeof(domain_recs[0]));
+  hdr.units_offset    = aligned(hdr.edges_offset +
+                                edge_recs.size() * sizeof(edge_recs[0]));
+  hdr.unit_ids_offset = aligned(hdr.units_offset +
+                                unit_recs.size() * sizeof(unit_recs[0]));
+  hdr.tags_offset     = aligned(hdr.unit_ids_offset +
+                                unit_ids.size() * sizeof(int32_t));
+  hdr.unit_localities_offset
+                      = aligned(hdr.tags_offset +
+                                tag_recs.size() * sizeof(uint32_t));
+  hdr.strings_offset  = aligned(hdr.unit_localities_offset +
+                                hdr.num_unit_localities *
+                                sizeof(dyloc_unit_locality_t));
+  hdr.strings_size    = strings.size();
+  hdr.size            = aligned(hdr.strings_offset + hdr.strings_size);
+
+  std::vector<char> image(hdr.size, 0);
+  std::memcpy(image.data(), &hdr, sizeof(hdr));
+  std::memcpy(image.data() + hdr.domains_offset, domain_recs.data(),
+              domain_recs.size() * sizeof(domain_recs[0]));
+  std::memcpy(image.data() + hdr.edges_offset, edge_recs.data(),
+              edge_recs.size() * sizeof(edge_recs[0]));
+  std::memcpy(image.data() + hdr.units_offset, unit_recs.data(),
+              unit_recs.size() * sizeof(unit_recs[0]));
+  std::memcpy(image.data() + hdr.unit_ids_offset, unit_ids.data(),
+              unit_ids.size() * sizeof(int32_t));
+  std::memcpy(image.data() + hdr.tags_offset, tag_recs.data(),
+              tag_recs.size() * sizeof(uint32_t));
+  for (uint32_t u = 0; u < hdr.num_unit_localities; ++u) {
+    std::memcpy(image.data() + hdr.unit_localities_offset +
+                  u * sizeof(dyloc_unit_locality_t),
+                _unit_mapping->unit_localities[u].data(),
+                sizeof(dyloc_unit_locality_t));
+  }
+  std::memcpy(image.data() + hdr.strings_offset, strings.data(),
+              strings.size());
+
+  DYLOC_LOG_DEBUG("dylocxx::topology.serialize",
+                  "image size:", hdr.size,
+                  "domains:",    hdr.num_domains,
+                  "edges:",      hdr.num_edges);
+  return image;
+}
+
 void topology::rename_domain(
   const std::string & old_tag,
   const std::string & new_tag) {
@@ -75,74 +375,177 @@ void topology::rename_domain(
 }
 
 void topology::update_domain_attributes(const std::string & parent_tag) {
-  // Update domain tags, recursing down from specified domain.
-  // Could also be implemented using boost::depth_first_search.
+  // Update domain tags below the specified domain in a single pre-order
+  // pass. Tags are assigned before domains are rekeyed so a new tag
+  // cannot collide with the old tag of a domain not relabeled yet.
   auto parent_vx_it = _domain_vertices.find(parent_tag);
   if (parent_vx_it == _domain_vertices.end()) {
     DYLOC_LOG_TRACE("dylocxx::topology.update_domain_attributes",
                     "no vertex found for domain", parent_tag);
     return;
   }
-  typedef boost::graph_traits<graph_t>::out_edge_iterator::reference
-    out_edge_ref;
-
-  auto & domain_vx    = parent_vx_it->second;
-  int    rel_index    = 0;
-  auto   domain_edges = out_edges(domain_vx, _graph);
-  std::for_each(
-    domain_edges.first,
-    domain_edges.second,
-    [&](out_edge_ref parent_domain_edge) {
-      auto sub_domain_vx = target(parent_domain_edge, _graph);
-      const auto & sub_domain_old_tag = _graph[sub_domain_vx].domain_tag;
-      std::ostringstream ss;
-      if (parent_tag != ".") {
-        ss << parent_tag;
-      }
-      ss << "." << rel_index;
-      rename_domain(sub_domain_old_tag, ss.str());
-      update_domain_attributes(ss.str());
-      ++rel_index;
-    });
+  std::vector<std::pair<graph_vertex_t, std::string> > relabeled;
+  std::vector<std::pair<graph_vertex_t, std::string> > open_domains;
+  open_domains.push_back(std::make_pair(parent_vx_it->second, parent_tag));
+  while (!open_domains.empty()) {
+    auto domain_vx  = open_domains.back().first;
+    auto domain_tag = std::move(open_domains.back().second);
+    open_domains.pop_back();
+    int rel_index = 0;
+    for (auto sub_domain_vx : children(domain_vx)) {
+      std::string sub_domain_tag = (domain_tag == ".") ? "" : domain_tag;
+      sub_domain_tag += ".";
+      sub_domain_tag += std::to_string(rel_index++);
+      if (sub_domain_tag != _graph[sub_domain_vx].domain_tag) {
+        relabeled.push_back(std::make_pair(sub_domain_vx, sub_domain_tag));
+      }
+      open_domains.push_back(std::make_pair(sub_domain_vx,
+                                            std::move(sub_domain_tag)));
+    }
+  }
+  DYLOC_LOG_TRACE("dylocxx::topology.update_domain_attributes",
+                  "domain:", parent_tag, "relabeled:", relabeled.size());
+
+  std::vector<locality_domain> relabeled_domains;
+  relabeled_domains.reserve(relabeled.size());
+  for (const auto & vx_tag : relabeled) {
+    const auto & old_tag   = _graph[vx_tag.first].domain_tag;
+    auto         domain_it = _domains.find(old_tag);
+    relabeled_domains.push_back(std::move(domain_it->second));
+    _domains.erase(domain_it);
+    auto domain_vx_it = _domain_vertices.find(old_tag);
+    if (domain_vx_it != _domain_vertices.end() &&
+        domain_vx_it->second == vx_tag.first) {
+      _domain_vertices.erase(domain_vx_it);
+    }
+  }
+  for (size_t r = 0; r < relabeled.size(); ++r) {
+    auto & new_tag = relabeled[r].second;
+    relabeled_domains[r].domain_tag    = new_tag;
+    _graph[relabeled[r].first].domain_tag = new_tag;
+    _domain_vertices[new_tag]          = relabeled[r].first;
+    _domains[new_tag]                  = std::move(relabeled_domains[r]);
+  }
 }
 
 void topology::update_domain_capacities(const std::string & domain_tag) {
-  // Accumulate domain capacities
-  auto parent_vx_it = _domain_vertices.find(domain_tag);
-  if (parent_vx_it == _domain_vertices.end()) {
+  // Accumulate domain capacities in post-order, subdomains are updated
+  // before their parent:
+  auto domain_vx_it = _domain_vertices.find(domain_tag);
+  if (domain_vx_it == _domain_vertices.end()) {
     return;
   }
-  typedef boost::graph_traits<graph_t>::out_edge_iterator::reference
-    out_edge_ref;
-
-  auto & domain = _domains[domain_tag];
-  if (domain.scope != DYLOC_LOCALITY_SCOPE_UNIT) {
-    domain.unit_ids.clear();
-    domain.num_cores      = 0;
-    auto & domain_vx      = parent_vx_it->second;
-    auto   domain_edges   = out_edges(domain_vx, _graph);
-    auto   num_subdomains = std::distance(domain_edges.first,
-                                          domain_edges.second);
-    std::for_each(
-      domain_edges.first,
-      domain_edges.second,
-      [&](out_edge_ref domain_edge) {
-        auto sub_domain_vx          = target(domain_edge, _graph);
-        const auto & sub_domain_tag = _graph[sub_domain_vx].domain_tag;
-        auto & sub_domain           = _domains[sub_domain_tag];
-        // depth-first recurse:
-        update_domain_capacities(sub_domain_tag);
-        // accumulate:
-        domain.unit_ids.insert(domain.unit_ids.begin(),
-                               sub_domain.unit_ids.begin(),
-                               sub_domain.unit_ids.end());
-        domain.num_cores += sub_domain.num_cores;
-      });
-    std::sort(domain.unit_ids.begin(),
-              domain.unit_ids.end(),
-              [](dart_global_unit_t a,
-                 dart_global_unit_t b) { return a.id < b.id; });
+  for (auto sub_domain_vx : descendants_inv(domain_vx_it->second)) {
+    accumulate_domain_capacities(sub_domain_vx);
+  }
+  accumulate_domain_capacities(domain_vx_it->second);
+}
+
+void topology::accumulate_domain_capacities(graph_vertex_t domain_vx) {
+  auto & domain = _domains.at(_graph[domain_vx].domain_tag);
+  if (domain.scope == DYLOC_LOCALITY_SCOPE_UNIT) {
+    return;
   }
+  domain.unit_ids.clear();
+  domain.num_cores = 0;
+  for (auto sub_domain_vx : children(domain_vx)) {
+    const auto & sub_domain = _domains.at(_graph[sub_domain_vx].domain_tag);
+    domain.unit_ids.insert(domain.unit_ids.end(),
+                           sub_domain.unit_ids.begin(),
+                           sub_domain.unit_ids.end());
+    domain.num_cores += sub_domain.num_cores;
+  }
+  std::sort(domain.unit_ids.begin(),
+            domain.unit_ids.end(),
+            [](dart_global_unit_t a,
+               dart_global_unit_t b) { return a.id < b.id; });
+}
+
+void topology::remove_subtree(graph_vertex_t vx) {
+  // Descendants are collected first as removing domains invalidates
+  // the traversal's edge iterators:
+  auto desc_range = descendants(vx);
+  std::vector<graph_vertex_t> removed_vxs(1, vx);
+  removed_vxs.insert(removed_vxs.end(), desc_range.begin(), desc_range.end());
+  DYLOC_LOG_TRACE("dylocxx::topology.remove_subtree",
+                  "domain:",  _graph[vx].domain_tag,
+                  "removed:", removed_vxs.size());
+  for (auto removed_vx : removed_vxs) {
+    unindex_domain(removed_vx);
+    auto removed_it = _domains.find(_graph[removed_vx].domain_tag);
+    if (removed_it != _domains.end() &&
+        removed_it->second.scope == DYLOC_LOCALITY_SCOPE_UNIT) {
+      auto unit_vx_it = _unit_vertices.find(removed_it->second.g_index);
+      if (unit_vx_it != _unit_vertices.end() &&
+          unit_vx_it->second == removed_vx) {
+        _unit_vertices.erase(unit_vx_it);
+      }
+    }
+    _domains.erase(_graph[removed_vx].domain_tag);
+    _graph[removed_vx].state = vertex_state::hidden;
+  }
+  for (auto removed_vx : removed_vxs) {
+    boost::clear_vertex(removed_vx, _graph);
+  }
+}
+
+void topology::select_subtrees(
+  const std::vector<graph_vertex_t> & selected_vxs) {
+  // Mark selected domains, their ancestors and descendants:
+  std::vector<char> selected(num_vertices(_graph), 0);
+  for (auto selected_vx : selected_vxs) {
+    if (selected[selected_vx] == 2) {
+      continue;
+    }
+    selected[selected_vx]     = 2;
+    _graph[selected_vx].state = vertex_state::selected;
+    for (auto ancestor_vx : ancestors(selected_vx)) {
+      if (selected[ancestor_vx]) { break; }
+      selected[ancestor_vx]     = 1;
+      _graph[ancestor_vx].state = vertex_state::selected;
+    }
+    for (auto desc_vx : descendants(selected_vx)) {
+      selected[desc_vx]     = 2;
+      _graph[desc_vx].state = vertex_state::selected;
+    }
+  }
+  // Prune unmarked subdomains of ancestors, descendants of selected
+  // domains are not visited:
+  graph_vertex_t root_vx = selected_vxs.empty()
+                           ? _domain_vertices.at(".")
+                           : selected_vxs.front();
+  for (auto ancestor_vx : ancestors(root_vx)) {
+    root_vx = ancestor_vx;
+  }
+  std::vector<graph_vertex_t> open_vxs(1, root_vx);
+  std::vector<graph_vertex_t> removed_vxs;
+  while (!open_vxs.empty()) {
+    auto vx = open_vxs.back();
+    open_vxs.pop_back();
+    for (auto sub_vx : children(vx)) {
+      if (!selected[sub_vx]) {
+        removed_vxs.push_back(sub_vx);
+      } else if (selected[sub_vx] == 1) {
+        open_vxs.push_back(sub_vx);
+      }
+    }
+  }
+  DYLOC_LOG_DEBUG("dylocxx::topology.select_subtrees",
+                  "selected:", selected_vxs.size(),
+                  "removed subtrees:", removed_vxs.size());
+  for (auto removed_vx : removed_vxs) {
+    remove_subtree(removed_vx);
+  }
+  // Relabel subtrees of selected domains that are not contained in
+  // another selected subtree:
+  for (auto selected_vx : selected_vxs) {
+    auto parent_range = ancestors(selected_vx);
+    if (parent_range.empty() ||
+        selected[*parent_range.begin()] != 2) {
+      update_domain_attributes(_graph[selected_vx].domain_tag);
+    }
+  }
+  update_domain_capacities(_graph[root_vx].domain_tag);
 }
 
 void topology::relink_to_parent(
@@ -183,23 +586,129 @@ void topology::relink_to_parent(
 void topology::move_domain(
   const std::string & domain_tag,
   const std::string & domain_tag_new_parent) {
+  if (is_compressed()) { expand(); }
   relink_to_parent(domain_tag, domain_tag_new_parent);
   update_domain_attributes(
     ancestor({ domain_tag, domain_tag_new_parent }).domain_tag);
 }
 
+void topology::move_unit_domain(
+  dart_global_unit_t     unit_id,
+  const dyloc_hwinfo_t & unit_hwinfo) {
+  if (is_compressed()) { expand(); }
+  auto unit_vx = _unit_vertices.at(unit_id.id);
+  auto unit_it = _domains.find(_graph[unit_vx].domain_tag);
+  if (unit_it == _domains.end() ||
+      _graph[unit_vx].state == vertex_state::hidden) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "unit " << unit_id.id << " is not contained in the topology");
+  }
+  if (unit_it->second.host != unit_hwinfo.host) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "unit " << unit_id.id << " moved from host " <<
+      unit_it->second.host << " to " << unit_hwinfo.host);
+  }
+  auto old_parent_vx = *ancestors(unit_vx).begin();
+
+  // Module domain of the unit, its subdomains are built from the units'
+  // locality scopes:
+  graph_vertex_t module_vx = old_parent_vx;
+  for (auto ancestor_vx : ancestors(unit_vx)) {
+    auto scope = _domains.at(_graph[ancestor_vx].domain_tag).scope;
+    module_vx  = ancestor_vx;
+    if (scope == DYLOC_LOCALITY_SCOPE_MODULE ||
+        scope == DYLOC_LOCALITY_SCOPE_NODE) {
+      break;
+    }
+  }
+
+  // Follow the unit's scopes from the module domain down to its CORE
+  // domain, adding domains that do not exist yet:
+  auto parent_vx = module_vx;
+  for (int s = unit_hwinfo.num_scopes - 1; s >= 0; --s) {
+    const auto & scope_pos   = unit_hwinfo.scopes[s];
+    auto         sub_vx      = boost::graph_traits<graph_t>::null_vertex();
+    int          num_subdoms = 0;
+    for (auto child_vx : children(parent_vx)) {
+      const auto & child = _domains.at(_graph[child_vx].domain_tag);
+      if (child.scope   == scope_pos.scope &&
+          child.g_index == scope_pos.index) {
+        sub_vx = child_vx;
+      }
+      ++num_subdoms;
+    }
+    if (sub_vx == boost::graph_traits<graph_t>::null_vertex()) {
+      const auto & parent = _domains.at(_graph[parent_vx].domain_tag);
+      locality_domain subdomain(parent, scope_pos.scope, num_subdoms);
+      subdomain.g_index   = scope_pos.index;
+      subdomain.num_cores = 0;
+      DYLOC_LOG_DEBUG("dylocxx::topology.move_unit_domain",
+                      "add domain:", subdomain);
+      sub_vx = boost::add_vertex(
+                 { subdomain.domain_tag, vertex_state::unspecified },
+                 _graph);
+      boost::add_edge(parent_vx, sub_vx,
+                      { edge_type::contains, parent.level },
+                      _graph);
+      _domain_vertices[subdomain.domain_tag] = sub_vx;
+      std::string subdomain_tag = subdomain.domain_tag;
+      _domains.insert(std::make_pair(std::move(subdomain_tag),
+                                     std::move(subdomain)));
+      index_domain(sub_vx);
+    }
+    parent_vx = sub_vx;
+  }
+  if (parent_vx == old_parent_vx) {
+    return;
+  }
+  DYLOC_LOG_DEBUG("dylocxx::topology.move_unit_domain",
+                  "unit:", unit_id.id,
+                  "from:", _graph[old_parent_vx].domain_tag,
+                  "to:",   _graph[parent_vx].domain_tag);
+
+  const int parent_level = _domains.at(_graph[parent_vx].domain_tag).level;
+  boost::remove_edge(old_parent_vx, unit_vx, _graph);
+  boost::add_edge(parent_vx, unit_vx,
+                  { edge_type::contains, parent_level },
+                  _graph);
+  // The unit's new CORE domain is not necessarily at the depth of its
+  // previous CORE domain:
+  auto & unit_domain = _domains.at(_graph[unit_vx].domain_tag);
+  if (unit_domain.level != parent_level + 1) {
+    unindex_domain(unit_vx);
+    unit_domain.level = parent_level + 1;
+    index_domain(unit_vx);
+  }
+
+  // Remove the topmost former ancestor below the module left without
+  // units:
+  auto empty_vx = boost::graph_traits<graph_t>::null_vertex();
+  for (auto vx = old_parent_vx; vx != module_vx;
+       vx = *ancestors(vx).begin()) {
+    auto sub_vxs = children(vx);
+    if (std::distance(sub_vxs.begin(), sub_vxs.end()) >
+          (empty_vx == boost::graph_traits<graph_t>::null_vertex() ? 0 : 1)) {
+      break;
+    }
+    empty_vx = vx;
+  }
+  if (empty_vx != boost::graph_traits<graph_t>::null_vertex()) {
+    remove_subtree(empty_vx);
+  }
+
+  update_domain_attributes(_graph[module_vx].domain_tag);
+  update_domain_capacities(_graph[module_vx].domain_tag);
+  for (auto ancestor_vx : ancestors(module_vx)) {
+    accumulate_domain_capacities(ancestor_vx);
+  }
+}
+
 std::vector<std::string>
 topology::scope_domain_tags(
   dyloc_locality_scope_t scope) const {
-  std::vector<graph_vertex_t> vx_matches;
-  const auto vx_range = vertices(_graph);
-  std::for_each(
-    vx_range.first, vx_range.second,
-    [&](const graph_vertex_t & vx) {
-      if (_domains.at(_graph[vx].domain_tag).scope == scope) {
-        vx_matches.push_back(vx);
-      }
-    });
+  const auto & vx_matches = scope_domains(scope);
 
   DYLOC_LOG_DEBUG("dylocxx::topology.scope_domain_tags",
                   "num. domains matched:", vx_matches.size());
@@ -211,10 +720,124 @@ topology::scope_domain_tags(
     [&](const graph_vertex_t & vx) {
       return _graph[vx].domain_tag;
     });
+
+  // Domains in unexpanded symmetric instances, derived from the domains
+  // in their template subtree:
+  for (const auto & instance : _symmetric_instances) {
+    if (instance.expanded) { continue; }
+    const auto & template_tag = _graph[instance.template_vertex].domain_tag;
+    const auto & node_tag     = _graph[instance.node_vertex].domain_tag;
+    std::vector<graph_vertex_t> template_vxs(1, instance.template_vertex);
+    while (!template_vxs.empty()) {
+      auto vx = template_vxs.back();
+      template_vxs.pop_back();
+      for (auto domain_edges = out_edges(vx, _graph);
+           domain_edges.first != domain_edges.second;
+           ++domain_edges.first) {
+        auto sub_vx     = target(*domain_edges.first, _graph);
+        auto domain_it  = _domains.find(_graph[sub_vx].domain_tag);
+        if (_graph[*domain_edges.first].type != edge_type::contains ||
+            domain_it == _domains.end()) {
+          continue;
+        }
+        if (domain_it->second.scope == scope) {
+          scope_dom_tags.push_back(
+            node_tag + domain_it->first.substr(template_tag.size()));
+        }
+        template_vxs.push_back(sub_vx);
+      }
+    }
+  }
   return scope_dom_tags;
 }
 
 
+namespace {
+
+const std::vector<topology::graph_vertex_t> & no_domain_vertices() {
+  static const std::vector<topology::graph_vertex_t> no_vertices;
+  return no_vertices;
+}
+
+void index_insert(
+  std::vector<topology::graph_vertex_t> & index,
+  topology::graph_vertex_t                vx) {
+  auto vx_it = std::lower_bound(index.begin(), index.end(), vx);
+  if (vx_it == index.end() || *vx_it != vx) {
+    index.insert(vx_it, vx);
+  }
+}
+
+void index_erase(
+  std::vector<topology::graph_vertex_t> & index,
+  topology::graph_vertex_t                vx) {
+  auto vx_it = std::lower_bound(index.begin(), index.end(), vx);
+  if (vx_it != index.end() && *vx_it == vx) {
+    index.erase(vx_it);
+  }
+}
+
+} // namespace
+
+const std::vector<topology::graph_vertex_t> &
+topology::scope_domains(
+  dyloc_locality_scope_t scope) const {
+  auto index_it = _scope_index.find(scope);
+  return (index_it == _scope_index.end())
+         ? no_domain_vertices()
+         : index_it->second;
+}
+
+const std::vector<topology::graph_vertex_t> &
+topology::host_domains(
+  int host_id) const {
+  return (host_id < 0 || host_id >= static_cast<int>(_host_index.size()))
+         ? no_domain_vertices()
+         : _host_index[host_id];
+}
+
+const std::vector<topology::graph_vertex_t> &
+topology::level_domains(
+  int level) const {
+  return (level < 0 || level >= static_cast<int>(_level_index.size()))
+         ? no_domain_vertices()
+         : _level_index[level];
+}
+
+void topology::index_domain(graph_vertex_t vx) {
+  const auto & domain = _domains.at(_graph[vx].domain_tag);
+  index_insert(_scope_index[domain.scope], vx);
+  if (domain.host_id >= 0) {
+    if (static_cast<int>(_host_index.size()) <= domain.host_id) {
+      _host_index.resize(domain.host_id + 1);
+    }
+    index_insert(_host_index[domain.host_id], vx);
+  }
+  if (domain.level >= 0) {
+    if (static_cast<int>(_level_index.size()) <= domain.level) {
+      _level_index.resize(domain.level + 1);
+    }
+    index_insert(_level_index[domain.level], vx);
+  }
+}
+
+void topology::unindex_domain(graph_vertex_t vx) {
+  auto domain_it = _domains.find(_graph[vx].domain_tag);
+  if (domain_it == _domains.end()) {
+    return;
+  }
+  const auto & domain = domain_it->second;
+  index_erase(_scope_index[domain.scope], vx);
+  if (domain.host_id >= 0 &&
+      domain.host_id < static_cast<int>(_host_index.size())) {
+    index_erase(_host_index[domain.host_id], vx);
+  }
+  if (domain.level >= 0 &&
+      domain.level < static_cast<int>(_level_index.size())) {
+    index_erase(_level_index[domain.level], vx);
+  }
+}
+
 void topology::build_hierarchy(
        dart_team_t           team,
        const host_topology & host_topo) {
@@ -222,6 +845,12 @@ void topology::build_hierarchy(
 
   locality_domain root_domain(team);
 
+  // Units of the root domain are the units in the unit mapping, in order
+  // of their team-relative id:
+  root_domain.unit_ids.clear();
+  for (const auto & uloc : *_unit_mapping) {
+    root_domain.unit_ids.push_back(dyloc::l2g(team, uloc.data()->unit));
+  }
   root_domain.scope     = DYLOC_LOCALITY_SCOPE_GLOBAL;
   root_domain.level     = 0;
   root_domain.g_index   = 0;
@@ -235,23 +864,124 @@ void topology::build_hierarchy(
              { ".", vertex_state::unspecified },
              _graph);
   _domain_vertices[root_domain.domain_tag] = root_domain_vertex;
+  index_domain(root_domain_vertex);
+
+  // Team-relative ids of units by global unit id, resolved in advance as
+  // node subtrees are built concurrently.
+  // Units of the root domain are in order of their team-relative id:
+  std::vector<dart_team_unit_t> unit_lids;
+  for (size_t luid = 0; luid < root_domain.unit_ids.size(); ++luid) {
+    size_t guid = root_domain.unit_ids[luid].id;
+    if (unit_lids.size() <= guid) {
+      unit_lids.resize(guid + 1);
+    }
+    unit_lids[guid].id = luid;
+  }
 
-  int node_index = 0;
-  for (auto & node_host_domain : host_topo.nodes()) {
-    const auto & node_hostname = node_host_domain.first;
+  // Order nodes by their position in the network, nodes not connected
+  // to any switch last, ordered by host name:
+  const auto & network_topo = host_topo.network();
+  std::vector<int> node_host_ids = host_topo.nodes();
+  if (!network_topo.empty()) {
+    // Unsigned ranks, -1 for nodes not connected to any switch is max.:
+    std::vector<unsigned> node_ranks(host_topo.num_hosts());
+    for (int node_host_id : node_host_ids) {
+      node_ranks[node_host_id] = network_topo.node_rank(
+                                   host_topo.host_name(node_host_id));
+    }
+    // Stable sort retains order by host name:
+    std::stable_sort(node_host_ids.begin(),
+                     node_host_ids.end(),
+                     [&](int a, int b) {
+                       return node_ranks[a] < node_ranks[b];
+                     });
+  }
+
+  // Maps switch index to vertex of its NETWORK domain:
+  std::unordered_map<int, graph_vertex_t> switch_vertices;
+
+  std::vector<domain_subtree> node_subtrees(node_host_ids.size());
+  std::vector<graph_vertex_t> node_vertices;
+  node_vertices.reserve(node_host_ids.size());
+
+  // Nodes with identical configuration of hosts and units have identical
+  // subtrees, only the first node of every configuration is built if
+  // symmetric nodes are compressed:
+  std::vector<node_layout> node_layouts;
+  std::vector<int>         node_templates(node_host_ids.size(), -1);
+  if (compress_symmetric_nodes()) {
+    std::unordered_map<std::string, int> shape_nodes;
+    for (size_t n = 0; n < node_host_ids.size(); ++n) {
+      node_layouts.push_back(build_node_layout(host_topo, node_host_ids[n]));
+      auto shape_node = shape_nodes.insert(
+                          std::make_pair(
+                            node_shape(host_topo, unit_lids, node_layouts[n]),
+                            static_cast<int>(n)));
+      if (!shape_node.second) {
+        node_templates[n] = shape_node.first->second;
+      }
+    }
+    DYLOC_LOG_DEBUG("dylocxx::topology.build_hierarchy",
+                    "distinct node configurations:", shape_nodes.size());
+  }
+
+  for (size_t n = 0; n < node_host_ids.size(); ++n) {
+    int          node_host_id  = node_host_ids[n];
+    const auto & node_hostname = host_topo.host_name(node_host_id);
     DYLOC_LOG_DEBUG("dylocxx::topology.build_hierarchy",
                     "node host:", node_hostname);
 
+    // Add NETWORK domains on the path to the node's leaf switch:
+    std::vector<graph_vertex_t> network_vertices;
+    graph_vertex_t              node_parent_vertex = root_domain_vertex;
+    for (int switch_id : network_topo.switch_path(node_hostname)) {
+      auto switch_vx_it = switch_vertices.find(switch_id);
+      if (switch_vx_it == switch_vertices.end()) {
+        locality_domain network_domain(
+            _domains[_graph[node_parent_vertex].domain_tag],
+            DYLOC_LOCALITY_SCOPE_NETWORK,
+            subdomain_arity(node_parent_vertex));
+        network_domain.g_index   = switch_id;
+        network_domain.num_cores = 0;
+
+        DYLOC_LOG_DEBUG("dylocxx::topology.build_hierarchy",
+                        "add domain:", network_domain,
+                        "switch:",     network_topo.at(switch_id).name);
+
+        _domains.insert(
+            std::make_pair(
+              network_domain.domain_tag,
+              network_domain));
+
+        auto network_domain_vertex
+               = boost::add_vertex(
+                   { network_domain.domain_tag,
+                     vertex_state::unspecified },
+                   _graph);
+        _domain_vertices[network_domain.domain_tag] = network_domain_vertex;
+        index_domain(network_domain_vertex);
+
+        boost::add_edge(node_parent_vertex, network_domain_vertex,
+                        { edge_type::contains, network_domain.level },
+                        _graph);
+
+        switch_vx_it = switch_vertices.insert(
+                         std::make_pair(switch_id, network_domain_vertex))
+                         .first;
+      }
+      node_parent_vertex = switch_vx_it->second;
+      network_vertices.push_back(node_parent_vertex);
+    }
+
     locality_domain node_domain(
-        root_domain,
+        _domains[_graph[node_parent_vertex].domain_tag],
         DYLOC_LOCALITY_SCOPE_NODE,
-        node_index);
-    ++node_index;
+        subdomain_arity(node_parent_vertex));
 
     node_domain.host      = node_hostname;
-    node_domain.unit_ids  = host_topo.unit_ids(node_hostname);
-    node_domain.num_cores = host_topo.nodes().at(node_domain.host)
-                                             .get().num_cores;
+    node_domain.host_id   = node_host_id;
+    node_domain.unit_ids  = host_topo.unit_ids(node_host_id);
+    node_domain.num_cores = host_topo.host_domain(node_host_id).num_cores;
 
     DYLOC_LOG_DEBUG("dylocxx::topology.build_hierarchy",
                     "add domain:", node_domain,
@@ -268,87 +998,583 @@ void topology::build_hierarchy(
                  vertex_state::unspecified },
                _graph);
     _domain_vertices[node_domain.domain_tag] = node_domain_vertex;
+    node_vertices.push_back(node_domain_vertex);
+    index_domain(node_domain_vertex);
 
-    boost::add_edge(root_domain_vertex, node_domain_vertex,
+    boost::add_edge(node_parent_vertex, node_domain_vertex,
                     { edge_type::contains, node_domain.level },
                     _graph);
 
-    build_node_level(
-      host_topo,
-      _domains[node_domain.domain_tag],
-      node_domain_vertex);
+    _domains[root_domain.domain_tag].num_cores += node_domain.num_cores;
 
-    _domains[root_domain.domain_tag].num_cores +=
-      _domains[node_domain.domain_tag].num_cores;
+    for (auto network_vertex : network_vertices) {
+      auto & network_domain = _domains[_graph[network_vertex].domain_tag];
+      network_domain.num_cores += node_domain.num_cores;
+      network_domain.unit_ids.insert(network_domain.unit_ids.end(),
+                                     node_domain.unit_ids.begin(),
+                                     node_domain.unit_ids.end());
+    }
+
+    node_subtrees[n].add(-1, std::move(node_domain), 0);
+  }
+
+  for (auto & switch_vertex : switch_vertices) {
+    auto & network_domain = _domains[_graph[switch_vertex.second].domain_tag];
+    std::sort(network_domain.unit_ids.begin(),
+              network_domain.unit_ids.end(),
+              [](dart_global_unit_t a,
+                 dart_global_unit_t b) { return a.id < b.id; });
+  }
+
+  // Build node subtrees on a pool of worker threads, the calling thread
+  // participates as worker:
+  const auto & my_hwinfo   = (*_unit_mapping)[dyloc::myid(team)]
+                               .data()->hwinfo;
+  int num_local_units      = host_topo.unit_ids(
+                               host_topo.host_id(my_hwinfo.host)).size();
+  int num_threads          = std::min<int>(
+                               num_build_threads(num_local_units),
+                               node_subtrees.size());
+  DYLOC_LOG_DEBUG("dylocxx::topology.build_hierarchy",
+                  "nodes:",   node_subtrees.size(),
+                  "threads:", num_threads);
+
+  std::atomic<size_t> next_node(0);
+  std::exception_ptr  build_error;
+  std::mutex          build_error_mutex;
+  auto build_worker = [&]() {
+      try {
+        for (size_t n = next_node++; n < node_subtrees.size();
+             n = next_node++) {
+          if (node_templates[n] < 0) {
+            build_node_level(host_topo, unit_lids, node_subtrees[n]);
+          }
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(build_error_mutex);
+        build_error = std::current_exception();
+        // Skip remaining nodes:
+        next_node = node_subtrees.size();
+      }
+    };
+  std::vector<std::thread> build_threads;
+  for (int t = 1; t < num_threads; ++t) {
+    build_threads.push_back(std::thread(build_worker));
+  }
+  build_worker();
+  for (auto & build_thread : build_threads) {
+    build_thread.join();
+  }
+  if (build_error) {
+    std::rethrow_exception(build_error);
+  }
+
+  for (size_t n = 0; n < node_subtrees.size(); ++n) {
+    if (node_templates[n] < 0) {
+      merge_subtree(std::move(node_subtrees[n]), node_vertices[n]);
+      continue;
+    }
+    auto template_vertex = node_vertices[node_templates[n]];
+    if (_symmetry_templates.count(template_vertex) == 0) {
+      auto & template_layout = _symmetry_templates[template_vertex];
+      template_layout = node_layouts[node_templates[n]];
+      for (size_t u = 0; u < template_layout.unit_ids.size(); ++u) {
+        template_layout.unit_positions[template_layout.unit_ids[u].id] = u;
+      }
+    }
+    int instance_idx = _symmetric_instances.size();
+    symmetric_instance instance;
+    instance.node_vertex     = node_vertices[n];
+    instance.template_vertex = template_vertex;
+    instance.layout          = std::move(node_layouts[n]);
+    for (size_t u = 0; u < instance.layout.unit_ids.size(); ++u) {
+      _instance_units[instance.layout.unit_ids[u].id]
+        = std::make_pair(instance_idx, static_cast<int>(u));
+    }
+    _instance_nodes[_graph[node_vertices[n]].domain_tag] = instance_idx;
+    _symmetric_instances.push_back(std::move(instance));
+  }
+
+  build_numa_adjacency(host_topo);
+}
+
+int topology::domain_subtree::add(
+  int               parent_idx,
+  locality_domain && domain,
+  int               distance) {
+  int domain_idx = domains.size();
+  domains.push_back(std::move(domain));
+  parents.push_back(parent_idx);
+  distances.push_back(distance);
+  arities.push_back(0);
+  if (parent_idx >= 0) {
+    ++arities[parent_idx];
+  }
+  return domain_idx;
+}
+
+std::vector<topology::graph_vertex_t> topology::merge_subtree(
+  domain_subtree && node_subtree,
+  graph_vertex_t    node_domain_vertex) {
+  std::vector<graph_vertex_t> subtree_vertices(node_subtree.domains.size());
+  subtree_vertices[0] = node_domain_vertex;
+  for (size_t sd = 1; sd < node_subtree.domains.size(); ++sd) {
+    auto & subdomain = node_subtree.domains[sd];
+
+    auto subdomain_vertex
+           = boost::add_vertex(
+               { subdomain.domain_tag,
+                 vertex_state::unspecified },
+               _graph);
+    _domain_vertices[subdomain.domain_tag] = subdomain_vertex;
+    subtree_vertices[sd]                   = subdomain_vertex;
+
+    if (subdomain.scope == DYLOC_LOCALITY_SCOPE_UNIT) {
+      _unit_vertices[subdomain.g_index] = subdomain_vertex;
+    }
+
+    boost::add_edge(subtree_vertices[node_subtree.parents[sd]],
+                    subdomain_vertex,
+                    { edge_type::contains, node_subtree.distances[sd] },
+                    _graph);
+
+    DYLOC_LOG_DEBUG("dylocxx::topology.merge_subtree",
+                    "add domain:", subdomain);
+
+    std::string subdomain_tag = subdomain.domain_tag;
+    _domains.insert(
+        std::make_pair(
+          std::move(subdomain_tag),
+          std::move(subdomain)));
+    index_domain(subdomain_vertex);
+  }
+  return subtree_vertices;
+}
+
+topology::node_layout topology::build_node_layout(
+  const host_topology & host_topo,
+  int                   node_host_id) const {
+  node_layout layout;
+  layout.host_ids.push_back(node_host_id);
+  for (int module_host_id : host_topo.node_modules(node_host_id)) {
+    layout.host_ids.push_back(module_host_id);
+  }
+  for (int host_id : layout.host_ids) {
+    layout.hosts.push_back(host_topo.host_name(host_id));
+    const auto & host_unit_ids = host_topo.unit_ids(host_id);
+    layout.unit_ids.insert(layout.unit_ids.end(),
+                           host_unit_ids.begin(), host_unit_ids.end());
+  }
+  return layout;
+}
+
+std::string topology::node_shape(
+  const host_topology                 & host_topo,
+  const std::vector<dart_team_unit_t> & unit_lids,
+  const node_layout                   & layout) const {
+  // Properties of hosts and units used in build_node_level and
+  // build_module_level:
+  std::string shape;
+  for (int host_id : layout.host_ids) {
+    const auto & host_unit_ids = host_topo.unit_ids(host_id);
+    shape += std::to_string(host_topo.host_domain(host_id).num_cores) + "/" +
+             std::to_string(host_unit_ids.size()) + "{";
+    for (auto unit_gid : host_unit_ids) {
+      const auto & unit_hwinfo = (*_unit_mapping)[unit_lids[unit_gid.id]]
+                                   .data()->hwinfo;
+      for (int s = 0; s < unit_hwinfo.num_scopes; ++s) {
+        shape += std::to_string(unit_hwinfo.scopes[s].scope) + ":" +
+                 std::to_string(unit_hwinfo.scopes[s].index) + ",";
+      }
+      shape += ";";
+    }
+    shape += "}";
+  }
+  return shape;
+}
+
+int topology::symmetric_instance_of(
+  const std::string & domain_tag,
+  std::string       * template_tag) const {
+  if (!is_compressed()) {
+    return -1;
+  }
+  // Node domain tags are prefixes of the tags of their subdomains:
+  for (auto sep_pos = domain_tag.find('.', 1);
+       sep_pos != std::string::npos;
+       sep_pos = domain_tag.find('.', sep_pos + 1)) {
+    auto instance_it = _instance_nodes.find(domain_tag.substr(0, sep_pos));
+    if (instance_it == _instance_nodes.end()) {
+      continue;
+    }
+    if (template_tag != nullptr) {
+      const auto & instance = _symmetric_instances[instance_it->second];
+      *template_tag = _graph[instance.template_vertex].domain_tag +
+                      domain_tag.substr(sep_pos);
+    }
+    return instance_it->second;
+  }
+  return -1;
+}
+
+locality_domain topology::instance_domain(
+  const symmetric_instance & instance,
+  const locality_domain    & template_domain) const {
+  const auto & template_layout = _symmetry_templates.at(
+                                   instance.template_vertex);
+  const auto & template_tag    = _graph[instance.template_vertex].domain_tag;
+
+  locality_domain domain = template_domain;
+  domain.domain_tag = _graph[instance.node_vertex].domain_tag +
+                      template_domain.domain_tag.substr(template_tag.size());
+  for (size_t h = 0; h < template_layout.host_ids.size(); ++h) {
+    if (template_layout.host_ids[h] == template_domain.host_id) {
+      domain.host    = instance.layout.hosts[h];
+      domain.host_id = instance.layout.host_ids[h];
+      break;
+    }
+  }
+  for (auto & unit_id : domain.unit_ids) {
+    unit_id = instance.layout.unit_ids[
+                template_layout.unit_positions.at(unit_id.id)];
+  }
+  if (domain.scope == DYLOC_LOCALITY_SCOPE_UNIT && !domain.unit_ids.empty()) {
+    domain.g_index = domain.unit_ids[0].id;
+  }
+  return domain;
+}
+
+locality_domain & topology::accessed_instance_domain(
+  const std::string & domain_tag) {
+  auto domain_it = _instance_domains.find(domain_tag);
+  if (domain_it == _instance_domains.end()) {
+    domain_it = _instance_domains.insert(
+                  std::make_pair(domain_tag, domain(domain_tag))).first;
+  }
+  return domain_it->second;
+}
+
+void topology::expand_instance(int instance_idx) {
+  auto & instance = _symmetric_instances[instance_idx];
+  if (instance.expanded) {
+    return;
+  }
+  // Copy, vertex properties are reallocated when the subtree is merged:
+  const auto node_tag = _graph[instance.node_vertex].domain_tag;
+  DYLOC_LOG_DEBUG("dylocxx::topology.expand_instance",
+                  "node:", node_tag,
+                  "template:", _graph[instance.template_vertex].domain_tag);
+
+  // Derive subtree from template subtree in pre-order:
+  domain_subtree              subtree;
+  std::vector<graph_vertex_t> template_vertices;
+  subtree.add(-1, locality_domain(_domains.at(node_tag)), 0);
+  template_vertices.push_back(instance.template_vertex);
+  std::function<void(graph_vertex_t, int)> add_subdomains =
+    [&](graph_vertex_t template_vx, int parent_idx) {
+      for (auto domain_edges = out_edges(template_vx, _graph);
+           domain_edges.first != domain_edges.second;
+           ++domain_edges.first) {
+        auto sub_vx    = target(*domain_edges.first, _graph);
+        auto domain_it = _domains.find(_graph[sub_vx].domain_tag);
+        if (_graph[*domain_edges.first].type != edge_type::contains ||
+            domain_it == _domains.end()) {
+          continue;
+        }
+        auto sub_domain  = instance_domain(instance, domain_it->second);
+        auto accessed_it = _instance_domains.find(sub_domain.domain_tag);
+        if (accessed_it != _instance_domains.end()) {
+          // Retain changes to the domain made via operator[]:
+          sub_domain = std::move(accessed_it->second);
+          _instance_domains.erase(accessed_it);
+        }
+        int sub_idx = subtree.add(
+                        parent_idx,
+                        std::move(sub_domain),
+                        _graph[*domain_edges.first].distance);
+        template_vertices.push_back(sub_vx);
+        add_subdomains(sub_vx, sub_idx);
+      }
+    };
+  add_subdomains(instance.template_vertex, 0);
+
+  auto subtree_vertices = merge_subtree(std::move(subtree),
+                                        instance.node_vertex);
+
+  // Relations between domains in the template subtree, like adjacency of
+  // NUMA domains:
+  std::unordered_map<graph_vertex_t, graph_vertex_t> instance_vertices;
+  for (size_t sd = 0; sd < template_vertices.size(); ++sd) {
+    instance_vertices[template_vertices[sd]] = subtree_vertices[sd];
+  }
+  for (auto template_vx : template_vertices) {
+    for (auto domain_edges = out_edges(template_vx, _graph);
+         domain_edges.first != domain_edges.second;
+         ++domain_edges.first) {
+      auto target_vx_it = instance_vertices.find(
+                            target(*domain_edges.first, _graph));
+      if (_graph[*domain_edges.first].type == edge_type::contains ||
+          target_vx_it == instance_vertices.end()) {
+        continue;
+      }
+      boost::add_edge(instance_vertices[template_vx], target_vx_it->second,
+                      _graph[*domain_edges.first], _graph);
+    }
+  }
+
+  _instance_nodes.erase(node_tag);
+  for (auto unit_id : instance.layout.unit_ids) {
+    _instance_units.erase(unit_id.id);
+  }
+  instance.layout   = node_layout();
+  instance.expanded = true;
+  if (_instance_nodes.empty()) {
+    _symmetric_instances.clear();
+    _symmetry_templates.clear();
+    _instance_domains.clear();
+  }
+}
+
+void topology::expand() {
+  DYLOC_LOG_DEBUG("dylocxx::topology.expand",
+                  "instances:", _instance_nodes.size());
+  for (size_t i = 0; i < _symmetric_instances.size(); ++i) {
+    expand_instance(i);
+  }
+}
+
+size_t topology::compact() {
+  const auto null_vx = boost::graph_traits<graph_t>::null_vertex();
+  const size_t num_vxs = num_vertices(_graph);
+
+  // Vertices are copied in order of their descriptors, so remapped
+  // indices remain sorted and subdomains keep their order:
+  std::vector<graph_vertex_t> vx_map(num_vxs, null_vx);
+  graph_t                     compact_graph;
+  for (size_t vx = 0; vx < num_vxs; ++vx) {
+    if (_graph[vx].state != vertex_state::hidden &&
+        _domains.count(_graph[vx].domain_tag) > 0) {
+      vx_map[vx] = boost::add_vertex(_graph[vx], compact_graph);
+    }
+  }
+  const size_t num_removed = num_vxs - num_vertices(compact_graph);
+  DYLOC_LOG_DEBUG("dylocxx::topology.compact",
+                  "vertices:", num_vxs, "removed:", num_removed);
+  if (num_removed == 0) {
+    return 0;
+  }
+  for (size_t vx = 0; vx < num_vxs; ++vx) {
+    if (vx_map[vx] == null_vx) {
+      continue;
+    }
+    for (auto out_edge_range = out_edges(vx, _graph);
+         out_edge_range.first != out_edge_range.second;
+         ++out_edge_range.first) {
+      auto target_vx = vx_map[target(*out_edge_range.first, _graph)];
+      if (target_vx != null_vx) {
+        boost::add_edge(vx_map[vx], target_vx,
+                        _graph[*out_edge_range.first], compact_graph);
+      }
+    }
+  }
+  _graph.swap(compact_graph);
+
+  auto remap_vertices = [&](std::unordered_map<std::string,
+                                               graph_vertex_t> & vx_index) {
+      for (auto it = vx_index.begin(); it != vx_index.end(); ) {
+        if (vx_map[it->second] == null_vx) {
+          it = vx_index.erase(it);
+        } else {
+          it->second = vx_map[it->second];
+          ++it;
+        }
+      }
+    };
+  auto remap_index = [&](std::vector<graph_vertex_t> & vx_index) {
+      vx_index.erase(
+        std::remove_if(vx_index.begin(), vx_index.end(),
+                       [&](graph_vertex_t vx) {
+                         return vx_map[vx] == null_vx;
+                       }),
+        vx_index.end());
+      for (auto & vx : vx_index) {
+        vx = vx_map[vx];
+      }
+    };
+
+  remap_vertices(_domain_vertices);
+  for (auto it = _unit_vertices.begin(); it != _unit_vertices.end(); ) {
+    if (vx_map[it->second] == null_vx) {
+      it = _unit_vertices.erase(it);
+    } else {
+      it->second = vx_map[it->second];
+      ++it;
+    }
+  }
+  std::unordered_map<graph_vertex_t, node_layout> symmetry_templates;
+  for (auto & node_template : _symmetry_templates) {
+    if (vx_map[node_template.first] != null_vx) {
+      symmetry_templates[vx_map[node_template.first]] =
+        std::move(node_template.second);
+    }
+  }
+  _symmetry_templates.swap(symmetry_templates);
+  for (auto & instance : _symmetric_instances) {
+    instance.node_vertex     = vx_map[instance.node_vertex];
+    instance.template_vertex = vx_map[instance.template_vertex];
+  }
+  for (auto & scope_vxs : _scope_index) {
+    remap_index(scope_vxs.second);
+  }
+  for (auto & host_vxs : _host_index) {
+    remap_index(host_vxs);
+  }
+  for (auto & level_vxs : _level_index) {
+    remap_index(level_vxs);
+  }
+  return num_removed;
+}
+
+void topology::collect_garbage() {
+  const double gc_ratio = garbage_ratio();
+  const size_t num_vxs = num_vertices(_graph);
+  if (gc_ratio <= 0 || num_vxs == 0 || num_vxs <= _domains.size()) {
+    return;
+  }
+  if (static_cast<double>(num_vxs - _domains.size()) / num_vxs > gc_ratio) {
+    compact();
+  }
+}
+
+locality_domain topology::domain(const std::string & domain_tag) const {
+  auto domain_it = _domains.find(domain_tag);
+  if (domain_it != _domains.end()) {
+    return domain_it->second;
+  }
+  auto accessed_it = _instance_domains.find(domain_tag);
+  if (accessed_it != _instance_domains.end()) {
+    return accessed_it->second;
+  }
+  std::string template_tag;
+  int instance_idx = symmetric_instance_of(domain_tag, &template_tag);
+  if (instance_idx < 0 || _domains.count(template_tag) == 0) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "no domain with tag " << domain_tag);
+  }
+  const auto & instance = _symmetric_instances[instance_idx];
+  return instance_domain(instance, _domains.at(template_tag));
+}
+
+std::string topology::unit_domain_tag(dart_global_unit_t unit_id) const {
+  auto unit_vx_it = _unit_vertices.find(unit_id.id);
+  if (unit_vx_it != _unit_vertices.end()) {
+    return _graph[unit_vx_it->second].domain_tag;
+  }
+  auto instance_unit_it = _instance_units.find(unit_id.id);
+  if (instance_unit_it == _instance_units.end()) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "no domain of unit " << unit_id.id);
+  }
+  const auto & instance        = _symmetric_instances[
+                                   instance_unit_it->second.first];
+  const auto & template_layout = _symmetry_templates.at(
+                                   instance.template_vertex);
+  const auto & template_tag    = _graph[instance.template_vertex].domain_tag;
+  auto template_unit_id        = template_layout.unit_ids[
+                                   instance_unit_it->second.second];
+  const auto & template_unit_tag
+                               = _graph[_unit_vertices.at(
+                                   template_unit_id.id)].domain_tag;
+  return _graph[instance.node_vertex].domain_tag +
+         template_unit_tag.substr(template_tag.size());
+}
+
+void topology::build_numa_adjacency(
+       const host_topology & host_topo) {
+  // NUMA domains grouped by host id:
+  std::vector<std::vector<graph_vertex_t> > host_numa_vxs(
+                                              host_topo.num_hosts());
+  const auto vx_range = vertices(_graph);
+  for (auto vx_it = vx_range.first; vx_it != vx_range.second; ++vx_it) {
+    const auto & domain = _domains.at(_graph[*vx_it].domain_tag);
+    if (domain.scope == DYLOC_LOCALITY_SCOPE_NUMA && domain.host_id >= 0) {
+      host_numa_vxs[domain.host_id].push_back(*vx_it);
+    }
+  }
+  for (int host_id = 0; host_id < host_topo.num_hosts(); ++host_id) {
+    const auto & numa_vxs = host_numa_vxs[host_id];
+    for (auto numa_vx_a : numa_vxs) {
+      int numa_id_a = _domains.at(_graph[numa_vx_a].domain_tag).g_index;
+      for (auto numa_vx_b : numa_vxs) {
+        int numa_id_b = _domains.at(_graph[numa_vx_b].domain_tag).g_index;
+        if (numa_vx_a == numa_vx_b) {
+          continue;
+        }
+        int numa_dist = host_topo.numa_distance(
+                          host_id, numa_id_a, numa_id_b);
+        if (numa_dist < 0) {
+          continue;
+        }
+        DYLOC_LOG_TRACE("dylocxx::topology.build_numa_adjacency",
+                        "host:", host_topo.host_name(host_id),
+                        "NUMA", numa_id_a, "->", numa_id_b,
+                        "distance:", numa_dist);
+        set_adjacent_edge(numa_vx_a, numa_vx_b, numa_dist);
+      }
+    }
   }
 }
 
 
 void topology::build_node_level(
-       const host_topology & host_topo,
-       locality_domain     & node_domain,
-       graph_vertex_t      & node_domain_vertex) {
-  DYLOC_LOG_DEBUG("dylocxx::topology.build_node_level",
-                  "node:", node_domain.host);
+       const host_topology                 & host_topo,
+       const std::vector<dart_team_unit_t> & unit_lids,
+       domain_subtree                      & node_subtree) const {
+  const auto & node_domain = node_subtree.domains[0];
   // modules located at node:
-  auto & node_modules   = host_topo.node_modules(node_domain.host);
+  auto & node_modules   = host_topo.node_modules(node_domain.host_id);
 
   build_module_level(
-    host_topo,
-    node_domain,
-    node_domain_vertex,
+    unit_lids,
+    node_subtree,
+    0,
     0);
 
-  for (auto & node_module : node_modules) {
-    const auto & module_hostname   = node_module.get().host;
-    auto         node_domain_arity = out_degree(node_domain_vertex, _graph);
-    DYLOC_LOG_DEBUG("dylocxx::topology.build_node_level",
-                    "node domain arity:", node_domain_arity,
-                    "module host name:",  module_hostname);
+  for (int module_host_id : node_modules) {
+    const auto & module_hostname   = host_topo.host_name(module_host_id);
+    auto         node_domain_arity = node_subtree.arities[0];
 
     locality_domain module_domain(
         node_domain,
         DYLOC_LOCALITY_SCOPE_MODULE,
         node_domain_arity);
 
-    module_domain.unit_ids  = host_topo.unit_ids(module_hostname);
+    module_domain.unit_ids  = host_topo.unit_ids(module_host_id);
     module_domain.host      = module_hostname;
-    module_domain.num_cores = node_module.get().num_cores /
+    module_domain.host_id   = module_host_id;
+    module_domain.num_cores = host_topo.host_domain(module_host_id).num_cores /
                               node_modules.size();
 
-    DYLOC_LOG_DEBUG("dylocxx::topology.build_node_level",
-                    "add domain:", module_domain);
-
-    _domains.insert(
-        std::make_pair(
-          module_domain.domain_tag,
-          module_domain));
-
-    auto module_domain_vertex 
-           = boost::add_vertex(
-               { module_domain.domain_tag,
-                 vertex_state::unspecified },
-               _graph);
-    _domain_vertices[module_domain.domain_tag] = module_domain_vertex;
-
-    boost::add_edge(node_domain_vertex, module_domain_vertex,
-                    { edge_type::contains, module_domain.level },
-                    _graph);
+    int module_level      = module_domain.level;
+    int module_domain_idx = node_subtree.add(
+                              0, std::move(module_domain), module_level);
 
     build_module_level(
-      host_topo,
-      _domains[module_domain.domain_tag],
-      module_domain_vertex,
+      unit_lids,
+      node_subtree,
+      module_domain_idx,
       0);
   }
 }
 
 
 void topology::build_module_level(
-       const host_topology & host_topo,
-       locality_domain     & module_domain,
-       graph_vertex_t      & module_domain_vertex,
-       int                   module_scope_level) {
+       const std::vector<dart_team_unit_t> & unit_lids,
+       domain_subtree                      & node_subtree,
+       int                                   module_domain_idx,
+       int                                   module_scope_level) const {
   /*
    * NOTE: Locality scopes may be heterogeneous but are expected
    *       to be homogeneous within a module domain.
@@ -380,13 +1606,15 @@ void topology::build_module_level(
    *
    * such that subdomains of a domain with global index G are referenced
    * in sub_gids[G].
+   *
+   * Called concurrently for different nodes, must not access the
+   * topology graph or domain tables and must not log as log messages
+   * query the unit id from DART.
    */
+  const auto & module_domain = node_subtree.domains[module_domain_idx];
 
-  dart_team_unit_t module_leader_unit_id;
-  DYLOC_ASSERT_RETURNS(
-    dart_team_unit_g2l(module_domain.team, module_domain.unit_ids[0],
-                       &module_leader_unit_id),
-    DART_OK);
+  dart_team_unit_t module_leader_unit_id =
+                     unit_lids[module_domain.unit_ids[0].id];
 
   const auto & module_leader_unit_loc =
                 *((*_unit_mapping)[module_leader_unit_id].data());
@@ -403,21 +1631,6 @@ void topology::build_module_level(
 
   int subdomain_gid_idx = num_scopes - (module_scope_level + 1);
 
-  DYLOC_LOG_TRACE(
-    "dylocxx::topology.build_module_level", "--",
-    "current scope:", module_scopes[subdomain_gid_idx],
-    "level", subdomain_gid_idx,
-    "in module scopes:",
-    dyloc::make_range(
-      module_scopes.begin(),
-      module_scopes.end()));
-  DYLOC_LOG_TRACE(
-    "dylocxx::topology.build_module_level", "--",
-    "module units:",
-    dyloc::make_range(
-      module_domain.unit_ids.begin(),
-      module_domain.unit_ids.end()));
-
   // Array of the global indices of the current module subdomains.
   // Maximum number of global indices, including duplicates, is number
   // of units:
@@ -426,8 +1639,7 @@ void topology::build_module_level(
   module_subdomain_gids.reserve(module_domain.unit_ids.size());
 
   for (auto module_unit_gid : module_domain.unit_ids) {
-    dart_team_unit_t module_unit_lid
-      = dyloc::g2l(module_domain.team, module_unit_gid);
+    dart_team_unit_t module_unit_lid = unit_lids[module_unit_gid.id];
 
     const auto & module_unit_loc    =
                    *((*_unit_mapping)[module_unit_lid].data());
@@ -453,12 +1665,6 @@ void topology::build_module_level(
   auto num_subdomains            = std::distance(
                                      module_subdomain_gids.begin(),
                                      module_subdomain_gids_end);
-  DYLOC_LOG_TRACE(
-    "dylocxx::topology.build_module_level", "--",
-    "module subdomain gids:",
-    dyloc::make_range(
-      module_subdomain_gids.begin(),
-      module_subdomain_gids_end));
   
   for (int sd = 0; sd < num_subdomains; ++sd) {
     locality_domain module_subdomain(
@@ -466,12 +1672,12 @@ void topology::build_module_level(
         module_scopes[subdomain_gid_idx],
         sd);
     module_subdomain.host      = module_domain.host;
+    module_subdomain.host_id   = module_domain.host_id;
     module_subdomain.g_index   = module_subdomain_gids[sd];
     module_subdomain.num_cores = module_domain.num_cores / num_subdomains;
 
     for (auto module_unit_gid : module_domain.unit_ids) {
-      dart_team_unit_t module_unit_lid
-        = dyloc::g2l(module_domain.team, module_unit_gid);
+      dart_team_unit_t module_unit_lid = unit_lids[module_unit_gid.id];
 
       const auto & module_unit_loc    =
                      *((*_unit_mapping)[module_unit_lid].data());
@@ -482,71 +1688,39 @@ void topology::build_module_level(
       }
     }
 
-    DYLOC_LOG_DEBUG("dylocxx::topology.build_node_level", "--",
-                    "add domain:", module_subdomain);
-
-    _domains.insert(
-        std::make_pair(
-          module_subdomain.domain_tag,
-          module_subdomain));
-
-    auto module_subdomain_vertex 
-           = boost::add_vertex(
-               { module_subdomain.domain_tag,
-                 vertex_state::unspecified },
-               _graph);
-    _domain_vertices[module_subdomain.domain_tag] = module_subdomain_vertex;
-
-    boost::add_edge(module_domain_vertex, module_subdomain_vertex,
-                    { edge_type::contains, module_domain.level },
-                    _graph);
+    int module_subdomain_idx = node_subtree.add(
+                                 module_domain_idx,
+                                 std::move(module_subdomain),
+                                 module_domain.level);
+    const auto & module_subdomain_ref =
+                   node_subtree.domains[module_subdomain_idx];
 
     if (subdomain_gid_idx <= 0) {
-      DYLOC_LOG_DEBUG("dylocxx::topology.build_node_level", "--",
-                      "mapped units:",
-                      dyloc::make_range(
-                        module_subdomain.unit_ids.begin(),
-                        module_subdomain.unit_ids.end()));
       // At unit scope, module subdomain is CORE: add domain for every unit:
-      for (size_t ud = 0; ud < module_subdomain.unit_ids.size(); ++ud) {
-        auto unit_gid = module_subdomain.unit_ids[ud];
+      for (size_t ud = 0; ud < module_subdomain_ref.unit_ids.size(); ++ud) {
+        auto unit_gid = module_subdomain_ref.unit_ids[ud];
         locality_domain unit_domain(
-            module_subdomain,
+            module_subdomain_ref,
             DYLOC_LOCALITY_SCOPE_UNIT,
             ud);
         unit_domain.host      = module_domain.host;
+        unit_domain.host_id   = module_domain.host_id;
         unit_domain.g_index   = unit_gid.id;
 
         unit_domain.unit_ids.push_back(unit_gid);
-        unit_domain.num_cores = module_subdomain.num_cores /
-                                module_subdomain.unit_ids.size();
-
-        // Update unit mapping, set domain tag of unit locality:
-        // auto unit_lid = dyloc::g2l(module_subdomain.team, unit_gid);
-        // std::strcpy((*(*_unit_mapping)[unit_lid].data()).domain_tag,
-        //             unit_domain.domain_tag.c_str());
-
-        _domains[unit_domain.domain_tag] = unit_domain;
-
-        auto unit_domain_vertex 
-               = boost::add_vertex(
-                   { unit_domain.domain_tag,
-                     vertex_state::unspecified },
-                   _graph);
+        unit_domain.num_cores = module_subdomain_ref.num_cores /
+                                module_subdomain_ref.unit_ids.size();
 
-        _domain_vertices[unit_domain.domain_tag] = unit_domain_vertex;
-        _unit_vertices[unit_gid.id]              = unit_domain_vertex;
-
-        boost::add_edge(module_subdomain_vertex, unit_domain_vertex,
-                        { edge_type::contains, unit_domain.level },
-                        _graph);
+        int unit_level = unit_domain.level;
+        node_subtree.add(
+          module_subdomain_idx, std::move(unit_domain), unit_level);
       }
     } else {
       // Recurse down:
       build_module_level(
-        host_topo,
-        _domains[module_subdomain.domain_tag],
-        module_subdomain_vertex,
+        unit_lids,
+        node_subtree,
+        module_subdomain_idx,
         module_scope_level + 1);
     }
   }
@@ -560,5 +1734,467 @@ int topology::subdomain_distance(
              _domains[parent_tag].level ) );
 }
 
+int topology::subdomain_arity(graph_vertex_t domain_vx) const {
+  int arity = 0;
+  for (auto domain_edges = out_edges(domain_vx, _graph);
+       domain_edges.first != domain_edges.second;
+       ++domain_edges.first) {
+    if (_graph[*domain_edges.first].type == edge_type::contains) {
+      ++arity;
+    }
+  }
+  return arity;
+}
+
+std::vector<topology::graph_vertex_t>
+topology::ancestor_path(graph_vertex_t domain_vx) const {
+  std::vector<graph_vertex_t> path;
+  path.push_back(domain_vx);
+  bool has_parent = true;
+  while (has_parent) {
+    has_parent = false;
+    for (auto domain_edges = in_edges(path.back(), _graph);
+         domain_edges.first != domain_edges.second;
+         ++domain_edges.first) {
+      if (_graph[*domain_edges.first].type == edge_type::contains) {
+        path.push_back(source(*domain_edges.first, _graph));
+        has_parent = true;
+        break;
+      }
+    }
+  }
+  return path;
+}
+
+void topology::set_adjacent_distance(
+  graph_vertex_t domain_vx_a,
+  graph_vertex_t domain_vx_b,
+  int            distance) {
+  set_adjacent_edge(domain_vx_a, domain_vx_b, distance);
+  set_adjacent_edge(domain_vx_b, domain_vx_a, distance);
+}
+
+void topology::set_adjacent_edge(
+  graph_vertex_t src_domain_vx,
+  graph_vertex_t dst_domain_vx,
+  int            distance) {
+  for (auto domain_edges = out_edges(src_domain_vx, _graph);
+       domain_edges.first != domain_edges.second;
+       ++domain_edges.first) {
+    if (target(*domain_edges.first, _graph) == dst_domain_vx &&
+        _graph[*domain_edges.first].type == edge_type::adjacent) {
+      _graph[*domain_edges.first].distance = distance;
+      return;
+    }
+  }
+  boost::add_edge(src_domain_vx, dst_domain_vx,
+                  { edge_type::adjacent, distance },
+                  _graph);
+}
+
+int topology::distance(
+  const std::string & domain_tag_a,
+  const std::string & domain_tag_b) const {
+  if (domain_tag_a == domain_tag_b) {
+    return 0;
+  }
+  if (is_compressed()) {
+    // Distances within a symmetric instance are equal to the distances
+    // of the corresponding domains in its template, distances to other
+    // domains are resolved at the instance's node domain:
+    std::string template_tag_a;
+    std::string template_tag_b;
+    int instance_a = symmetric_instance_of(domain_tag_a, &template_tag_a);
+    int instance_b = symmetric_instance_of(domain_tag_b, &template_tag_b);
+    if (instance_a >= 0 || instance_b >= 0) {
+      auto node_tag = [&](int instance_idx) -> const std::string & {
+          return _graph[_symmetric_instances[instance_idx].node_vertex]
+                   .domain_tag;
+        };
+      auto template_node_tag = [&](int instance_idx) -> const std::string & {
+          return _graph[_symmetric_instances[instance_idx].template_vertex]
+                   .domain_tag;
+        };
+      if (instance_a >= 0 && instance_a == instance_b) {
+        return distance(template_tag_a, template_tag_b);
+      }
+      if (instance_a >= 0 && domain_tag_b == node_tag(instance_a)) {
+        return distance(template_tag_a, template_node_tag(instance_a));
+      }
+      if (instance_b >= 0 && domain_tag_a == node_tag(instance_b)) {
+        return distance(template_node_tag(instance_b), template_tag_b);
+      }
+      return distance(instance_a >= 0 ? node_tag(instance_a) : domain_tag_a,
+                      instance_b >= 0 ? node_tag(instance_b) : domain_tag_b);
+    }
+  }
+  auto path_a = ancestor_path(_domain_vertices.at(domain_tag_a));
+  auto path_b = ancestor_path(_domain_vertices.at(domain_tag_b));
+
+  // Remove common ancestors from both paths, such that the paths end at
+  // the children of the lowest common ancestor:
+  graph_vertex_t lca_vx = path_a.back();
+  while (!path_a.empty() && !path_b.empty() &&
+         path_a.back() == path_b.back()) {
+    lca_vx = path_a.back();
+    path_a.pop_back();
+    path_b.pop_back();
+  }
+
+  // Lowest pair of ancestors connected by an adjacent edge:
+  for (auto vx_a : path_a) {
+    for (auto domain_edges = out_edges(vx_a, _graph);
+         domain_edges.first != domain_edges.second;
+         ++domain_edges.first) {
+      if (_graph[*domain_edges.first].type != edge_type::adjacent) {
+        continue;
+      }
+      auto adj_vx = target(*domain_edges.first, _graph);
+      if (std::find(path_b.begin(), path_b.end(), adj_vx) != path_b.end()) {
+        return _graph[*domain_edges.first].distance;
+      }
+    }
+  }
+
+  // Distance of the contains edges at the lowest common ancestor:
+  int lca_distance = 0;
+  for (const auto * path : { &path_a, &path_b }) {
+    if (path->empty()) { continue; }
+    auto lca_edge = boost::edge(lca_vx, path->back(), _graph);
+    if (lca_edge.second) {
+      lca_distance = std::max(lca_distance, _graph[lca_edge.first].distance);
+    }
+  }
+  return lca_distance;
+}
+
+void topology::measure_latencies(int num_rounds) {
+  latency_probe probe(num_rounds);
+  measure_latencies(
+    [&](int cpu_id_a, int cpu_id_b) {
+      return probe.cpu_latency(cpu_id_a, cpu_id_b);
+    });
+}
+
+void topology::measure_latencies(
+  const std::function<int(int, int)> & cpu_latency) {
+  DYLOC_LOG_DEBUG("dylocxx::topology.measure_latencies", "()");
+  if (is_compressed()) { expand(); }
+
+  dart_team_t team = _unit_mapping->team;
+
+  // Sibling subdomains at probed scopes, in order of their parents'
+  // vertices which is identical at all units:
+  struct sibling_group {
+    int                         host_id;
+    graph_vertex_t              parent_vx;
+    std::vector<graph_vertex_t> sibling_vxs;
+  };
+  std::vector<sibling_group>      sibling_groups;
+  // Number of sibling pairs probed at every host:
+  std::unordered_map<int, size_t> host_num_pairs;
+
+  const auto vx_range = vertices(_graph);
+  for (auto vx_it = vx_range.first; vx_it != vx_range.second; ++vx_it) {
+    auto parent_vx = *vx_it;
+    if (_graph[parent_vx].state == vertex_state::hidden) {
+      continue;
+    }
+    sibling_group group;
+    group.parent_vx = parent_vx;
+    group.host_id   = -1;
+    for (auto child_vx : children(parent_vx)) {
+      const auto & child = _domains.at(_graph[child_vx].domain_tag);
+      if (!child.unit_ids.empty() &&
+          (child.scope == DYLOC_LOCALITY_SCOPE_CACHE   ||
+           child.scope == DYLOC_LOCALITY_SCOPE_PACKAGE ||
+           child.scope == DYLOC_LOCALITY_SCOPE_NUMA)) {
+        group.host_id = child.host_id;
+        group.sibling_vxs.push_back(child_vx);
+      }
+    }
+    size_t num_siblings = group.sibling_vxs.size();
+    if (num_siblings < 2) {
+      continue;
+    }
+    host_num_pairs[group.host_id] += num_siblings * (num_siblings - 1) / 2;
+    sibling_groups.push_back(std::move(group));
+  }
+
+  // Probing units that share cores would distort each other's timings,
+  // the first unit at every host probes its host's domains:
+  std::unordered_map<int, dart_global_unit_t> host_leaders;
+  for (const auto & unit_vx : _unit_vertices) {
+    if (_graph[unit_vx.second].state == vertex_state::hidden) {
+      continue;
+    }
+    auto unit_it = _domains.find(_graph[unit_vx.second].domain_tag);
+    if (unit_it == _domains.end()) {
+      continue;
+    }
+    const auto & unit_domain = unit_it->second;
+    auto leader_it = host_leaders.find(unit_domain.host_id);
+    if (leader_it == host_leaders.end()) {
+      host_leaders[unit_domain.host_id] = dart_global_unit_t(unit_vx.first);
+    } else if (unit_vx.first < leader_it->second.id) {
+      leader_it->second.id = unit_vx.first;
+    }
+  }
+  int  my_host_id    = -1;
+  auto my_unit_vx_it = _unit_vertices.find(dyloc::myid().id);
+  if (my_unit_vx_it != _unit_vertices.end() &&
+      _graph[my_unit_vx_it->second].state != vertex_state::hidden) {
+    auto my_unit_it = _domains.find(_graph[my_unit_vx_it->second].domain_tag);
+    if (my_unit_it != _domains.end()) {
+      my_host_id = my_unit_it->second.host_id;
+    }
+  }
+  bool is_leader     = my_host_id >= 0 &&
+                       host_leaders.at(my_host_id) == dyloc::myid();
+
+  // CPU id of the first unit in the domain:
+  auto representative_cpu = [&](graph_vertex_t domain_vx) {
+      const auto & domain   = _domains.at(_graph[domain_vx].domain_tag);
+      auto         unit_lid = dyloc::g2l(domain.team, domain.unit_ids[0]);
+      return (*_unit_mapping)[unit_lid].data()->hwinfo.cpu_id;
+    };
+
+  std::vector<int> local_latencies;
+  if (is_leader) {
+    for (const auto & group : sibling_groups) {
+      if (group.host_id != my_host_id) {
+        continue;
+      }
+      DYLOC_LOG_DEBUG("dylocxx::topology.measure_latencies",
+                      "domain:",   _graph[group.parent_vx].domain_tag,
+                      "siblings:", group.sibling_vxs.size());
+      for (size_t sa = 0; sa < group.sibling_vxs.size(); ++sa) {
+        int cpu_a = representative_cpu(group.sibling_vxs[sa]);
+        for (size_t sb = sa + 1; sb < group.sibling_vxs.size(); ++sb) {
+          int cpu_b = representative_cpu(group.sibling_vxs[sb]);
+          local_latencies.push_back(cpu_latency(cpu_a, cpu_b));
+        }
+      }
+    }
+  }
+
+  // Exchange latencies measured at every host:
+  size_t              num_units = _unit_mapping->size();
+  size_t              send_size = local_latencies.size();
+  std::vector<size_t> recv_sizes(num_units);
+  DYLOC_ASSERT_RETURNS(
+    dart_allgather(&send_size, recv_sizes.data(), 1, DART_TYPE_SIZET, team),
+    DART_OK);
+  std::vector<size_t> recv_displs(num_units, 0);
+  std::partial_sum(recv_sizes.begin(), recv_sizes.end() - 1,
+                   recv_displs.begin() + 1);
+  std::vector<int> latencies(recv_displs.back() + recv_sizes.back());
+  DYLOC_ASSERT_RETURNS(
+    dart_allgatherv(local_latencies.data(), send_size, DART_TYPE_INT,
+                    latencies.data(), recv_sizes.data(), recv_displs.data(),
+                    team),
+    DART_OK);
+
+  // Position of the next latency measured at every host:
+  std::unordered_map<int, size_t> host_offsets;
+  for (const auto & host_pairs : host_num_pairs) {
+    auto leader_lid = dyloc::g2l(team, host_leaders.at(host_pairs.first));
+    if (leader_lid.id < 0 || leader_lid.id >= static_cast<int>(num_units) ||
+        recv_sizes[leader_lid.id] != host_pairs.second) {
+      DYLOC_LOG_WARN("dylocxx::topology.measure_latencies",
+                     "no latencies received for host",
+                     host_pairs.first);
+      continue;
+    }
+    host_offsets[host_pairs.first] = recv_displs[leader_lid.id];
+  }
+
+  for (const auto & group : sibling_groups) {
+    auto host_offset_it = host_offsets.find(group.host_id);
+    if (host_offset_it == host_offsets.end()) {
+      continue;
+    }
+    size_t & offset       = host_offset_it->second;
+    int      num_siblings = group.sibling_vxs.size();
+
+    std::vector<long> latency_sums(num_siblings, 0);
+    std::vector<int>  latency_counts(num_siblings, 0);
+    for (int sa = 0; sa < num_siblings; ++sa) {
+      for (int sb = sa + 1; sb < num_siblings; ++sb) {
+        int latency_ns = latencies[offset++];
+        if (latency_ns < 0) {
+          continue;
+        }
+        set_adjacent_distance(group.sibling_vxs[sa], group.sibling_vxs[sb],
+                              latency_ns);
+        latency_sums[sa]   += latency_ns;
+        latency_sums[sb]   += latency_ns;
+        latency_counts[sa] += 1;
+        latency_counts[sb] += 1;
+      }
+    }
+    // Mean latency from subdomain to its siblings:
+    for (int s = 0; s < num_siblings; ++s) {
+      if (latency_counts[s] == 0) {
+        continue;
+      }
+      auto contains_edge = boost::edge(group.parent_vx,
+                                       group.sibling_vxs[s], _graph);
+      if (contains_edge.second) {
+        _graph[contains_edge.first].distance =
+          static_cast<int>(latency_sums[s] / latency_counts[s]);
+      }
+    }
+  }
+  DYLOC_LOG_DEBUG("dylocxx::topology.measure_latencies", ">");
+}
+
+std::vector<topology::unit_block> topology::partition(
+  size_t        total_elements,
+  weight_policy policy) const {
+  DYLOC_LOG_DEBUG("dylocxx::topology.partition",
+                  "elements:", total_elements,
+                  "policy:",   static_cast<int>(policy));
+  auto unit_hwinfo = [&](const locality_domain & unit_domain)
+                       -> const dyloc_hwinfo_t & {
+      auto unit_lid = dyloc::g2l(unit_domain.team, unit_domain.unit_ids[0]);
+      return (*_unit_mapping)[unit_lid].data()->hwinfo;
+    };
+  // Number of units sharing the NUMA domain of a unit's host:
+  std::unordered_map<std::string, int> numa_num_units;
+  auto numa_key = [&](const dyloc_hwinfo_t & hwinfo) {
+      return std::string(hwinfo.host) + ":" + std::to_string(hwinfo.numa_id);
+    };
+  if (policy == weight_policy::numa_memory ||
+      policy == weight_policy::throughput) {
+    for (const auto & unit_tag :
+           scope_domain_tags(DYLOC_LOCALITY_SCOPE_UNIT)) {
+      ++numa_num_units[numa_key(unit_hwinfo(domain(unit_tag)))];
+    }
+  }
+  return partition(
+           total_elements,
+           [&](const locality_domain & unit_domain) -> double {
+             const auto & hwinfo = unit_hwinfo(unit_domain);
+             switch (policy) {
+               case weight_policy::num_cores:
+                 return unit_domain.num_cores;
+               case weight_policy::cpu_mhz:
+                 return static_cast<double>(unit_domain.num_cores) *
+                        hwinfo.max_cpu_mhz;
+               case weight_policy::numa_memory:
+                 return static_cast<double>(hwinfo.numa_memory_bytes) /
+                        numa_num_units[numa_key(hwinfo)];
+               case weight_policy::throughput:
+                 return static_cast<double>(hwinfo.max_shmem_mbps) /
+                        numa_num_units[numa_key(hwinfo)];
+               default:
+                 return 1.0;
+             }
+           });
+}
+
+std::vector<topology::unit_block> topology::partition(
+  size_t                                                  total_elements,
+  const std::function<double(const locality_domain &)> & unit_weight)
+  const {
+  if (is_compressed()) {
+    topology expanded(*this);
+    expanded.expand();
+    return expanded.partition(total_elements, unit_weight);
+  }
+  // UNIT domains in pre-order of the domain hierarchy:
+  std::vector<const locality_domain *> unit_domains;
+  std::vector<graph_vertex_t>          domain_vxs(
+                                         1, _domain_vertices.at("."));
+  while (!domain_vxs.empty()) {
+    auto vx = domain_vxs.back();
+    domain_vxs.pop_back();
+    const auto & domain = _domains.at(_graph[vx].domain_tag);
+    if (domain.scope == DYLOC_LOCALITY_SCOPE_UNIT &&
+        !domain.unit_ids.empty()) {
+      unit_domains.push_back(&domain);
+    }
+    std::vector<graph_vertex_t> sub_vxs;
+    for (auto domain_edges = out_edges(vx, _graph);
+         domain_edges.first != domain_edges.second;
+         ++domain_edges.first) {
+      auto sub_vx = target(*domain_edges.first, _graph);
+      if (_graph[*domain_edges.first].type == edge_type::contains &&
+          _graph[sub_vx].state != vertex_state::hidden &&
+          _domains.count(_graph[sub_vx].domain_tag) > 0) {
+        sub_vxs.push_back(sub_vx);
+      }
+    }
+    domain_vxs.insert(domain_vxs.end(), sub_vxs.rbegin(), sub_vxs.rend());
+  }
+
+  std::vector<double> weights;
+  for (const auto * unit_domain : unit_domains) {
+    weights.push_back(unit_weight(*unit_domain));
+    if (!(weights.back() > 0)) {
+      DYLOC_LOG_WARN("dylocxx::topology.partition",
+                     "no capacity of unit", unit_domain->unit_ids[0].id,
+                     "- using equal block sizes");
+      break;
+    }
+  }
+  weights.resize(unit_domains.size(), 0);
+
+  auto                    block_sizes = weighted_block_sizes(total_elements,
+                                                             weights);
+  std::vector<unit_block> blocks(unit_domains.size());
+  size_t                  offset      = 0;
+  for (size_t u = 0; u < unit_domains.size(); ++u) {
+    blocks[u].unit    = unit_domains[u]->unit_ids[0];
+    blocks[u].offset  = offset;
+    blocks[u].size    = block_sizes[u];
+    offset           += block_sizes[u];
+  }
+  return blocks;
+}
+
+std::vector<size_t> weighted_block_sizes(
+  size_t                      total_elements,
+  const std::vector<double> & weights) {
+  const size_t num_blocks = weights.size();
+  long double  weight_sum = 0;
+  for (double weight : weights) {
+    if (!(weight > 0)) {
+      weight_sum = 0;
+      break;
+    }
+    weight_sum += weight;
+  }
+  // Largest remainder rounding, block sizes add up to the total number
+  // of elements:
+  std::vector<size_t>      block_sizes(num_blocks);
+  std::vector<long double> remainders(num_blocks);
+  size_t                   num_assigned = 0;
+  for (size_t b = 0; b < num_blocks; ++b) {
+    long double share = (weight_sum > 0)
+                        ? static_cast<long double>(total_elements) *
+                            weights[b] / weight_sum
+                        : static_cast<long double>(total_elements) /
+                            num_blocks;
+    block_sizes[b]  = static_cast<size_t>(share);
+    remainders[b]   = share - block_sizes[b];
+    num_assigned   += block_sizes[b];
+  }
+  std::vector<size_t> by_remainder(num_blocks);
+  for (size_t b = 0; b < num_blocks; ++b) {
+    by_remainder[b] = b;
+  }
+  std::stable_sort(by_remainder.begin(), by_remainder.end(),
+                   [&](size_t a, size_t b) {
+                     return remainders[a] > remainders[b];
+                   });
+  for (size_t r = 0; num_assigned < total_elements &&
+                     r < by_remainder.size(); ++r, ++num_assigned) {
+    ++block_sizes[by_remainder[r]];
+  }
+  return block_sizes;
+}
+
 } // namespace dyloc
 
@@ -0,0 +1,203 @@
+
+#include <dylocxx/topology_image.h>
+#include <dylocxx/exception.h>
+
+#include <dylocxx/internal/logging.h>
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace dyloc {
+
+constexpr uint32_t topology_image::magic;
+constexpr uint32_t topology_image::version;
+
+namespace {
+
+bool in_bounds(uint64_t offset, uint64_t count, size_t elem_size,
+               uint64_t size) {
+  return offset <= size && count <= (size - offset) / elem_size;
+}
+
+} // namespace
+
+topology_image::topology_image(const char * data, size_t size)
+: _data(data)
+, _size(size) {
+  if (_data == nullptr || _size < sizeof(topology_image_header)) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "buffer too small for topology image: " << _size << " bytes");
+  }
+  const auto & hdr = header();
+  if (hdr.magic != magic) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "buffer does not contain a topology image");
+  }
+  if (hdr.version != version) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "unsupported topology image version " << hdr.version <<
+      ", expected " << version);
+  }
+  if (hdr.size > _size ||
+      !in_bounds(hdr.domains_offset,  hdr.num_domains,
+                 sizeof(topology_image_domain), hdr.size) ||
+      !in_bounds(hdr.edges_offset,    hdr.num_edges,
+                 sizeof(topology_image_edge),   hdr.size) ||
+      !in_bounds(hdr.units_offset,    hdr.num_units,
+                 sizeof(topology_image_unit),   hdr.size) ||
+      !in_bounds(hdr.unit_ids_offset, hdr.num_unit_ids,
+                 sizeof(int32_t),               hdr.size) ||
+      !in_bounds(hdr.tags_offset,     hdr.num_tags,
+                 sizeof(uint32_t),              hdr.size) ||
+      !in_bounds(hdr.unit_localities_offset, hdr.num_unit_localities,
+                 sizeof(dyloc_unit_locality_t), hdr.size) ||
+      !in_bounds(hdr.strings_offset,  hdr.strings_size,
+                 sizeof(char),                  hdr.size) ||
+      hdr.strings_size == 0 ||
+      string(hdr.strings_size - 1)[0] != '\0') {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "topology image sections exceed image size");
+  }
+  if (hdr.num_unit_localities > 0 &&
+      hdr.unit_locality_size != sizeof(dyloc_unit_locality_t)) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "unit locality records in topology image have size " <<
+      hdr.unit_locality_size << ", expected " <<
+      sizeof(dyloc_unit_locality_t));
+  }
+}
+
+void topology_image::validate_records() const {
+  const auto & hdr = header();
+  for (uint32_t d = 0; d < hdr.num_domains; ++d) {
+    const auto & domain = domains()[d];
+    if (domain.tag_offset  >= hdr.strings_size ||
+        domain.host_offset >= hdr.strings_size ||
+        !in_bounds(domain.unit_ids_offset, domain.num_unit_ids,
+                   1, hdr.num_unit_ids)) {
+      DYLOC_THROW(
+        dyloc::exception::invalid_argument,
+        "invalid domain record " << d << " in topology image");
+    }
+  }
+  for (uint32_t e = 0; e < hdr.num_edges; ++e) {
+    if (edges()[e].source >= hdr.num_domains ||
+        edges()[e].target >= hdr.num_domains) {
+      DYLOC_THROW(
+        dyloc::exception::invalid_argument,
+        "invalid edge record " << e << " in topology image");
+    }
+  }
+  for (uint32_t u = 0; u < hdr.num_units; ++u) {
+    if (units()[u].domain >= hdr.num_domains) {
+      DYLOC_THROW(
+        dyloc::exception::invalid_argument,
+        "invalid unit record " << u << " in topology image");
+    }
+  }
+  for (uint32_t t = 0; t < hdr.num_tags; ++t) {
+    if (tags()[t] >= hdr.num_domains) {
+      DYLOC_THROW(
+        dyloc::exception::invalid_argument,
+        "invalid tag index entry " << t << " in topology image");
+    }
+  }
+}
+
+const char * topology_image::string(uint64_t offset) const {
+  if (offset >= header().strings_size) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "string offset " << offset << " exceeds topology image");
+  }
+  return _data + header().strings_offset + offset;
+}
+
+const int32_t * topology_image::unit_ids(
+  const topology_image_domain & domain) const {
+  if (!in_bounds(domain.unit_ids_offset, domain.num_unit_ids,
+                 1, header().num_unit_ids)) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "unit ids of domain record exceed topology image");
+  }
+  return reinterpret_cast<const int32_t *>(
+           _data + header().unit_ids_offset) + domain.unit_ids_offset;
+}
+
+const topology_image_domain & topology_image::domain_record(
+  uint64_t domain_index) const {
+  if (domain_index >= header().num_domains) {
+    DYLOC_THROW(
+      dyloc::exception::invalid_argument,
+      "invalid domain record " << domain_index << " in topology image");
+  }
+  return domains()[domain_index];
+}
+
+const topology_image_domain * topology_image::find_domain(
+  const char * domain_tag) const {
+  const uint32_t * tags_begin = tags();
+  const uint32_t * tags_end   = tags_begin + header().num_tags;
+  auto tag_it = std::lower_bound(
+                  tags_begin, tags_end, domain_tag,
+                  [&](uint32_t d, const char * tag) {
+                    return std::strcmp(
+                             string(domain_record(d).tag_offset), tag) < 0;
+                  });
+  if (tag_it == tags_end ||
+      std::strcmp(string(domain_record(*tag_it).tag_offset),
+                  domain_tag) != 0) {
+    return nullptr;
+  }
+  return &domain_record(*tag_it);
+}
+
+const topology_image_domain * topology_image::unit_domain(
+  int32_t unit_id) const {
+  const topology_image_unit * units_begin = units();
+  const topology_image_unit * units_end   = units_begin + header().num_units;
+  auto unit_it = std::lower_bound(
+                   units_begin, units_end, unit_id,
+                   [](const topology_image_unit & u, int32_t id) {
+                     return u.unit_id < id;
+                   });
+  if (unit_it == units_end || unit_it->unit_id != unit_id) {
+    return nullptr;
+  }
+  return &domain_record(unit_it->domain);
+}
+
+std::pair<const topology_image_edge *, const topology_image_edge *>
+topology_image::out_edges(uint32_t domain_index) const {
+  const topology_image_edge * edges_begin = edges();
+  const topology_image_edge * edges_end   = edges_begin + header().num_edges;
+  auto lower = std::lower_bound(
+                 edges_begin, edges_end, domain_index,
+                 [](const topology_image_edge & e, uint32_t d) {
+                   return e.source < d;
+                 });
+  auto upper = std::upper_bound(
+                 lower, edges_end, domain_index,
+                 [](uint32_t d, const topology_image_edge & e) {
+                   return d < e.source;
+                 });
+  for (auto edge = lower; edge != upper; ++edge) {
+    if (edge->target >= header().num_domains) {
+      DYLOC_THROW(
+        dyloc::exception::invalid_argument,
+        "invalid edge record " << (edge - edges_begin) <<
+        " in topology image");
+    }
+  }
+  return std::make_pair(lower, upper);
+}
+
+} // namespace dyloc
+
@@ -0,0 +1,283 @@
+
+#include <dylocxx/topology_json.h>
+#include <dylocxx/topology.h>
+#include <dylocxx/hwinfo.h>
+
+#include <dylocxx/adapter/dart.h>
+
+#include <dylocxx/internal/logging.h>
+
+#include <vector>
+#include <string>
+
+
+namespace dyloc {
+
+namespace {
+
+typedef topology::graph_t        graph_t;
+typedef topology::graph_vertex_t graph_vertex_t;
+typedef boost::graph_traits<graph_t>::out_edge_iterator out_edge_iterator;
+
+void write_string(std::ostream & os, const std::string & str) {
+  static const char hex_digits[] = "0123456789abcdef";
+  os << '"';
+  for (char c : str) {
+    switch (c) {
+      case '"':  os << "\\\""; break;
+      case '\\': os << "\\\\"; break;
+      case '\n': os << "\\n";  break;
+      case '\t': os << "\\t";  break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          os << "\\u00" << hex_digits[(c >> 4) & 0xf] << hex_digits[c & 0xf];
+        } else {
+          os << c;
+        }
+    }
+  }
+  os << '"';
+}
+
+void write_units(
+  std::ostream                          & os,
+  const std::vector<dart_global_unit_t> & unit_ids,
+  bool                                    unit_ranges) {
+  os << "[ ";
+  for (size_t u = 0; u < unit_ids.size(); ++u) {
+    if (u > 0) { os << ", "; }
+    size_t last = u;
+    if (unit_ranges) {
+      while (last + 1 < unit_ids.size() &&
+             unit_ids[last + 1].id == unit_ids[last].id + 1) {
+        ++last;
+      }
+    }
+    if (last > u) {
+      os << "[" << unit_ids[u].id << "," << unit_ids[last].id << "]";
+      u = last;
+    } else {
+      os << unit_ids[u].id;
+    }
+  }
+  os << " ]";
+}
+
+/* Hardware info of domain, capacities from the domain's first unit: */
+void write_hwinfo(
+  std::ostream           & os,
+  const dyloc_hwinfo_t   & unit_hwinfo,
+  const locality_domain  & domain) {
+  int num_numa  = (domain.scope >= DYLOC_LOCALITY_SCOPE_NUMA)
+                  ? 1 : unit_hwinfo.num_numa;
+  int num_cores = (domain.num_cores > 0)
+                  ? domain.num_cores : unit_hwinfo.num_cores;
+  // Memory capacities in hwinfo are in MB, capacities in KB exceed the
+  // range of int for 2 TB and more:
+  long long shmem_kb = -1;
+  if (domain.scope == DYLOC_LOCALITY_SCOPE_NUMA) {
+    shmem_kb = unit_hwinfo.numa_memory_bytes;
+  } else if (domain.scope < DYLOC_LOCALITY_SCOPE_NUMA) {
+    shmem_kb = unit_hwinfo.system_memory_bytes;
+  }
+  if (shmem_kb > 0) { shmem_kb *= 1024; }
+
+  os << "{ \"numa_id\": "   << unit_hwinfo.numa_id
+     << ", \"num_numa\": "  << num_numa
+     << ", \"num_cores\": " << num_cores
+     << ", \"core_id\": "   << unit_hwinfo.core_id
+     << ", \"cpu_id\": "    << unit_hwinfo.cpu_id
+     << ", \"threads\": { \"min\": " << unit_hwinfo.min_threads
+     <<               ", \"max\": "  << unit_hwinfo.max_threads << " }"
+     << ", \"cpu_mhz\": { \"min\": " << unit_hwinfo.min_cpu_mhz
+     <<               ", \"max\": "  << unit_hwinfo.max_cpu_mhz << " }"
+     << ", \"mem_mbps\": "  << unit_hwinfo.max_shmem_mbps
+     << ", \"system_mb\": " << unit_hwinfo.system_memory_bytes
+     << ", \"numa_mb\": "   << unit_hwinfo.numa_memory_bytes;
+  if (shmem_kb > 0) {
+    os << ", \"shmem\": " << shmem_kb;
+  }
+  os << " }";
+}
+
+class json_writer {
+  struct frame {
+    graph_vertex_t    vx;
+    out_edge_iterator edge_it;
+    out_edge_iterator edge_end;
+    int               num_subdomains;
+  };
+
+  std::ostream       & _os;
+  const topology     & _topo;
+  const graph_t      & _graph;
+  const json_options & _options;
+
+ public:
+  json_writer(
+    std::ostream       & os,
+    const topology     & topo,
+    const json_options & options)
+  : _os(os)
+  , _topo(topo)
+  , _graph(topo.graph())
+  , _options(options)
+  { }
+
+  void write(graph_vertex_t root_vx) {
+    // Explicit stack of the current domain's ancestors instead of
+    // recursion, domains in deep hierarchies are written in place:
+    std::vector<frame> stack;
+    open_domain(root_vx, 0, stack);
+    while (!stack.empty()) {
+      auto & parent = stack.back();
+      for (; parent.edge_it != parent.edge_end; ++parent.edge_it) {
+        if (is_subdomain(*parent.edge_it)) { break; }
+      }
+      if (parent.edge_it == parent.edge_end) {
+        close_domain(parent, stack.size() - 1);
+        stack.pop_back();
+        continue;
+      }
+      auto subdomain_vx = target(*parent.edge_it, _graph);
+      ++parent.edge_it;
+      if (parent.num_subdomains++ > 0) { _os << ","; }
+      newline(stack.size() * 2);
+      write_string(_os, _graph[subdomain_vx].domain_tag);
+      _os << ": ";
+      open_domain(subdomain_vx, stack.size() * 2, stack);
+    }
+    _os << '\n';
+  }
+
+ private:
+  bool is_subdomain(const topology::graph_edge_t & e) const {
+    return _graph[e].type == topology::edge_type::contains &&
+           _topo.is_visible(target(e, _graph));
+  }
+
+  const dyloc_unit_locality_t * first_unit_locality(
+    const locality_domain & domain) const {
+    if (domain.unit_ids.empty()) {
+      return nullptr;
+    }
+    const auto & unit_map = _topo.unit_map();
+    dart_team_unit_t unit_lid;
+    unit_lid.id = domain.unit_ids[0].id;
+    if (domain.team != DART_TEAM_ALL) {
+      unit_lid = dyloc::g2l(domain.team, domain.unit_ids[0]);
+    }
+    if (unit_lid.id < 0 ||
+        unit_lid.id >= static_cast<int>(unit_map.size())) {
+      return nullptr;
+    }
+    return unit_map[unit_lid].data();
+  }
+
+  void newline(int depth) {
+    if (_options.indent) {
+      _os << '\n' << std::string(depth * 2, ' ');
+    }
+  }
+
+  void open_domain(
+    graph_vertex_t       vx,
+    int                  depth,
+    std::vector<frame> & stack) {
+    const auto & domain = *_topo.visible_domain(vx);
+    const auto * uloc   = first_unit_locality(domain);
+
+    _os << "{";
+    newline(depth + 1);
+    _os << "\"scope\": \"" << domain.scope << "\",";
+    newline(depth + 1);
+    _os << "\"level\": " << domain.level << ",";
+    newline(depth + 1);
+    _os << "\"idx\": " << domain.r_index << ",";
+    if (!domain.host.empty()) {
+      newline(depth + 1);
+      _os << "\"host\": ";
+      write_string(_os, domain.host);
+      _os << ",";
+    }
+    if (domain.scope == DYLOC_LOCALITY_SCOPE_NODE) {
+      newline(depth + 1);
+      _os << "\"node_id\": " << domain.g_index << ",";
+    }
+    newline(depth + 1);
+    _os << "\"units\": ";
+    write_units(_os, domain.unit_ids, _options.unit_ranges);
+    if (uloc != nullptr) {
+      _os << ",";
+      newline(depth + 1);
+      _os << "\"hwinfo\": ";
+      write_hwinfo(_os, uloc->hwinfo, domain);
+    }
+    if (domain.scope == DYLOC_LOCALITY_SCOPE_UNIT && uloc != nullptr) {
+      _os << ",";
+      newline(depth + 1);
+      _os << "\"unit_id\": { \"local_id\": " << uloc->unit.id
+          << ", \"team\": "      << uloc->team
+          << ", \"global_id\": " << domain.unit_ids[0].id << " },";
+      newline(depth + 1);
+      _os << "\"unit_locality\": { \"domain\": ";
+      write_string(_os, domain.domain_tag);
+      _os << ", \"host\": ";
+      write_string(_os, uloc->hwinfo.host);
+      _os << ", \"hwinfo\": ";
+      write_hwinfo(_os, uloc->hwinfo, domain);
+      _os << " }";
+    }
+
+    frame f;
+    f.vx             = vx;
+    f.num_subdomains = 0;
+    std::tie(f.edge_it, f.edge_end) = out_edges(vx, _graph);
+    int ndomains = 0;
+    for (auto e = f.edge_it; e != f.edge_end; ++e) {
+      if (is_subdomain(*e)) { ++ndomains; }
+    }
+    _os << ",";
+    newline(depth + 1);
+    _os << "\"ndomains\": " << ndomains;
+    if (ndomains > 0) {
+      _os << ",";
+      newline(depth + 1);
+      _os << "\"domains\": {";
+    }
+    stack.push_back(f);
+  }
+
+  void close_domain(const frame & f, int depth) {
+    if (f.num_subdomains > 0) {
+      newline(depth * 2 + 1);
+      _os << "}";
+    }
+    newline(depth * 2);
+    _os << "}";
+  }
+};
+
+} // namespace
+
+void write_json(
+  std::ostream       & os,
+  const topology     & topo,
+  const json_options & options) {
+  DYLOC_LOG_DEBUG("dylocxx::write_json", "domains:", topo.domains().size(),
+                  "unit ranges:", options.unit_ranges);
+  if (topo.is_compressed()) {
+    topology expanded(topo);
+    expanded.expand();
+    write_json(os, expanded, options);
+    return;
+  }
+  auto root_vx_it = topo.domain_vertices().find(".");
+  if (root_vx_it != topo.domain_vertices().end() &&
+      topo.is_visible(root_vx_it->second)) {
+    json_writer(os, topo, options).write(root_vx_it->second);
+  }
+}
+
+} // namespace dyloc
+
@@ -0,0 +1,178 @@
+
+#include <dyloc/common/config.h>
+
+#include <dylocxx/topology_snapshot.h>
+#include <dylocxx/topology.h>
+#include <dylocxx/exception.h>
+
+#include <dylocxx/internal/logging.h>
+
+#ifdef DYLOC__PLATFORM__POSIX
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include <fstream>
+#include <iterator>
+#include <cerrno>
+#include <cstdio>
+
+
+namespace dyloc {
+
+topology_snapshot::topology_snapshot(const std::string & file) {
+  DYLOC_LOG_DEBUG("dylocxx::topology_snapshot.()", "file:", file);
+#ifdef DYLOC__PLATFORM__POSIX
+  int fd = ::open(file.c_str(), O_RDONLY);
+  struct stat file_stat;
+  if (fd < 0 || ::fstat(fd, &file_stat) != 0) {
+    if (fd >= 0) { ::close(fd); }
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "could not read topology snapshot from " << file);
+  }
+  _size = file_stat.st_size;
+  if (_size > 0) {
+    void * addr = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      DYLOC_THROW(
+        dyloc::exception::runtime_config_error,
+        "could not map topology snapshot " << file);
+    }
+    _data = static_cast<const char *>(addr);
+  }
+  ::close(fd);
+#else
+  std::ifstream is(file, std::ios::binary);
+  if (!is) {
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "could not read topology snapshot from " << file);
+  }
+  _buffer.assign(std::istreambuf_iterator<char>(is),
+                 std::istreambuf_iterator<char>());
+  _data = _buffer.data();
+  _size = _buffer.size();
+#endif
+  try {
+    // Validate header and section bounds once:
+    _image = topology_image(_data, _size);
+  } catch (...) {
+    release();
+    throw;
+  }
+}
+
+topology_snapshot::~topology_snapshot() {
+  release();
+}
+
+topology_snapshot::topology_snapshot(topology_snapshot && other)
+: _data(other._data)
+, _size(other._size)
+, _buffer(std::move(other._buffer))
+, _image(other._image) {
+  other._data  = nullptr;
+  other._size  = 0;
+  other._image = topology_image();
+}
+
+topology_snapshot & topology_snapshot::operator=(
+  topology_snapshot && other) {
+  if (this != &other) {
+    release();
+    _data       = other._data;
+    _size       = other._size;
+    _buffer      = std::move(other._buffer);
+    _image       = other._image;
+    other._data  = nullptr;
+    other._size  = 0;
+    other._image = topology_image();
+  }
+  return *this;
+}
+
+void topology_snapshot::release() {
+#ifdef DYLOC__PLATFORM__POSIX
+  if (_data != nullptr) {
+    ::munmap(const_cast<char *>(_data), _size);
+  }
+#endif
+  _buffer.clear();
+  _image = topology_image();
+  _data  = nullptr;
+  _size  = 0;
+}
+
+dyloc::unit_mapping topology_snapshot::unit_map() const {
+  const auto & img = image();
+  const auto & hdr = img.header();
+  dyloc::unit_mapping unit_map;
+  unit_map.team = hdr.team;
+  unit_map.unit_localities.reserve(hdr.num_unit_localities);
+  for (uint32_t u = 0; u < hdr.num_unit_localities; ++u) {
+    unit_map.unit_localities.push_back(
+      unit_locality(img.unit_localities()[u]));
+  }
+  return unit_map;
+}
+
+void topology_snapshot::write(
+  const std::string & file,
+  const topology    & topo) {
+  auto image = topo.serialize(true);
+  DYLOC_LOG_DEBUG("dylocxx::topology_snapshot.write",
+                  "file:", file, "size:", image.size());
+#ifdef DYLOC__PLATFORM__POSIX
+  // Unique temporary file in the same directory, so concurrent writers
+  // do not clobber each other and rename is atomic:
+  std::vector<char> tmp_file(file.begin(), file.end());
+  const char        tmp_suffix[] = ".XXXXXX";
+  tmp_file.insert(tmp_file.end(), tmp_suffix, tmp_suffix + sizeof(tmp_suffix));
+  int fd = ::mkstemp(tmp_file.data());
+  if (fd < 0) {
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "could not create temporary file for topology snapshot " << file);
+  }
+  bool written = ::fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0;
+  for (size_t offset = 0; written && offset < image.size(); ) {
+    auto nbytes = ::write(fd, image.data() + offset, image.size() - offset);
+    if (nbytes < 0 && errno == EINTR) {
+      continue;
+    }
+    written = nbytes > 0;
+    offset += written ? nbytes : 0;
+  }
+  written = (::close(fd) == 0) && written;
+  if (!written) {
+    std::remove(tmp_file.data());
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "could not write topology snapshot to " << tmp_file.data());
+  }
+#else
+  std::string tmp_file = file + ".tmp";
+  {
+    std::ofstream os(tmp_file, std::ios::binary | std::ios::trunc);
+    os.write(image.data(), image.size());
+    if (!os) {
+      DYLOC_THROW(
+        dyloc::exception::runtime_config_error,
+        "could not write topology snapshot to " << tmp_file);
+    }
+  }
+#endif
+  if (std::rename(tmp_file.data(), file.c_str()) != 0) {
+    std::remove(tmp_file.data());
+    DYLOC_THROW(
+      dyloc::exception::runtime_config_error,
+      "could not write topology snapshot to " << file);
+  }
+}
+
+} // namespace dyloc
+
@@ -9,9 +9,32 @@
 
 #include <dash/dart/if/dart.h>
 
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include <cstring>
+
 
 namespace dyloc {
 
+namespace {
+
+/**
+ * Locality properties of a unit that change when the unit is moved
+ * within its host.
+ */
+struct unit_locality_delta {
+  dart_team_unit_t           unit;
+  int                        numa_id;
+  int                        core_id;
+  int                        cpu_id;
+  int                        num_scopes;
+  int                        numa_distances[DYLOC_LOCALITY_MAX_NUMA_ID];
+  dyloc_locality_scope_pos_t scopes[DYLOC_LOCALITY_MAX_DOMAIN_SCOPES];
+};
+
+} // namespace
+
 unit_mapping::unit_mapping(dart_team_t t)
 : team(t) {
   dart_team_unit_t myid   = DART_UNDEFINED_TEAM_UNIT_ID;
@@ -38,5 +61,80 @@ unit_mapping::unit_mapping(dart_team_t t)
   dart_barrier(team);
 }
 
+std::vector<dart_team_unit_t> unit_mapping::resync(
+  const dyloc_hwinfo_t * unit_hwinfo) {
+  dart_team_unit_t myid   = DART_UNDEFINED_TEAM_UNIT_ID;
+  size_t           nunits = unit_localities.size();
+  DYLOC_ASSERT_RETURNS(dart_team_myid(team, &myid), DART_OK);
+
+  std::vector<unit_locality_delta> send_deltas;
+  if (unit_hwinfo != nullptr) {
+    unit_locality_delta delta;
+    delta.unit       = myid;
+    delta.numa_id    = unit_hwinfo->numa_id;
+    delta.core_id    = unit_hwinfo->core_id;
+    delta.cpu_id     = unit_hwinfo->cpu_id;
+    delta.num_scopes = unit_hwinfo->num_scopes;
+    std::memcpy(delta.numa_distances, unit_hwinfo->numa_distances,
+                sizeof(delta.numa_distances));
+    std::memcpy(delta.scopes, unit_hwinfo->scopes,
+                sizeof(delta.scopes));
+    send_deltas.push_back(delta);
+  }
+
+  // Exchange number of bytes contributed by every unit, then the deltas
+  // of changed units only:
+  size_t              send_nbytes = send_deltas.size() *
+                                    sizeof(unit_locality_delta);
+  std::vector<size_t> recv_nbytes(nunits);
+  DYLOC_ASSERT_RETURNS(
+    dart_allgather(&send_nbytes,
+                   recv_nbytes.data(),
+                   1,
+                   DART_TYPE_SIZET,
+                   team),
+    DART_OK);
+  std::vector<size_t> recv_displs(nunits, 0);
+  std::partial_sum(recv_nbytes.begin(), recv_nbytes.end() - 1,
+                   recv_displs.begin() + 1);
+  size_t total_nbytes = recv_displs.back() + recv_nbytes.back();
+  if (total_nbytes == 0) {
+    DYLOC_LOG_DEBUG("dylocxx::unit_mapping.resync", "no units changed");
+    return { };
+  }
+
+  std::vector<unit_locality_delta> recv_deltas(
+    total_nbytes / sizeof(unit_locality_delta));
+  DYLOC_ASSERT_RETURNS(
+    dart_allgatherv(send_deltas.data(),
+                    send_nbytes,
+                    DART_TYPE_BYTE,
+                    recv_deltas.data(),
+                    recv_nbytes.data(),
+                    recv_displs.data(),
+                    team),
+    DART_OK);
+  DYLOC_LOG_DEBUG("dylocxx::unit_mapping.resync",
+                  "changed units:", recv_deltas.size(),
+                  "bytes:",         total_nbytes);
+
+  std::vector<dart_team_unit_t> changed_units;
+  for (const auto & delta : recv_deltas) {
+    auto & hwinfo      = unit_localities[delta.unit.id].data()->hwinfo;
+    hwinfo.numa_id     = delta.numa_id;
+    hwinfo.core_id     = delta.core_id;
+    hwinfo.cpu_id      = delta.cpu_id;
+    hwinfo.num_scopes  = delta.num_scopes;
+    std::memcpy(hwinfo.numa_distances, delta.numa_distances,
+                sizeof(hwinfo.numa_distances));
+    std::memcpy(hwinfo.scopes, delta.scopes,
+                sizeof(hwinfo.scopes));
+    DYLOC_LOG_TRACE("dylocxx::unit_mapping.resync",
+                    "updated:", *unit_localities[delta.unit.id].data());
+    changed_units.push_back(delta.unit);
+  }
+  return changed_units;
+}
+
 } // namespace dyloc
 
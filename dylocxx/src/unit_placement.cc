@@ -0,0 +1,84 @@
+#include <dyloc/common/config.h>
+
+#ifdef DYLOC__PLATFORM__LINUX
+/* _GNU_SOURCE required for sched_getcpu() and CPU_ISSET */
+#  ifndef _GNU_SOURCE
+#    define _GNU_SOURCE
+#  endif
+#  include <sched.h>
+#endif
+
+#include <dylocxx/unit_placement.h>
+
+#include <dylocxx/internal/logging.h>
+
+#include <dyloc/common/internal/macro.h>
+
+#ifdef DYLOC_ENABLE_NUMA
+#  include <numa.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+
+namespace dyloc {
+
+unit_placement unit_placement::sample(int num_samples) {
+  unit_placement placement;
+#ifdef DYLOC__PLATFORM__LINUX
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &cpu_set)) {
+        placement.cpu_set.push_back(cpu);
+      }
+    }
+  }
+#  ifdef DYLOC_ENABLE_NUMA
+  if (numa_available() >= 0) {
+    for (int s = 0; s < num_samples; ++s) {
+      int cpu = sched_getcpu();
+      int numa_node = (cpu >= 0) ? numa_node_of_cpu(cpu) : -1;
+      if (numa_node >= 0) {
+        placement.numa_nodes.push_back(numa_node);
+      }
+    }
+    std::sort(placement.numa_nodes.begin(), placement.numa_nodes.end());
+    placement.numa_nodes.erase(
+      std::unique(placement.numa_nodes.begin(), placement.numa_nodes.end()),
+      placement.numa_nodes.end());
+  }
+#  else
+  dyloc__unused(num_samples);
+#  endif
+#else
+  dyloc__unused(num_samples);
+#endif
+  DYLOC_LOG_TRACE("dylocxx::unit_placement.sample",
+                  "cpus:",       placement.cpu_set.size(),
+                  "numa nodes:", placement.numa_nodes.size());
+  return placement;
+}
+
+bool is_migrated(
+  const unit_placement & previous,
+  const unit_placement & current) {
+  if (previous.cpu_set != current.cpu_set) {
+    return true;
+  }
+  if (previous.numa_nodes.empty() || current.numa_nodes.empty()) {
+    return false;
+  }
+  for (int numa_node : current.numa_nodes) {
+    if (std::binary_search(previous.numa_nodes.begin(),
+                           previous.numa_nodes.end(),
+                           numa_node)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace dyloc
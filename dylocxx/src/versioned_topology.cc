@@ -0,0 +1,31 @@
+
+#include <dylocxx/versioned_topology.h>
+#include <dylocxx/topology.h>
+
+#include <dylocxx/internal/logging.h>
+
+#include <memory>
+#include <utility>
+
+
+namespace dyloc {
+
+versioned_topology::versioned_topology(topology && topo)
+: _topology(std::move(topo))
+, _published(std::make_shared<const version>(1, _topology))
+{ }
+
+uint64_t versioned_topology::publish_locked() {
+  // The new version is copied before it is published so readers never
+  // observe a partially constructed topology:
+  uint64_t number = std::atomic_load(&_published)->number + 1;
+  std::shared_ptr<const version> next(
+    std::make_shared<const version>(number, _topology));
+  std::atomic_store(&_published, std::move(next));
+  DYLOC_LOG_DEBUG("dylocxx::versioned_topology.publish",
+                  "version:", number);
+  return number;
+}
+
+} // namespace dyloc
+
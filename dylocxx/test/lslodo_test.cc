@@ -0,0 +1,142 @@
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <cstdio>
+#include <cstring>
+
+#include "lslodo_test.h"
+
+#include <lslodo/domain_tree.h>
+
+
+namespace dyloc {
+namespace test {
+
+namespace {
+
+domain_tree read_example(const std::string & file_name) {
+  std::string path = std::string(LSLODO_EXAMPLES_DIR) + "/" + file_name;
+  std::FILE * file = std::fopen(path.c_str(), "r");
+  EXPECT_NE(nullptr, file) << path;
+  domain_tree tree;
+  if (file != nullptr) {
+    json_reader json(file);
+    tree.read(json);
+    std::fclose(file);
+  }
+  return tree;
+}
+
+std::string read_json_string(const std::string & json_str) {
+  std::vector<char> buf(json_str.begin(), json_str.end());
+  std::FILE * file = fmemopen(buf.data(), buf.size(), "r");
+  json_reader json(file);
+  std::string str = json.string();
+  std::fclose(file);
+  return str;
+}
+
+} // namespace
+
+TEST_F(LslodoTest, ParseExample) {
+  auto tree = read_example("locdomains.supermic.json");
+  ASSERT_LT(0, tree.size());
+
+  const auto & root = tree[0];
+  EXPECT_EQ(".",      root.tag);
+  EXPECT_EQ("GLOBAL", tree.scope(root));
+  EXPECT_EQ(2,        root.num_domains);
+
+  for (size_t d = 0; d < tree.size(); ++d) {
+    const auto & node = tree[d];
+    int num_children  = 0;
+    for (int c = node.first_child; c >= 0; c = tree[c].next_sibling) {
+      // Subdomain tags extend the tag of their parent domain:
+      EXPECT_EQ(0, tree[c].tag.find(node.tag == "." ? "." : node.tag + "."));
+      EXPECT_EQ(node.level + 1, tree[c].level);
+      ++num_children;
+    }
+    EXPECT_EQ(node.num_domains, num_children) << node.tag;
+  }
+  const auto & node_0 = tree[root.first_child];
+  EXPECT_EQ(".0",         node_0.tag);
+  EXPECT_EQ("NODE",       tree.scope(node_0));
+  EXPECT_EQ("i01r13a02",  tree.host(node_0));
+}
+
+TEST_F(LslodoTest, FoldExample) {
+  auto unfolded = read_example("locdomains.supermic.json");
+  auto tree     = unfolded;
+  EXPECT_FALSE(tree.fold({ }));
+
+  for (size_t d = 0; d < tree.size(); ++d) {
+    const auto & node = tree[d];
+    // Multiplicities of subdomains add up to the number of subdomains,
+    // and folded domains are represented by their first sibling:
+    int multiplicity_sum = 0;
+    std::vector<std::pair<int, int> > units;
+    std::vector<std::pair<int, int> > folded_units;
+    for (int c = node.first_child; c >= 0; c = tree[c].next_sibling) {
+      multiplicity_sum += tree[c].multiplicity;
+      if (tree[c].multiplicity > 0) {
+        folded_units.insert(folded_units.end(),
+                            tree[c].units.begin(), tree[c].units.end());
+      }
+      units.insert(units.end(),
+                   unfolded[c].units.begin(), unfolded[c].units.end());
+    }
+    EXPECT_EQ(node.num_domains, multiplicity_sum) << node.tag;
+    // Units of folded domains are merged into their representative:
+    auto num_units = [](const std::vector<std::pair<int, int> > & ranges) {
+      int n = 0;
+      for (const auto & range : ranges) { n += range.second - range.first + 1; }
+      return n;
+    };
+    EXPECT_EQ(num_units(units), num_units(folded_units)) << node.tag;
+  }
+  // Both nodes have identical hardware and are folded:
+  const auto & node_0 = tree[tree[0].first_child];
+  EXPECT_EQ(2, node_0.multiplicity);
+  EXPECT_EQ(0, tree[node_0.next_sibling].multiplicity);
+
+  tree.layout();
+  EXPECT_LT(0, tree[0].rect.w);
+  EXPECT_LT(0, tree[0].rect.h);
+}
+
+TEST_F(LslodoTest, FoldExpandedExample) {
+  auto tree = read_example("locdomains.supermic.json");
+  EXPECT_TRUE(tree.fold({ ".1.0.1" }));
+
+  // The expanded domain and its ancestors are not folded into siblings:
+  for (size_t d = 0; d < tree.size(); ++d) {
+    const auto & node = tree[d];
+    if (node.tag == ".1" || node.tag == ".1.0" || node.tag == ".1.0.1") {
+      EXPECT_EQ(1, node.multiplicity) << node.tag;
+    }
+    if (node.tag == ".0") {
+      EXPECT_EQ(1, node.multiplicity) << node.tag;
+    }
+  }
+  tree.layout();
+  EXPECT_LT(0, tree[0].rect.w);
+  EXPECT_LT(0, tree[0].rect.h);
+}
+
+TEST_F(LslodoTest, UnicodeEscapes) {
+  EXPECT_EQ("host-a",        read_json_string("\"host-a\""));
+  EXPECT_EQ("A\t",           read_json_string("\"\\u0041\\t\""));
+  // Two- and three-byte sequences:
+  EXPECT_EQ("h\xc3\xa9",     read_json_string("\"h\\u00e9\""));
+  EXPECT_EQ("\xe2\x82\xac",  read_json_string("\"\\u20AC\""));
+  // Surrogate pair:
+  EXPECT_EQ("\xf0\x9f\x98\x80",
+            read_json_string("\"\\ud83d\\ude00\""));
+  // Unpaired surrogates are replaced by U+FFFD:
+  EXPECT_EQ("\xef\xbf\xbd" "x", read_json_string("\"\\ud83dx\""));
+  EXPECT_EQ("\xef\xbf\xbd",     read_json_string("\"\\ude00\""));
+}
+
+} // namespace test
+} // namespace dyloc
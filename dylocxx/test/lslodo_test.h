@@ -0,0 +1,18 @@
+#ifndef DYLOCXX__TEST__LSLODO_TEST_H__INCLUDED
+#define DYLOCXX__TEST__LSLODO_TEST_H__INCLUDED
+
+#include <gtest/gtest.h>
+
+#include "test_base.h"
+
+namespace dyloc {
+namespace test {
+
+class LslodoTest : public dyloc::test::TestBase {
+
+};
+
+} // namespace dyloc
+} // namespace test
+
+#endif // DYLOCXX__TEST__LSLODO_TEST_H__INCLUDED
@@ -2,6 +2,17 @@
 
 #include <algorithm>
 #include <memory>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <functional>
+#include <numeric>
+#include <cstring>
+
+#include <unistd.h>
 
 #include "topology_test.h"
 #include "test_globals.h"
@@ -9,10 +20,23 @@
 #include <dylocxx/init.h>
 #include <dylocxx/unit_locality.h>
 #include <dylocxx/hwinfo.h>
+#include <dylocxx/host_topology.h>
 
 #include <dylocxx/utility.h>
 #include <dylocxx/adapter/dart.h>
 #include <dylocxx/internal/logging.h>
+#include <dylocxx/internal/json.h>
+
+#include <dylocxx/network_topology.h>
+#include <dylocxx/topology_snapshot.h>
+#include <dylocxx/topology_json.h>
+#include <dylocxx/domain_allocator.h>
+#include <dylocxx/frozen_topology.h>
+#include <dylocxx/versioned_topology.h>
+#include <dylocxx/unit_placement.h>
+#include <dylocxx/adapter/hwloc.h>
+
+#include <dyloc/topology.h>
 
 #include <boost/graph/graph_utility.hpp>
 #include <boost/graph/depth_first_search.hpp>
@@ -21,6 +45,57 @@
 namespace dyloc {
 namespace test {
 
+namespace {
+
+/*
+ * Mapping of units in team ALL to the specified hosts.
+ * Units at the same host are placed on consecutive cores, every core in
+ * a separate CACHE domain and the specified number of cores in a NUMA
+ * domain.
+ */
+dyloc::unit_mapping synthetic_unit_mapping(
+  const std::vector<std::string> & unit_hosts,
+  int                              cores_per_numa = 2) {
+  std::map<std::string, int> host_num_units;
+  for (const auto & host : unit_hosts) {
+    ++host_num_units[host];
+  }
+  dyloc::unit_mapping unit_map;
+  unit_map.team = DART_TEAM_ALL;
+  std::map<std::string, int> host_next_core;
+  for (size_t u = 0; u < unit_hosts.size(); ++u) {
+    const auto & host = unit_hosts[u];
+    int core_id  = host_next_core[host]++;
+    int num_numa = (host_num_units[host] + cores_per_numa - 1) /
+                   cores_per_numa;
+
+    dyloc_unit_locality_t uloc;
+    uloc.unit.id = u;
+    uloc.team    = DART_TEAM_ALL;
+    uloc.hwinfo  = *dyloc::hwinfo().data();
+
+    auto & hw = uloc.hwinfo;
+    std::strncpy(hw.host, host.c_str(), DYLOC_LOCALITY_HOST_MAX_SIZE - 1);
+    hw.host[DYLOC_LOCALITY_HOST_MAX_SIZE - 1] = '\0';
+    hw.num_cores = host_num_units[host];
+    hw.core_id   = core_id;
+    hw.cpu_id    = core_id;
+    hw.num_numa  = num_numa;
+    hw.numa_id   = core_id / cores_per_numa;
+    for (int n = 0; n < num_numa; ++n) {
+      hw.numa_distances[n] = (n == hw.numa_id) ? 10 : 20;
+    }
+    hw.num_scopes = 3;
+    hw.scopes[0]  = { DYLOC_LOCALITY_SCOPE_CORE,  core_id };
+    hw.scopes[1]  = { DYLOC_LOCALITY_SCOPE_CACHE, core_id };
+    hw.scopes[2]  = { DYLOC_LOCALITY_SCOPE_NUMA,  hw.numa_id };
+    unit_map.unit_localities.push_back(dyloc::unit_locality(uloc));
+  }
+  return unit_map;
+}
+
+} // namespace
+
 
 //Jakub
 TEST_F(TopologyTest, DistanceMetric) {
@@ -37,9 +112,1274 @@ TEST_F(TopologyTest, DistanceMetric) {
   dyloc::finalize();
 }
 
+TEST_F(TopologyTest, MeasureLatencies) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto & topo = dyloc::team_topology();
+
+  topo.measure_latencies(100);
+
+  auto unit_domain_tag = topo[dyloc::myid()].domain_tag;
+  ASSERT_EQ(0, topo.distance(unit_domain_tag, unit_domain_tag));
+  ASSERT_EQ(topo.distance(".", unit_domain_tag),
+            topo.distance(unit_domain_tag, "."));
+
+  // Host with two NUMA domains of two cores, every core in a separate
+  // CACHE domain:
+  auto unit_map = synthetic_unit_mapping({ "a", "a", "a", "a" }, 2);
+  dyloc::host_topology host_topo(unit_map, { });
+  dyloc::topology synth_topo(DART_TEAM_ALL, host_topo, unit_map);
+
+  std::atomic<int> num_probes(0);
+  synth_topo.measure_latencies(
+    [&](int cpu_a, int cpu_b) {
+      ++num_probes;
+      return (cpu_a / 2 == cpu_b / 2) ? 30 : 120;
+    });
+  // Pairs of CACHE domains in both NUMA domains and the pair of NUMA
+  // domains, probed at the first unit of the host:
+  ASSERT_EQ(dyloc::myid().id == 0 ? 3 : 0, num_probes.load());
+
+  dart_global_unit_t unit_ids[] = { { 0 }, { 1 }, { 2 }, { 3 } };
+  const auto & graph = synth_topo.graph();
+  auto cache_vx = [&](dart_global_unit_t u) {
+      for (auto vx : synth_topo.ancestors(
+                       synth_topo.domain_vertices().at(
+                         synth_topo[u].domain_tag))) {
+        if (synth_topo[graph[vx].domain_tag].scope ==
+              DYLOC_LOCALITY_SCOPE_CACHE) {
+          return vx;
+        }
+      }
+      return boost::graph_traits<dyloc::topology::graph_t>::null_vertex();
+    };
+  auto adjacent_distance = [&](dyloc::topology::graph_vertex_t a,
+                               dyloc::topology::graph_vertex_t b) {
+      for (auto edges = out_edges(a, graph);
+           edges.first != edges.second; ++edges.first) {
+        if (graph[*edges.first].type ==
+              dyloc::topology::edge_type::adjacent &&
+            target(*edges.first, graph) == b) {
+          return graph[*edges.first].distance;
+        }
+      }
+      return -1;
+    };
+  // CACHE domains of cores 0 and 1 are siblings in the first NUMA domain:
+  auto cache_0 = cache_vx(unit_ids[0]);
+  auto cache_1 = cache_vx(unit_ids[1]);
+  auto numa_0  = *synth_topo.ancestors(cache_0).begin();
+  auto numa_1  = *synth_topo.ancestors(cache_vx(unit_ids[2])).begin();
+  ASSERT_EQ(30,  adjacent_distance(cache_0, cache_1));
+  ASSERT_EQ(30,  adjacent_distance(cache_1, cache_0));
+  ASSERT_EQ(120, adjacent_distance(numa_0,  numa_1));
+  ASSERT_EQ(120, adjacent_distance(numa_1,  numa_0));
+  ASSERT_EQ(30,  synth_topo.distance(synth_topo[unit_ids[0]].domain_tag,
+                                     synth_topo[unit_ids[1]].domain_tag));
+  ASSERT_EQ(120, synth_topo.distance(synth_topo[unit_ids[0]].domain_tag,
+                                     synth_topo[unit_ids[3]].domain_tag));
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, NetworkTopology) {
+  std::vector<std::string> exp_hosts = { "n08", "n09", "n10",
+                                          "m1-ib", "m2-ib", "login" };
+  ASSERT_EQ(exp_hosts,
+            dyloc::network_topology::expand_hostlist(
+              "n[08-10],m[1-2]-ib,login"));
+
+  char hostname[DYLOC_LOCALITY_HOST_MAX_SIZE];
+  gethostname(hostname, DYLOC_LOCALITY_HOST_MAX_SIZE);
+  std::string topo_conf = "dyloc-test-topology.conf";
+  {
+    std::ofstream os(topo_conf);
+    os << "SwitchName=leaf0 Nodes=other[0-3]," << hostname << "\n"
+       << "SwitchName=leaf1 Nodes=other[4-7] # comment\n"
+       << "SwitchName=root  Switches=leaf[0-1]\n";
+  }
+  setenv("DYLOC_NETWORK_TOPOLOGY", topo_conf.c_str(), 1);
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  unsetenv("DYLOC_NETWORK_TOPOLOGY");
+  std::remove(topo_conf.c_str());
+
+  auto & topo = dyloc::team_topology();
+  auto network_tags = topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NETWORK);
+  ASSERT_EQ(2, network_tags.size());
+  for (const auto & node_tag :
+         topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NODE)) {
+    ASSERT_EQ(".0.0.0", node_tag);
+    ASSERT_EQ(3, topo[node_tag].level);
+  }
+  ASSERT_EQ(DYLOC_LOCALITY_SCOPE_NETWORK, topo[".0.0"].scope);
+  ASSERT_EQ(topo["."].unit_ids.size(), topo[".0.0"].unit_ids.size());
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, ClassifyHosts) {
+  // Hosts in mixed order, "n1" is a prefix of "n10" but no node of it:
+  std::vector<std::string> hosts = { "n10-mic0", "n1", "login",
+                                     "n1-mic1",  "n10", "n1_sys",
+                                     "n1-mic0",  "n1x", "n100" };
+  auto node_ids = dyloc::classify_hosts(hosts);
+  std::vector<int> exp_node_ids = { 4, -1, -1,
+                                    1, -1,  1,
+                                    1, -1, -1 };
+  ASSERT_EQ(exp_node_ids, node_ids);
+
+  // Known node of module overrides classification by name:
+  auto known_node_ids = dyloc::classify_hosts(
+                          { "a", "a-mic0", "b" }, { -1, 2, -1 });
+  std::vector<int> exp_known_node_ids = { -1, 2, -1 };
+  ASSERT_EQ(exp_known_node_ids, known_node_ids);
+
+  setenv("DYLOC_MODULE_SUFFIX_PATTERN", "\\.[0-9]+", 1);
+  auto custom_node_ids = dyloc::classify_hosts({ "a.1", "a", "a-mic0" });
+  unsetenv("DYLOC_MODULE_SUFFIX_PATTERN");
+  std::vector<int> exp_custom_node_ids = { 1, -1, -1 };
+  ASSERT_EQ(exp_custom_node_ids, custom_node_ids);
+}
+
+TEST_F(TopologyTest, HostTopology) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  // Hosts in mixed order, host ids are assigned in order of units:
+  auto unit_map = synthetic_unit_mapping(
+                    { "b", "a", "b", "c-mic0", "a", "c" });
+  dyloc::host_topology host_topo(unit_map, { });
+
+  ASSERT_EQ(4, host_topo.num_hosts());
+  std::vector<std::string> exp_host_names = { "b", "a", "c-mic0", "c" };
+  for (int h = 0; h < host_topo.num_hosts(); ++h) {
+    ASSERT_EQ(exp_host_names[h], host_topo.host_name(h));
+    ASSERT_EQ(h, host_topo.host_id(host_topo.host_name(h)));
+    ASSERT_EQ(exp_host_names[h],
+              host_topo.host_domain(h).host);
+  }
+  ASSERT_EQ(-1, host_topo.host_id("d"));
+
+  std::vector<std::vector<int> > exp_host_units = { { 0, 2 }, { 1, 4 },
+                                                    { 3 },    { 5 } };
+  for (int h = 0; h < host_topo.num_hosts(); ++h) {
+    std::vector<int> host_units;
+    for (auto unit_id : host_topo.unit_ids(h)) {
+      host_units.push_back(unit_id.id);
+    }
+    ASSERT_EQ(exp_host_units[h], host_units);
+    ASSERT_EQ(static_cast<int>(exp_host_units[h].size()),
+              host_topo.host_domain(h).num_cores);
+  }
+
+  // Nodes and modules ordered by host name:
+  std::vector<int> exp_nodes   = { 1, 0, 3 };
+  std::vector<int> exp_modules = { 2 };
+  ASSERT_EQ(exp_nodes,   host_topo.nodes());
+  ASSERT_EQ(exp_modules, host_topo.modules());
+  ASSERT_EQ(exp_modules, host_topo.node_modules(3));
+  ASSERT_TRUE(host_topo.node_modules(1).empty());
+  ASSERT_EQ(std::string("c"), host_topo.host_domain(2).parent);
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, NumaAdjacency) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  // Row of the NUMA distance matrix is indexed by logical NUMA id:
+  dyloc::hwinfo local_hwinfo;
+  local_hwinfo.collect();
+  const auto & hw = *local_hwinfo.data();
+  if (hw.numa_id >= 0 && hw.numa_id < DYLOC_LOCALITY_MAX_NUMA_ID &&
+      hw.numa_distances[hw.numa_id] >= 0) {
+    ASSERT_EQ(10, hw.numa_distances[hw.numa_id]);
+  }
+
+  // Host with two NUMA domains of two cores each:
+  auto unit_map = synthetic_unit_mapping({ "a", "a", "a", "a" }, 2);
+  dyloc::host_topology host_topo(unit_map, { });
+  ASSERT_EQ(20, host_topo.numa_distance(0, 0, 1));
+  ASSERT_EQ(10, host_topo.numa_distance(0, 1, 1));
+
+  dyloc::topology topo(DART_TEAM_ALL, host_topo, unit_map);
+  auto numa_tags = topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NUMA);
+  ASSERT_EQ(2, numa_tags.size());
+  const auto & graph = topo.graph();
+  for (const auto & numa_tag : numa_tags) {
+    auto numa_vx      = topo.domain_vertices().at(numa_tag);
+    int  num_adjacent = 0;
+    for (auto edges = out_edges(numa_vx, graph);
+         edges.first != edges.second; ++edges.first) {
+      if (graph[*edges.first].type == dyloc::topology::edge_type::adjacent) {
+        ASSERT_EQ(20, graph[*edges.first].distance);
+        ++num_adjacent;
+      }
+    }
+    ASSERT_EQ(1, num_adjacent);
+  }
+  ASSERT_EQ(20, topo.distance(numa_tags[0], numa_tags[1]));
+  dart_global_unit_t unit_0 = { 0 };
+  dart_global_unit_t unit_3 = { 3 };
+  ASSERT_EQ(20, topo.distance(topo[unit_0].domain_tag,
+                              topo[unit_3].domain_tag));
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, ParallelBuild) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  std::vector<std::string> unit_hosts;
+  for (int n = 0; n < 8; ++n) {
+    for (int u = 0; u < 4; ++u) {
+      unit_hosts.push_back("n" + std::to_string(n));
+    }
+  }
+  unit_hosts.push_back("n2-mic0");
+  unit_hosts.push_back("n2-mic0");
+  auto unit_map = synthetic_unit_mapping(unit_hosts, 2);
+  dyloc::host_topology host_topo(unit_map, { });
+
+  unsetenv("DYLOC_BUILD_THREADS");
+  dyloc::topology serial_topo(DART_TEAM_ALL, host_topo, unit_map);
+  setenv("DYLOC_BUILD_THREADS", "4", 1);
+  dyloc::topology threaded_topo(DART_TEAM_ALL, host_topo, unit_map);
+  unsetenv("DYLOC_BUILD_THREADS");
+
+  ASSERT_EQ(serial_topo.domains().size(), threaded_topo.domains().size());
+  for (const auto & domain : serial_topo.domains()) {
+    const auto & threaded_domain = threaded_topo[domain.first];
+    ASSERT_EQ(domain.second.scope,     threaded_domain.scope);
+    ASSERT_EQ(domain.second.g_index,   threaded_domain.g_index);
+    ASSERT_EQ(domain.second.num_cores, threaded_domain.num_cores);
+    ASSERT_EQ(domain.second.unit_ids.size(),
+              threaded_domain.unit_ids.size());
+  }
+  ASSERT_EQ(serial_topo.serialize(), threaded_topo.serialize());
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, SerializeImage) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto & topo  = dyloc::team_topology();
+  auto   image = topo.serialize();
+
+  dyloc::unit_mapping unit_map(DART_TEAM_ALL);
+  dyloc::topology     restored(
+    dyloc::topology_image(image.data(), image.size()),
+    unit_map);
+  ASSERT_EQ(topo.domains().size(), restored.domains().size());
+  for (const auto & domain : topo.domains()) {
+    const auto & restored_domain = restored[domain.first];
+    ASSERT_EQ(domain.second.scope,           restored_domain.scope);
+    ASSERT_EQ(domain.second.host,            restored_domain.host);
+    ASSERT_EQ(domain.second.num_cores,       restored_domain.num_cores);
+    ASSERT_EQ(domain.second.unit_ids.size(), restored_domain.unit_ids.size());
+  }
+  ASSERT_EQ(topo[dyloc::myid()].domain_tag,
+            restored[dyloc::myid()].domain_tag);
+  ASSERT_EQ(image, restored.serialize());
+
+  image[0] = 0;
+  EXPECT_THROW(
+    dyloc::topology_image(image.data(), image.size()),
+    dyloc::exception::invalid_argument);
+  dyloc::finalize();
+
+  setenv("DYLOC_TOPOLOGY_BUILD", "root", 1);
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  unsetenv("DYLOC_TOPOLOGY_BUILD");
+  ASSERT_EQ(DYLOC_LOCALITY_SCOPE_UNIT,
+            dyloc::team_topology()[dyloc::myid()].scope);
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, SnapshotFile) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto & topo = dyloc::team_topology();
+  auto   file = std::string("/tmp/dyloc-test-snapshot-") +
+                std::to_string(getpid()) + ".dloc";
+  dyloc::topology_snapshot::write(file, topo);
+  {
+    dyloc::topology_snapshot snapshot(file);
+    auto image = snapshot.image();
+    ASSERT_EQ(topo.domains().size(), image.header().num_tags);
+
+    const auto * root = image.find_domain(".");
+    ASSERT_NE(nullptr, root);
+    ASSERT_EQ(DYLOC_LOCALITY_SCOPE_GLOBAL, root->scope);
+    ASSERT_EQ(nullptr, image.find_domain(".no.such.domain"));
+
+    const auto * unit_domain = image.unit_domain(dyloc::myid().id);
+    ASSERT_NE(nullptr, unit_domain);
+    ASSERT_EQ(topo[dyloc::myid()].domain_tag,
+              image.string(unit_domain->tag_offset));
+    ASSERT_EQ(nullptr, image.unit_domain(-1));
+
+    auto out_edges = image.out_edges(root - image.domains());
+    for (auto edge = out_edges.first; edge != out_edges.second; ++edge) {
+      ASSERT_EQ(root - image.domains(), edge->source);
+    }
+
+    auto unit_map = snapshot.unit_map();
+    ASSERT_EQ(topo.domains().at(".").unit_ids.size(), unit_map.size());
+    dyloc::topology restored(image, unit_map);
+    ASSERT_EQ(topo[dyloc::myid()].domain_tag,
+              restored[dyloc::myid()].domain_tag);
+  }
+
+  // Concurrent writers use separate temporary files:
+  std::vector<std::thread> writers;
+  for (int w = 0; w < 4; ++w) {
+    writers.emplace_back([&]() {
+      dyloc::topology_snapshot::write(file, topo);
+    });
+  }
+  for (auto & writer : writers) {
+    writer.join();
+  }
+  {
+    dyloc::topology_snapshot snapshot(file);
+    ASSERT_EQ(topo.serialize(true).size(), snapshot.image().size());
+    snapshot.image().validate_records();
+  }
+
+  // Records are validated on access, not when the snapshot is opened:
+  auto image = topo.serialize(true);
+  {
+    dyloc::topology_image_header hdr;
+    std::memcpy(&hdr, image.data(), sizeof(hdr));
+    for (uint32_t d = 0; d < hdr.num_domains; ++d) {
+      dyloc::topology_image_domain domain_rec;
+      char * rec = image.data() + hdr.domains_offset +
+                   d * sizeof(domain_rec);
+      std::memcpy(&domain_rec, rec, sizeof(domain_rec));
+      domain_rec.tag_offset = hdr.strings_size;
+      std::memcpy(rec, &domain_rec, sizeof(domain_rec));
+    }
+    std::ofstream os(file, std::ios::binary | std::ios::trunc);
+    os.write(image.data(), image.size());
+  }
+  {
+    dyloc::topology_snapshot snapshot(file);
+    EXPECT_THROW(
+      snapshot.image().find_domain("."),
+      dyloc::exception::invalid_argument);
+    EXPECT_THROW(
+      snapshot.image().validate_records(),
+      dyloc::exception::invalid_argument);
+  }
+
+  std::remove(file.c_str());
+  EXPECT_THROW(
+    dyloc::topology_snapshot snapshot(file),
+    dyloc::exception::runtime_config_error);
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, WriteJSON) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  // Two hosts with four units each, units on every host and in every
+  // NUMA domain have consecutive ids:
+  auto unit_map = synthetic_unit_mapping(
+                    { "a", "a", "a", "a", "b", "b", "b", "b" }, 2);
+  // 4 TB of system memory, in MB:
+  unit_map.unit_localities[0].data()->hwinfo.system_memory_bytes =
+    4 * 1024 * 1024;
+  dyloc::host_topology host_topo(unit_map, { });
+  dyloc::topology topo(DART_TEAM_ALL, host_topo, unit_map);
+
+  dyloc::json_options options;
+  options.unit_ranges = true;
+  std::ostringstream os;
+  dyloc::write_json(os, topo, options);
+  DYLOC_LOG_DEBUG("TopologyTest.WriteJSON", os.str());
+
+  auto json = nlohmann::json::parse(os.str());
+
+  auto scope_name = [](dyloc_locality_scope_t scope) {
+    std::ostringstream ss;
+    ss << scope;
+    return ss.str();
+  };
+  auto json_units = [](const nlohmann::json & units) {
+    std::vector<int> unit_ids;
+    for (const auto & unit : units) {
+      if (unit.is_array()) {
+        EXPECT_EQ(2, unit.size());
+        EXPECT_LT(unit[0].get<int>(), unit[1].get<int>());
+        for (int u = unit[0]; u <= unit[1].get<int>(); ++u) {
+          unit_ids.push_back(u);
+        }
+      } else {
+        unit_ids.push_back(unit);
+      }
+    }
+    return unit_ids;
+  };
+
+  ASSERT_EQ("GLOBAL", json["scope"].get<std::string>());
+  ASSERT_EQ(4LL * 1024 * 1024 * 1024,
+            json["hwinfo"]["shmem"].get<long long>());
+  ASSERT_EQ(0,  json["level"].get<int>());
+  ASSERT_EQ(2,  json["ndomains"].get<int>());
+  ASSERT_EQ(nlohmann::json::parse("[ [0,7] ]"), json["units"]);
+  ASSERT_EQ("NODE", json["domains"][".0"]["scope"].get<std::string>());
+  ASSERT_EQ("NODE", json["domains"][".1"]["scope"].get<std::string>());
+  ASSERT_EQ(nlohmann::json::parse("[ [0,3] ]"),
+            json["domains"][".0"]["units"]);
+  ASSERT_EQ(nlohmann::json::parse("[ [4,7] ]"),
+            json["domains"][".1"]["units"]);
+
+  // Every visible domain is written once, nested in its parent domain:
+  size_t num_domains = 0;
+  std::function<void(const std::string &, const nlohmann::json &)>
+    check_domain = [&](const std::string & tag, const nlohmann::json & jd) {
+      ++num_domains;
+      const auto & domain = topo[tag];
+      ASSERT_EQ(scope_name(domain.scope), jd["scope"].get<std::string>());
+      ASSERT_EQ(domain.level,   jd["level"].get<int>());
+      ASSERT_EQ(domain.r_index, jd["idx"].get<int>());
+      std::vector<int> unit_ids;
+      for (const auto & unit_id : domain.unit_ids) {
+        unit_ids.push_back(unit_id.id);
+      }
+      ASSERT_EQ(unit_ids, json_units(jd["units"]));
+
+      std::vector<std::string> children;
+      for (auto child_vx : topo.children(topo.domain_vertices().at(tag))) {
+        const auto & child_tag = topo.graph()[child_vx].domain_tag;
+        if (topo.domains().count(child_tag) > 0) {
+          children.push_back(child_tag);
+        }
+      }
+      ASSERT_EQ(children.size(), jd["ndomains"].get<size_t>());
+      ASSERT_EQ(children.empty(), jd.find("domains") == jd.end());
+      for (const auto & child_tag : children) {
+        ASSERT_EQ(1, jd["domains"].count(child_tag));
+        check_domain(child_tag, jd["domains"][child_tag]);
+      }
+      if (domain.scope == DYLOC_LOCALITY_SCOPE_UNIT) {
+        ASSERT_EQ(domain.unit_ids[0].id,
+                  jd["unit_id"]["global_id"].get<int>());
+        ASSERT_EQ(tag, jd["unit_locality"]["domain"].get<std::string>());
+      }
+    };
+  check_domain(".", json);
+  ASSERT_EQ(topo.domains().size(), num_domains);
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, SymmetryCompression) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  // Four nodes with identical configuration of four units in two NUMA
+  // domains:
+  std::vector<std::string> unit_hosts;
+  for (const auto & host : { "a", "b", "c", "d" }) {
+    unit_hosts.insert(unit_hosts.end(), 4, host);
+  }
+  auto unit_map = synthetic_unit_mapping(unit_hosts, 2);
+  dyloc::host_topology host_topo(unit_map, { });
+  dyloc::topology explicit_topo(DART_TEAM_ALL, host_topo, unit_map);
+  setenv("DYLOC_TOPOLOGY_SYMMETRY", "compressed", 1);
+  dyloc::topology topo(DART_TEAM_ALL, host_topo, unit_map);
+  unsetenv("DYLOC_TOPOLOGY_SYMMETRY");
+
+  ASSERT_FALSE(explicit_topo.is_compressed());
+  ASSERT_TRUE(topo.is_compressed());
+  // Subtrees of three nodes are not built:
+  size_t node_subtree_size = 0;
+  for (const auto & domain : explicit_topo.domains()) {
+    if (domain.first.find(".0.") == 0) { ++node_subtree_size; }
+  }
+  ASSERT_LT(0, node_subtree_size);
+  ASSERT_EQ(explicit_topo.domains().size() - 3 * node_subtree_size,
+            topo.domains().size());
+
+  auto node_tags = topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NODE);
+  auto numa_tags = topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NUMA);
+  auto unit_tags = topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_UNIT);
+  ASSERT_EQ(4,  node_tags.size());
+  ASSERT_EQ(8,  numa_tags.size());
+  ASSERT_EQ(16, unit_tags.size());
+
+  // Domains in instances are equal to the domains in the explicit
+  // topology:
+  for (const auto & domain : explicit_topo.domains()) {
+    const auto & tag = domain.first;
+    const auto instance_domain = topo.domain(tag);
+    ASSERT_EQ(domain.second.scope,   instance_domain.scope);
+    ASSERT_EQ(domain.second.level,   instance_domain.level);
+    ASSERT_EQ(domain.second.host,    instance_domain.host);
+    ASSERT_EQ(domain.second.host_id, instance_domain.host_id);
+    ASSERT_EQ(domain.second.g_index, instance_domain.g_index);
+    ASSERT_EQ(domain.second.unit_ids.size(),
+              instance_domain.unit_ids.size());
+    for (size_t u = 0; u < domain.second.unit_ids.size(); ++u) {
+      ASSERT_EQ(domain.second.unit_ids[u].id,
+                instance_domain.unit_ids[u].id);
+    }
+    ASSERT_EQ(explicit_topo.distance(".", tag), topo.distance(".", tag));
+    ASSERT_EQ(explicit_topo.distance(tag, "."), topo.distance(tag, "."));
+  }
+  for (int u = 0; u < 16; ++u) {
+    auto unit_tag = topo.unit_domain_tag(u);
+    ASSERT_EQ(explicit_topo[dart_global_unit_t(u)].domain_tag, unit_tag);
+    ASSERT_EQ(DYLOC_LOCALITY_SCOPE_UNIT, topo.domain(unit_tag).scope);
+    ASSERT_EQ(u, topo.domain(unit_tag).unit_ids[0].id);
+    ASSERT_EQ(unit_hosts[u], topo.domain(unit_tag).host);
+  }
+  ASSERT_EQ(explicit_topo.distance(explicit_topo.unit_domain_tag(5),
+                                   explicit_topo.unit_domain_tag(14)),
+            topo.distance(topo.unit_domain_tag(5),
+                          topo.unit_domain_tag(14)));
+
+  // Domains in instances are accessed without expanding the instance,
+  // changes are retained when the instance is expanded:
+  auto num_domains = topo.domains().size();
+  auto & unit_domain = topo[dart_global_unit_t(13)];
+  ASSERT_EQ(13, unit_domain.unit_ids[0].id);
+  ASSERT_EQ("d", unit_domain.host);
+  unit_domain.num_cores = 42;
+  ASSERT_TRUE(topo.is_compressed());
+  ASSERT_EQ(num_domains, topo.domains().size());
+  ASSERT_EQ(42, topo.domain(topo.unit_domain_tag(13)).num_cores);
+
+  topo.expand();
+  ASSERT_FALSE(topo.is_compressed());
+  ASSERT_EQ(explicit_topo.domains().size(), topo.domains().size());
+  ASSERT_EQ(node_tags, topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NODE));
+  ASSERT_EQ(unit_tags.size(),
+            topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_UNIT).size());
+  ASSERT_EQ(explicit_topo[dart_global_unit_t(13)].domain_tag,
+            topo[dart_global_unit_t(13)].domain_tag);
+  ASSERT_EQ(42, topo[dart_global_unit_t(13)].num_cores);
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, TopologyCAPI) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  dyloc_topology_t topo;
+  ASSERT_EQ(DYLOC_OK, dyloc_team_topology(DART_TEAM_ALL, &topo));
+
+  const dyloc_locality_domain_t * domains;
+  int                             num_domains;
+  ASSERT_EQ(DYLOC_OK, dyloc_topology_domains(topo, &domains, &num_domains));
+  ASSERT_EQ(dyloc::team_topology().domains().size(), num_domains);
+  const dyloc_locality_domain_t * root = &domains[0];
+  ASSERT_STREQ(".", root->domain_tag);
+  ASSERT_EQ(nullptr, root->parent);
+
+  // Links between domains and tag lookup, subdomains are at higher
+  // positions than their parent:
+  for (int d = 0; d < num_domains; ++d) {
+    const auto & domain = domains[d];
+    const dyloc_locality_domain_t * tag_domain;
+    ASSERT_EQ(DYLOC_OK,
+              dyloc_topology_domain(topo, domain.domain_tag, &tag_domain));
+    ASSERT_EQ(&domain, tag_domain);
+    for (int c = 0; c < domain.arity; ++c) {
+      ASSERT_EQ(&domain, domain.children[c]->parent);
+      ASSERT_EQ(c, domain.children[c]->relative_index);
+      ASSERT_LT(&domain, domain.children[c]);
+    }
+    if (domain.parent != nullptr) {
+      ASSERT_EQ(domain.parent->level + 1, domain.level);
+    }
+  }
+  const dyloc_locality_domain_t * no_domain;
+  ASSERT_EQ(DYLOC_ERR_INVALID,
+            dyloc_topology_domain(topo, ".no.such.domain", &no_domain));
+  ASSERT_EQ(nullptr, no_domain);
+
+  const dyloc_locality_domain_t * unit_domain;
+  ASSERT_EQ(DYLOC_OK,
+            dyloc_topology_unit_domain(topo, dyloc::myid(), &unit_domain));
+  ASSERT_EQ(DYLOC_LOCALITY_SCOPE_UNIT, unit_domain->scope);
+  ASSERT_EQ(1, unit_domain->num_units);
+  ASSERT_EQ(dyloc::myid().id, unit_domain->unit_ids[0].id);
+  ASSERT_EQ(dyloc::team_topology()[dyloc::myid()].domain_tag,
+            std::string(unit_domain->domain_tag));
+  ASSERT_EQ(DYLOC_ERR_INVALID,
+            dyloc_topology_unit_domain(topo, dyloc::num_units(),
+                                       &no_domain));
+
+  const dyloc_locality_domain_t * const * unit_domains;
+  int                                     num_unit_domains;
+  ASSERT_EQ(DYLOC_OK,
+            dyloc_topology_scope_domains(
+              topo, DYLOC_LOCALITY_SCOPE_UNIT,
+              &unit_domains, &num_unit_domains));
+  ASSERT_EQ(dyloc::num_units(), num_unit_domains);
+  ASSERT_NE(unit_domains + num_unit_domains,
+            std::find(unit_domains, unit_domains + num_unit_domains,
+                      unit_domain));
+  ASSERT_EQ(DYLOC_OK,
+            dyloc_topology_scope_domains(
+              topo, DYLOC_LOCALITY_SCOPE_UNDEFINED,
+              &unit_domains, &num_unit_domains));
+  ASSERT_EQ(0, num_unit_domains);
+
+  // Lowest common ancestors along the unit domain's ancestor path:
+  const dyloc_locality_domain_t * lca;
+  ASSERT_EQ(DYLOC_OK, dyloc_topology_lca(topo, unit_domain, root, &lca));
+  ASSERT_EQ(root, lca);
+  ASSERT_EQ(DYLOC_OK,
+            dyloc_topology_lca(topo, unit_domain, unit_domain, &lca));
+  ASSERT_EQ(unit_domain, lca);
+  for (auto ancestor = unit_domain->parent; ancestor != nullptr;
+       ancestor = ancestor->parent) {
+    ASSERT_EQ(DYLOC_OK, dyloc_topology_lca(topo, ancestor, unit_domain, &lca));
+    ASSERT_EQ(ancestor, lca);
+    for (int c = 0; c < ancestor->arity; ++c) {
+      ASSERT_EQ(DYLOC_OK,
+                dyloc_topology_lca(topo, unit_domain, ancestor->children[c],
+                                   &lca));
+      ASSERT_TRUE(lca == ancestor || lca == ancestor->children[c]);
+    }
+  }
+  if (root->arity > 1) {
+    ASSERT_EQ(DYLOC_OK,
+              dyloc_topology_lca(topo, root->children[0], root->children[1],
+                                 &lca));
+    ASSERT_EQ(root, lca);
+  }
+
+  ASSERT_EQ(DYLOC_OK, dyloc_topology_destroy(&topo));
+  ASSERT_EQ(nullptr, topo);
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, DomainAllocator) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto & topo     = dyloc::team_topology();
+  auto   unit_tag = topo[dyloc::myid()].domain_tag;
+
+  dyloc::domain_allocator<int> alloc(topo, unit_tag);
+  ASSERT_EQ(1, alloc.numa_nodes().size());
+  dyloc::domain_vector<int> values(alloc);
+  values.resize(4096, 1);
+  ASSERT_EQ(4096, std::count(values.begin(), values.end(), 1));
+  ASSERT_EQ(alloc, values.get_allocator());
+  ASSERT_NE(alloc, dyloc::domain_allocator<double>(
+                     topo, unit_tag, dyloc::numa_policy::interleave));
+
+  auto buffers = dyloc::numa_buffers<double>(topo, 1024);
+  auto numa_tags = dyloc::local_numa_domain_tags(topo);
+  ASSERT_EQ(numa_tags.size(), buffers.size());
+  for (size_t b = 0; b < buffers.size(); ++b) {
+    ASSERT_EQ(1024, buffers[b].size());
+    ASSERT_EQ(numa_tags[b], buffers[b].get_allocator().domain_tag());
+  }
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, WeightedBlockSizes) {
+  typedef std::vector<size_t> sizes;
+  ASSERT_EQ(sizes({ 100, 200, 300 }),
+            dyloc::weighted_block_sizes(600, { 1, 2, 3 }));
+  // Shares 1.67, 3.33, 5, the remaining element is assigned to the
+  // block with the largest remainder:
+  ASSERT_EQ(sizes({ 2, 3, 5 }),
+            dyloc::weighted_block_sizes(10, { 1, 2, 3 }));
+  ASSERT_EQ(sizes({ 1, 1, 1, 0 }),
+            dyloc::weighted_block_sizes(3, { 1, 1, 1, 1 }));
+  // Equal block sizes unless all weights are positive:
+  ASSERT_EQ(sizes({ 4, 3, 3 }),
+            dyloc::weighted_block_sizes(10, { 0, 0, 0 }));
+  ASSERT_EQ(sizes({ 4, 3, 3 }),
+            dyloc::weighted_block_sizes(10, { 1, 0, 3 }));
+  ASSERT_EQ(sizes({ 0, 0 }),
+            dyloc::weighted_block_sizes(0, { 1, 2 }));
+  ASSERT_TRUE(dyloc::weighted_block_sizes(10, { }).empty());
+
+  const size_t total_elements = 1000003;
+  auto block_sizes = dyloc::weighted_block_sizes(
+                       total_elements, { 0.3, 1e-6, 7, 2.5 });
+  ASSERT_EQ(total_elements,
+            std::accumulate(block_sizes.begin(), block_sizes.end(),
+                            size_t(0)));
+}
+
+TEST_F(TopologyTest, Partition) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  // Four units at host "a" and two units with twice the clock rate at
+  // host "b":
+  auto unit_map = synthetic_unit_mapping(
+                    { "a", "a", "a", "a", "b", "b" }, 2);
+  for (auto & uloc : unit_map.unit_localities) {
+    auto & hw = uloc.data()->hwinfo;
+    bool at_b = std::string(hw.host) == "b";
+    hw.max_cpu_mhz       = at_b ? 2000 : 1000;
+    hw.numa_memory_bytes = 1024;
+    hw.max_shmem_mbps    = at_b ? 3000 : 1000;
+  }
+  dyloc::host_topology host_topo(unit_map, { });
+  dyloc::topology topo(DART_TEAM_ALL, host_topo, unit_map);
+
+  const size_t total_elements = 1000003;
+  for (auto policy : { dyloc::topology::weight_policy::uniform,
+                       dyloc::topology::weight_policy::num_cores,
+                       dyloc::topology::weight_policy::cpu_mhz,
+                       dyloc::topology::weight_policy::numa_memory,
+                       dyloc::topology::weight_policy::throughput }) {
+    auto blocks = topo.partition(total_elements, policy);
+    ASSERT_EQ(unit_map.size(), blocks.size());
+    size_t offset = 0;
+    for (const auto & block : blocks) {
+      ASSERT_EQ(offset, block.offset);
+      offset += block.size;
+    }
+    ASSERT_EQ(total_elements, offset);
+  }
+
+  // Block sizes follow the units' capacities in the order of the domain
+  // hierarchy:
+  auto blocks = topo.partition(total_elements,
+                               dyloc::topology::weight_policy::cpu_mhz);
+  std::vector<double> weights;
+  for (const auto & block : blocks) {
+    const auto & unit_domain = topo[block.unit];
+    weights.push_back(static_cast<double>(unit_domain.num_cores) *
+                      (unit_domain.host == "b" ? 2000 : 1000));
+  }
+  auto block_sizes = dyloc::weighted_block_sizes(total_elements, weights);
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    ASSERT_EQ(block_sizes[b], blocks[b].size);
+  }
+  // Units in a NUMA domain share its throughput, the NUMA domain at "b"
+  // and both NUMA domains at "a" contain two units:
+  blocks = topo.partition(total_elements,
+                          dyloc::topology::weight_policy::throughput);
+  weights.clear();
+  for (const auto & block : blocks) {
+    weights.push_back(topo[block.unit].host == "b" ? 1500 : 500);
+  }
+  block_sizes = dyloc::weighted_block_sizes(total_elements, weights);
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    ASSERT_EQ(block_sizes[b], blocks[b].size);
+  }
+  ASSERT_EQ("b", topo[blocks.back().unit].host);
+  ASSERT_LE(total_elements * 3 / 10,     blocks.back().size);
+  ASSERT_GE(total_elements * 3 / 10 + 1, blocks.back().size);
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, DomainIndex) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  dyloc::topology topo(dyloc::team_topology());
+
+  size_t num_indexed = 0;
+  for (int level = 0; !topo.level_domains(level).empty(); ++level) {
+    for (auto vx : topo.level_domains(level)) {
+      const auto & domain = topo.domain(vx);
+      ASSERT_EQ(level, domain.level);
+      const auto & scope_vxs = topo.scope_domains(domain.scope);
+      const auto & host_vxs  = topo.host_domains(domain.host_id);
+      ASSERT_TRUE(std::binary_search(scope_vxs.begin(), scope_vxs.end(), vx));
+      ASSERT_EQ(domain.host_id >= 0,
+                std::binary_search(host_vxs.begin(), host_vxs.end(), vx));
+      if (domain.host_id >= 0) {
+        ASSERT_EQ(&host_vxs,
+                  &topo.host_domains(dyloc::team_host_topology(),
+                                     domain.host));
+      }
+      ++num_indexed;
+    }
+  }
+  ASSERT_EQ(topo.domains().size(), num_indexed);
+  ASSERT_TRUE(topo.host_domains(dyloc::team_host_topology(),
+                                "no-such-host").empty());
+  ASSERT_TRUE(topo.host_domains(-1).empty());
+
+  auto unit_tag  = topo[dyloc::myid()].domain_tag;
+  auto numa_tags = topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NUMA);
+  ASSERT_EQ(topo.scope_domains(DYLOC_LOCALITY_SCOPE_NUMA).size(),
+            numa_tags.size());
+  ASSERT_EQ(1, topo.scope_domains(DYLOC_LOCALITY_SCOPE_GLOBAL).size());
+
+  auto num_units = topo.scope_domains(DYLOC_LOCALITY_SCOPE_UNIT).size();
+  topo.exclude_domain(unit_tag);
+  ASSERT_EQ(num_units - 1,
+            topo.scope_domains(DYLOC_LOCALITY_SCOPE_UNIT).size());
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, FilterView) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto & topo = dyloc::team_topology();
+
+  auto all_view = topo.filter(
+                    [](const dyloc::locality_domain &) { return true; });
+  size_t num_visible = 0;
+  all_view.for_each_domain([&](const dyloc::locality_domain &) {
+                             ++num_visible;
+                           });
+  ASSERT_EQ(topo.domains().size(), num_visible);
+  ASSERT_EQ(topo.domain(".").num_cores, all_view.num_cores("."));
+  ASSERT_EQ(topo.domain(".").unit_ids.size(), all_view.unit_ids(".").size());
+
+  auto unit_tag  = topo[dyloc::myid()].domain_tag;
+  auto unit_view = all_view.filter(
+                     [&](const dyloc::locality_domain & d) {
+                       return d.scope != DYLOC_LOCALITY_SCOPE_UNIT ||
+                              d.domain_tag == unit_tag;
+                     });
+  ASSERT_TRUE(unit_view.contains(unit_tag));
+  ASSERT_EQ(1, unit_view.scope_domain_tags(DYLOC_LOCALITY_SCOPE_UNIT).size());
+  auto hierarchy = unit_view.hierarchy();
+  auto vxs       = boost::vertices(hierarchy);
+  auto unit_vx   = topo.domain_vertices().at(unit_tag);
+  ASSERT_NE(vxs.second, std::find(vxs.first, vxs.second, unit_vx));
+  // Hierarchy of a temporary view remains valid:
+  auto node_hierarchy = topo.filter(
+                          [](const dyloc::locality_domain & d) {
+                            return d.scope != DYLOC_LOCALITY_SCOPE_UNIT;
+                          }).hierarchy();
+  auto node_vxs       = boost::vertices(node_hierarchy);
+  ASSERT_EQ(node_vxs.second,
+            std::find(node_vxs.first, node_vxs.second, unit_vx));
+  ASSERT_NE(node_vxs.second,
+            std::find(node_vxs.first, node_vxs.second,
+                      topo.domain_vertices().at(".")));
+  auto unit_ids = unit_view.unit_ids(".");
+  ASSERT_EQ(1,                unit_ids.size());
+  ASSERT_EQ(dyloc::myid().id, unit_ids.front().id);
+
+  auto no_view = unit_view.filter(
+                   [](const dyloc::locality_domain & d) {
+                     return d.scope != DYLOC_LOCALITY_SCOPE_NODE;
+                   });
+  ASSERT_FALSE(no_view.contains(unit_tag));
+  ASSERT_EQ(0, no_view.num_cores("."));
+  ASSERT_EQ(topo.domains().size(), num_visible);
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, FrozenTopology) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto & topo   = dyloc::team_topology();
+  auto   frozen = topo.freeze();
+
+  ASSERT_EQ(topo.domains().size(), frozen.size());
+  ASSERT_EQ(0,            frozen.index("."));
+  ASSERT_EQ(-1,           frozen.parent(0));
+  ASSERT_EQ(frozen.size(), frozen.subtree_end(0));
+
+  for (int d = 0; d < frozen.size(); ++d) {
+    const auto & domain = topo.domain(frozen.domain_tag(d));
+    ASSERT_EQ(d,                       frozen.index(domain.domain_tag));
+    ASSERT_EQ(domain.scope,            frozen.scope(d));
+    ASSERT_EQ(domain.num_cores,        frozen.num_cores(d));
+    ASSERT_EQ(domain.unit_ids.size(),  frozen.num_units(d));
+    for (int sub_d : frozen.children(d)) {
+      ASSERT_EQ(d, frozen.parent(sub_d));
+      ASSERT_TRUE(frozen.is_ancestor(d, sub_d));
+    }
+  }
+
+  int unit_d = frozen.unit_index(dyloc::myid());
+  ASSERT_EQ(topo[dyloc::myid()].domain_tag, frozen.domain_tag(unit_d));
+  ASSERT_EQ(0, frozen.ancestor(unit_d, 0));
+
+  int num_discovered = 0;
+  int num_finished   = 0;
+  frozen.depth_first_search(0,
+    [&](int) { ++num_discovered; },
+    [&](int d) {
+      ASSERT_EQ(frozen.subtree_end(d) - d, num_discovered - d);
+      ++num_finished;
+    });
+  ASSERT_EQ(frozen.size(), num_discovered);
+  ASSERT_EQ(frozen.size(), num_finished);
+
+  int node_d = frozen.find_ancestor(unit_d, [&](int d) {
+                 return frozen.scope(d) == DYLOC_LOCALITY_SCOPE_NODE;
+               });
+  ASSERT_LE(0, node_d);
+  ASSERT_EQ(node_d, frozen.find_descendant(0, [&](int d) {
+                      return frozen.domain_tag(d) ==
+                             frozen.domain_tag(node_d);
+                    }));
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, Compact) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  dyloc::topology topo(dyloc::team_topology());
+
+  auto unit_tag = topo[dyloc::myid()].domain_tag;
+  auto root_vx  = topo.domain_vertices().at(".");
+  auto level_1  = topo.level_domains(1);
+  topo.exclude_domain(unit_tag);
+  ASSERT_LT(topo.domains().size(), boost::num_vertices(topo.graph()));
+  // Vertices are not renumbered until the topology is compacted:
+  ASSERT_EQ(root_vx, topo.domain_vertices().at("."));
+  ASSERT_EQ(level_1, topo.level_domains(1));
+
+  auto num_removed = topo.compact();
+  ASSERT_LT(0, num_removed);
+  ASSERT_EQ(0, topo.compact());
+  ASSERT_EQ(topo.domains().size(), boost::num_vertices(topo.graph()));
+  ASSERT_EQ(topo.domains().size(), topo.domain_vertices().size());
+  ASSERT_EQ(0, topo.domain_vertices().count(unit_tag));
+  for (const auto & domain_vx : topo.domain_vertices()) {
+    ASSERT_EQ(domain_vx.first, topo.graph()[domain_vx.second].domain_tag);
+  }
+  size_t num_indexed = 0;
+  for (int level = 0; !topo.level_domains(level).empty(); ++level) {
+    for (auto vx : topo.level_domains(level)) {
+      ASSERT_EQ(level, topo.domain(vx).level);
+      ++num_indexed;
+    }
+  }
+  ASSERT_EQ(topo.domains().size(), num_indexed);
+  ASSERT_EQ(topo.domains().size(), topo.freeze().size());
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, HierarchyRanges) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto & topo   = dyloc::team_topology();
+  auto   frozen = topo.freeze();
+  auto   root   = topo.domain_vertices().at(".");
+
+  std::vector<std::string> pre_order_tags;
+  for (auto vx : topo.descendants(root)) {
+    pre_order_tags.push_back(topo.graph()[vx].domain_tag);
+  }
+  std::vector<std::string> post_order_tags;
+  for (auto vx : topo.descendants_inv(root)) {
+    post_order_tags.push_back(topo.graph()[vx].domain_tag);
+  }
+  std::vector<std::string> frozen_pre_tags;
+  std::vector<std::string> frozen_post_tags;
+  frozen.depth_first_search(0,
+    [&](int d) { frozen_pre_tags.push_back(frozen.domain_tag(d)); },
+    [&](int d) { frozen_post_tags.push_back(frozen.domain_tag(d)); });
+  frozen_pre_tags.erase(frozen_pre_tags.begin());
+  frozen_post_tags.pop_back();
+  ASSERT_EQ(frozen_pre_tags,  pre_order_tags);
+  ASSERT_EQ(frozen_post_tags, post_order_tags);
 
+  // Iterators of a range share its traversal:
+  auto desc_range = topo.descendants(root);
+  auto desc_it    = desc_range.begin();
+  auto desc_copy  = desc_it;
+  ASSERT_EQ(pre_order_tags[0], topo.graph()[*desc_it++].domain_tag);
+  ASSERT_EQ(desc_it, desc_copy);
+  if (pre_order_tags.size() > 1) {
+    ASSERT_EQ(pre_order_tags[1], topo.graph()[*desc_copy].domain_tag);
+  }
+  std::vector<std::string> post_order_visited;
+  topo.for_each_descendant_inv(".", [&](const locality_domain & domain) {
+                                 post_order_visited.push_back(
+                                   domain.domain_tag);
+                               });
+  ASSERT_EQ(post_order_tags, post_order_visited);
 
+  auto root_children = topo.children(root);
+  ASSERT_EQ(frozen.children(0).size(),
+            std::distance(root_children.begin(), root_children.end()));
+
+  auto unit_vx        = topo.domain_vertices().at(
+                          topo[dyloc::myid()].domain_tag);
+  auto unit_ancestors = topo.ancestors(unit_vx);
+  ASSERT_EQ(topo.domain(unit_vx).level,
+            std::distance(unit_ancestors.begin(), unit_ancestors.end()));
+  ASSERT_NE(unit_ancestors.end(),
+            std::find(unit_ancestors.begin(), unit_ancestors.end(), root));
+  ASSERT_TRUE(topo.descendants(unit_vx).empty());
+  ASSERT_TRUE(topo.descendants_inv(unit_vx).empty());
+
+  // Unknown tags are not inserted as empty domains:
+  auto num_domains = topo.domains().size();
+  ASSERT_THROW(topo[".no.such.domain"], dyloc::exception::invalid_argument);
+  ASSERT_EQ(num_domains, topo.domains().size());
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, SelectDomain) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto & team_topo = dyloc::team_topology();
+  auto   unit_tag  = team_topo[dyloc::myid()].domain_tag;
+  auto   numa_tags = team_topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NUMA);
+  ASSERT_FALSE(numa_tags.empty());
+
+  dyloc::topology topo(team_topo);
+  topo.select_domain(numa_tags.front());
+  ASSERT_EQ(1,  topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NUMA).size());
+  ASSERT_EQ(numa_tags.front(),
+            topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_NUMA).front());
+  ASSERT_EQ(topo.domains().size(), topo.freeze().size());
+  int num_unit_cores = 0;
+  for (const auto & unit_domain_tag :
+         topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_UNIT)) {
+    num_unit_cores += topo.domain(unit_domain_tag).num_cores;
+  }
+  ASSERT_EQ(num_unit_cores,                  topo.domain(".").num_cores);
+  ASSERT_EQ(topo.domain(numa_tags.front()).num_cores,
+            topo.domain(".").num_cores);
+
+  // Excluding a domain and its subdomain:
+  dyloc::topology excl_topo(team_topo);
+  std::vector<std::string> excl_tags {
+    numa_tags.front(),
+    excl_topo.unit_domain_tag(dyloc::myid())
+  };
+  excl_topo.exclude_domains(excl_tags.begin(), excl_tags.end());
+  ASSERT_EQ(0, excl_topo.domains().count(numa_tags.front()));
+  ASSERT_EQ(0, excl_topo.domains().count(unit_tag));
+  ASSERT_EQ(excl_topo.domains().size(), excl_topo.freeze().size());
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, ExcludeUnitDomain) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto unit_map = synthetic_unit_mapping({ "a", "a", "a", "a" }, 2);
+  dyloc::host_topology host_topo(unit_map, { });
+  dyloc::topology topo(DART_TEAM_ALL, host_topo, unit_map);
+
+  // Topology is not compacted automatically by default:
+  dart_global_unit_t excl_unit(3);
+  auto excl_tag = topo.unit_domain_tag(excl_unit);
+  auto core_tag = excl_tag.substr(0, excl_tag.find_last_of('.'));
+  topo.exclude_domain(core_tag);
+  ASSERT_EQ(0, topo.domains().count(excl_tag));
+  ASSERT_THROW(topo.unit_domain_tag(excl_unit),
+               dyloc::exception::invalid_argument);
+  for (int u = 0; u < 3; ++u) {
+    ASSERT_EQ(1, topo.domains().count(
+                   topo.unit_domain_tag(dart_global_unit_t(u))));
+  }
+
+  topo.measure_latencies(
+    [](int cpu_a, int cpu_b) {
+      return (cpu_a / 2 == cpu_b / 2) ? 30 : 120;
+    });
+  ASSERT_EQ(30,  topo.distance(topo.unit_domain_tag(dart_global_unit_t(0)),
+                               topo.unit_domain_tag(dart_global_unit_t(1))));
+  ASSERT_EQ(120, topo.distance(topo.unit_domain_tag(dart_global_unit_t(0)),
+                               topo.unit_domain_tag(dart_global_unit_t(2))));
+  dyloc::finalize();
+}
+
+#ifdef DYLOC_ENABLE_HWLOC
+TEST_F(TopologyTest, HwlocView) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  const auto & team_topo = dyloc::team_topology();
+  auto load_host_topology = []() {
+      hwloc_topology_t hwloc_topo;
+      hwloc_topology_init(&hwloc_topo);
+      hwloc_topology_load(hwloc_topo);
+      return hwloc_topo;
+    };
+  hwloc_topology_t host_topo  = load_host_topology();
+  hwloc_cpuset_t   host_cpuset = hwloc_get_root_obj(host_topo)->cpuset;
+
+  // Views contain the CPUs of domains with units, equal to the CPUs of
+  // their hwloc objects if every core at the host is assigned to a unit:
+  const std::string my_host(team_topo[dyloc::myid()].host);
+  int num_host_units = 0;
+  for (const auto & unit_tag :
+         team_topo.scope_domain_tags(DYLOC_LOCALITY_SCOPE_UNIT)) {
+    if (team_topo[unit_tag].host == my_host) { ++num_host_units; }
+  }
+  bool all_cores_assigned =
+    num_host_units == hwloc_get_nbobjs_by_type(host_topo, HWLOC_OBJ_CORE);
+  auto assert_view_cpuset = [&](hwloc_topology_t    view_topo,
+                                hwloc_const_cpuset_t expected_cpuset) {
+      auto view_cpuset = hwloc_get_root_obj(view_topo)->cpuset;
+      ASSERT_FALSE(hwloc_bitmap_iszero(view_cpuset));
+      ASSERT_TRUE(hwloc_bitmap_isincluded(view_cpuset, expected_cpuset));
+      if (all_cores_assigned) {
+        ASSERT_TRUE(hwloc_bitmap_isequal(view_cpuset, expected_cpuset));
+      }
+    };
+
+  hwloc_topology_t full_view = load_host_topology();
+  full_view << team_topo;
+  assert_view_cpuset(full_view, host_cpuset);
+  hwloc_topology_destroy(full_view);
+
+  // View restricted to the NUMA domain of the calling unit:
+  const locality_domain * numa_domain = nullptr;
+  for (auto vx : team_topo.ancestors(
+                   team_topo.domain_vertices().at(
+                     team_topo[dyloc::myid()].domain_tag))) {
+    if (team_topo.graph()[vx].state != topology::vertex_state::hidden &&
+        team_topo[team_topo.graph()[vx].domain_tag].scope ==
+          DYLOC_LOCALITY_SCOPE_NUMA) {
+      numa_domain = team_topo.visible_domain(vx);
+      break;
+    }
+  }
+  ASSERT_NE(nullptr, numa_domain);
+  hwloc_obj_t numa_obj = hwloc_get_obj_by_type(
+                           host_topo, HWLOC_OBJ_NUMANODE,
+                           numa_domain->g_index);
+  hwloc_cpuset_t numa_cpuset = (numa_obj != nullptr)
+                               ? numa_obj->cpuset
+                               : host_cpuset;
+
+  dyloc::topology numa_topo(team_topo);
+  numa_topo.select_domain(numa_domain->domain_tag);
+  hwloc_topology_t numa_view = load_host_topology();
+  numa_view << numa_topo;
+  assert_view_cpuset(numa_view, numa_cpuset);
+  hwloc_topology_destroy(numa_view);
+
+  // View without domains at the host leaves the topology unchanged:
+  dyloc::topology hidden_topo(team_topo);
+  hidden_topo.exclude_domain(".");
+  hwloc_topology_t hidden_view = load_host_topology();
+  hidden_view << hidden_topo;
+  ASSERT_TRUE(hwloc_bitmap_isequal(
+                host_cpuset, hwloc_get_root_obj(hidden_view)->cpuset));
+  hwloc_topology_destroy(hidden_view);
+
+  hwloc_topology_destroy(host_topo);
+  dyloc::finalize();
+}
+#endif // DYLOC_ENABLE_HWLOC
+
+TEST_F(TopologyTest, VersionedTopology) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto unit_tag = dyloc::team_topology()[dyloc::myid()].domain_tag;
+  dyloc::versioned_topology vtopo(dyloc::topology(dyloc::team_topology()));
+  ASSERT_EQ(1, vtopo.version_number());
+
+  std::atomic<bool>        done(false);
+  std::atomic<int>         num_inconsistent(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&]() {
+      while (!done.load()) {
+        auto number = vtopo.version_number();
+        auto topo   = vtopo.snapshot();
+        // Snapshot is at least as recent as the version number:
+        if (topo->domains().count(".") == 0 ||
+            (number > 1 && topo->domains().count(unit_tag) > 0)) {
+          ++num_inconsistent;
+        }
+      }
+    });
+  }
+  auto number = vtopo.update([&](dyloc::topology & topo) {
+                                topo.exclude_domain(unit_tag);
+                              });
+  ASSERT_EQ(2, number);
+  done.store(true);
+  for (auto & reader : readers) {
+    reader.join();
+  }
+  ASSERT_EQ(0, num_inconsistent.load());
+  ASSERT_EQ(0, vtopo.snapshot()->domains().count(unit_tag));
+
+  // Versions keep the unit mapping they have been published with:
+  auto myid      = dyloc::myid(DART_TEAM_ALL);
+  auto published = vtopo.snapshot();
+  auto moved_map = std::make_shared<dyloc::unit_mapping>(
+                     published->unit_map());
+  auto core_id   = published->unit_map()[myid].data()->hwinfo.core_id;
+  (*moved_map)[myid].data()->hwinfo.core_id = core_id + 1;
+  ASSERT_EQ(3, vtopo.update([&](dyloc::topology & topo) {
+                               topo.replace_unit_map(moved_map);
+                             }));
+  ASSERT_EQ(core_id,
+            published->unit_map()[myid].data()->hwinfo.core_id);
+  ASSERT_EQ(core_id + 1,
+            vtopo.snapshot()->unit_map()[myid].data()->hwinfo.core_id);
+  ASSERT_EQ(&dyloc::team_topology().unit_map(),
+            dyloc::team_topology_snapshot()->shared_unit_map().get());
+
+  auto snapshot = dyloc::team_topology_snapshot();
+  ASSERT_EQ(1, snapshot->domains().count(unit_tag));
+  ASSERT_EQ(2, dyloc::publish_team_topology());
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, UnitMigration) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  dyloc::topology topo(dyloc::team_topology());
+  auto num_domains = topo.domains().size();
+  auto num_cores   = topo.domains().at(".").num_cores;
+
+  // Move the unit to a core that is not contained in the topology:
+  dyloc::unit_mapping unit_map(DART_TEAM_ALL);
+  dyloc_hwinfo_t unit_hwinfo = unit_map[dyloc::myid(DART_TEAM_ALL)]
+                                 .data()->hwinfo;
+  unit_hwinfo.scopes[0].index = 99;
+  topo.move_unit_domain(dyloc::myid(), unit_hwinfo);
+
+  const auto & unit_dom = topo[dyloc::myid()];
+  auto unit_vx   = topo.domain_vertices().at(unit_dom.domain_tag);
+  auto parent_vx = *topo.ancestors(unit_vx).begin();
+  const auto & core_dom = topo.domains().at(
+                            topo.graph()[parent_vx].domain_tag);
+  ASSERT_EQ(DYLOC_LOCALITY_SCOPE_CORE, core_dom.scope);
+  ASSERT_EQ(99, core_dom.g_index);
+  // Previous core domain only contained the unit and has been replaced:
+  ASSERT_EQ(num_domains, topo.domains().size());
+  ASSERT_EQ(num_cores,   topo.domains().at(".").num_cores);
+  ASSERT_EQ(topo.domains().size(), topo.freeze().size());
+
+  // Move a unit to a core without CACHE domain, one level above its
+  // previous CORE domain:
+  auto synth_map = synthetic_unit_mapping({ "a", "a", "a", "a" }, 2);
+  dyloc::host_topology synth_host_topo(synth_map, { });
+  dyloc::topology      synth_topo(DART_TEAM_ALL, synth_host_topo, synth_map);
+  dart_global_unit_t   moved_unit(3);
+  int  old_level   = synth_topo[moved_unit].level;
+  auto moved_hwinfo = synth_map[dart_team_unit_t(3)].data()->hwinfo;
+  moved_hwinfo.num_scopes = 2;
+  moved_hwinfo.scopes[0]  = { DYLOC_LOCALITY_SCOPE_CORE, 7 };
+  moved_hwinfo.scopes[1]  = { DYLOC_LOCALITY_SCOPE_NUMA, 1 };
+  synth_topo.move_unit_domain(moved_unit, moved_hwinfo);
+
+  auto moved_vx = synth_topo.domain_vertices().at(
+                    synth_topo.unit_domain_tag(moved_unit));
+  int  new_level = synth_topo[moved_unit].level;
+  ASSERT_EQ(old_level - 1, new_level);
+  ASSERT_EQ(synth_topo.domain(*synth_topo.ancestors(moved_vx).begin()).level
+              + 1,
+            new_level);
+  const auto & new_level_vxs = synth_topo.level_domains(new_level);
+  const auto & old_level_vxs = synth_topo.level_domains(old_level);
+  ASSERT_NE(new_level_vxs.end(),
+            std::find(new_level_vxs.begin(), new_level_vxs.end(), moved_vx));
+  ASSERT_EQ(old_level_vxs.end(),
+            std::find(old_level_vxs.begin(), old_level_vxs.end(), moved_vx));
+  for (int level = 0; !synth_topo.level_domains(level).empty(); ++level) {
+    for (auto vx : synth_topo.level_domains(level)) {
+      ASSERT_EQ(level, synth_topo.domain(vx).level);
+    }
+  }
+
+  auto placement = dyloc::unit_placement::sample();
+  ASSERT_FALSE(dyloc::is_migrated(placement, placement));
+  ASSERT_FALSE(dyloc::refresh_unit_locality());
+  dyloc::finalize();
+}
+
+TEST_F(TopologyTest, ResyncUnitLocalities) {
+  dyloc::init(&TESTENV.argc, &TESTENV.argv);
+  auto version = dyloc::team_topology_snapshot();
+  // No unit has been moved, nothing is exchanged or published:
+  ASSERT_EQ(0, dyloc::resync_unit_localities());
+  ASSERT_EQ(version, dyloc::team_topology_snapshot());
+  // Refreshing the calling unit's locality is not collective and never
+  // publishes a version:
+  dyloc::refresh_unit_locality();
+  ASSERT_EQ(version, dyloc::team_topology_snapshot());
+
+  // Updated locality of a single unit is applied at every unit:
+  dyloc::unit_mapping unit_map(DART_TEAM_ALL);
+  auto myid = dyloc::myid(DART_TEAM_ALL);
+  dyloc_hwinfo_t moved_hwinfo = unit_map[myid].data()->hwinfo;
+  moved_hwinfo.scopes[0].index = 99;
+  moved_hwinfo.core_id         = 99;
+  auto moved_units = unit_map.resync(myid.id == 0 ? &moved_hwinfo
+                                                  : nullptr);
+  ASSERT_EQ(1, moved_units.size());
+  ASSERT_EQ(0, moved_units.front().id);
+  dart_team_unit_t unit_0 = { 0 };
+  ASSERT_EQ(99, unit_map[unit_0].data()->hwinfo.core_id);
+  ASSERT_EQ(99, unit_map[unit_0].data()->hwinfo.scopes[0].index);
+  dyloc::finalize();
+}
 
 } // namespace dyloc
 } // namespace test
-
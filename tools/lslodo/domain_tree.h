@@ -0,0 +1,497 @@
+#ifndef LSLODO__DOMAIN_TREE_H__INCLUDED
+#define LSLODO__DOMAIN_TREE_H__INCLUDED
+
+/*
+ * Parser and layout of locality domain hierarchies in JSON format,
+ * shared by lslodo and its tests.
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+
+static const int unit_w    = 170;
+static const int unit_h    = 77;
+static const int pad       = 11;
+static const int label_h   = 60;
+
+typedef struct rect_s {
+  int x;
+  int y;
+  int w;
+  int h;
+} rect_t;
+
+/*
+ * Domain in the compact tree, properties not rendered are discarded
+ * while parsing.
+ */
+typedef struct domain_node_s {
+  std::string tag;
+  int         scope        = -1;
+  int         host         = -1;
+  int         level        = -1;
+  int         numa_id      = -1;
+  long        shmem_kb     = -1;
+  int         unit_id      = -1;
+  int         cpu_id       = -1;
+  int         num_cores    = -1;
+  int         num_threads  = -1;
+  bool        has_domains  = false;
+  /* Number of domains represented by this domain if siblings have been
+   * folded into it, 0 if folded into a preceding sibling: */
+  int         multiplicity = 1;
+  /* Structure and capacities of the domain's subtree: */
+  int         signature    = -1;
+  /* Unit ids as ranges of consecutive ids: */
+  std::vector<std::pair<int, int> > units;
+  int         num_domains  = 0;
+  int         first_child  = -1;
+  int         last_child   = -1;
+  int         next_sibling = -1;
+  /* Position relative to parent domain and size: */
+  rect_t      rect         = { 0, 0, 0, 0 };
+} domain_node_t;
+
+/* Interned strings, referenced by index in domain nodes: */
+class string_table {
+  std::vector<std::string>             _strings;
+  std::unordered_map<std::string, int> _ids;
+
+ public:
+  int id(const std::string & str) {
+    auto it = _ids.find(str);
+    if (it != _ids.end()) {
+      return it->second;
+    }
+    _strings.push_back(str);
+    _ids[str] = _strings.size() - 1;
+    return _strings.size() - 1;
+  }
+
+  const std::string & operator[](int id) const {
+    static const std::string undefined = "?";
+    return (id < 0) ? undefined : _strings[id];
+  }
+};
+
+/*
+ * Pull parser reading JSON from a buffered input file.
+ * Values not required for rendering are skipped without storing them.
+ */
+class json_reader {
+  std::FILE *       _file;
+  std::vector<char> _buf;
+  size_t            _pos  = 0;
+  size_t            _end  = 0;
+  long              _line = 1;
+
+ public:
+  explicit json_reader(std::FILE * file)
+  : _file(file)
+  , _buf(1 << 16)
+  { }
+
+  /* Calls element() for every element in the array at the current
+   * position, which must consume the element's value: */
+  template <class ElementFunc>
+  void array(ElementFunc element) {
+    expect('[');
+    if (next() == ']') { get(); return; }
+    do {
+      element();
+    } while (more(']'));
+  }
+
+  int peek() {
+    if (_pos == _end) {
+      _end = std::fread(_buf.data(), 1, _buf.size(), _file);
+      _pos = 0;
+      if (_end == 0) { return EOF; }
+    }
+    return static_cast<unsigned char>(_buf[_pos]);
+  }
+
+  int get() {
+    int c = peek();
+    if (c != EOF) { ++_pos; }
+    if (c == '\n') { ++_line; }
+    return c;
+  }
+
+  int next() {
+    skip_ws();
+    return peek();
+  }
+
+  void skip_ws() {
+    for (int c = peek(); c == ' ' || c == '\n' || c == '\r' || c == '\t';
+         c = peek()) {
+      get();
+    }
+  }
+
+  void expect(char expected) {
+    skip_ws();
+    int c = get();
+    if (c != expected) {
+      fail(std::string("expected '") + expected + "'");
+    }
+  }
+
+  /* Consumes separator or end of object/array, returns false at end: */
+  bool more(char end) {
+    int c = next();
+    if (c == ',') { get(); return true; }
+    if (c == end) { get(); return false; }
+    fail(std::string("expected ',' or '") + end + "'");
+    return false;
+  }
+
+  std::string string() {
+    expect('"');
+    std::string str;
+    for (int c = get(); c != '"'; c = get()) {
+      if (c == EOF) { fail("unterminated string"); }
+      if (c == '\\') {
+        c = get();
+        switch (c) {
+          case 'n': c = '\n'; break;
+          case 't': c = '\t'; break;
+          case 'r': c = '\r'; break;
+          case 'b': c = '\b'; break;
+          case 'f': c = '\f'; break;
+          case 'u': {
+            long code_point = hex4();
+            // Characters outside the BMP are escaped as surrogate pair:
+            if (code_point >= 0xd800 && code_point <= 0xdbff &&
+                peek() == '\\') {
+              get();
+              if (get() != 'u') { fail("expected low surrogate"); }
+              long low = hex4();
+              code_point = (low >= 0xdc00 && low <= 0xdfff)
+                           ? 0x10000 + ((code_point - 0xd800) << 10)
+                                     + (low - 0xdc00)
+                           : 0xfffd;
+            } else if (code_point >= 0xd800 && code_point <= 0xdfff) {
+              code_point = 0xfffd;
+            }
+            append_utf8(str, code_point);
+            continue;
+          }
+          default: break;
+        }
+      }
+      str.push_back(static_cast<char>(c));
+    }
+    return str;
+  }
+
+  /* Four hex digits of a \u escape sequence: */
+  long hex4() {
+    char hex[5] = { 0 };
+    for (int i = 0; i < 4; ++i) {
+      int c = get();
+      if (!std::isxdigit(c)) { fail("invalid \\u escape sequence"); }
+      hex[i] = static_cast<char>(c);
+    }
+    return std::strtol(hex, nullptr, 16);
+  }
+
+  static void append_utf8(std::string & str, long code_point) {
+    if (code_point < 0x80) {
+      str.push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+      str.push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+      str.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    } else if (code_point < 0x10000) {
+      str.push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+      str.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+      str.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    } else {
+      str.push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+      str.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+      str.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+      str.push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+    }
+  }
+
+  long number() {
+    skip_ws();
+    std::string num;
+    for (int c = peek();
+         c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E' ||
+         (c >= '0' && c <= '9');
+         c = peek()) {
+      num.push_back(static_cast<char>(get()));
+    }
+    if (num.empty()) { fail("expected number"); }
+    return static_cast<long>(std::strtod(num.c_str(), nullptr));
+  }
+
+  void skip_value() {
+    int c = next();
+    if (c == '"') {
+      string();
+    } else if (c == '{') {
+      get();
+      if (next() == '}') { get(); return; }
+      do {
+        string();
+        expect(':');
+        skip_value();
+      } while (more('}'));
+    } else if (c == '[') {
+      get();
+      if (next() == ']') { get(); return; }
+      do {
+        skip_value();
+      } while (more(']'));
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+      number();
+    } else {
+      // Literals true, false, null:
+      while (std::isalpha(peek())) { get(); }
+    }
+  }
+
+  /* Calls object_key(key) for every key in the object at the current
+   * position, which must consume the key's value: */
+  template <class KeyFunc>
+  void object(KeyFunc object_key) {
+    expect('{');
+    if (next() == '}') { get(); return; }
+    do {
+      auto key = string();
+      expect(':');
+      object_key(key);
+    } while (more('}'));
+  }
+
+  [[noreturn]] void fail(const std::string & msg) {
+    std::cerr << "lslodo: parse error in line " << _line << ": " << msg
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+};
+
+class domain_tree {
+  std::vector<domain_node_t>           _nodes;
+  string_table                         _scopes;
+  string_table                         _hosts;
+  std::unordered_map<std::string, int> _signatures;
+
+ public:
+  const domain_node_t & operator[](int d) const { return _nodes[d]; }
+
+  const std::string & scope(const domain_node_t & node) const {
+    return _scopes[node.scope];
+  }
+
+  const std::string & host(const domain_node_t & node) const {
+    return _hosts[node.host];
+  }
+
+  size_t size() const { return _nodes.size(); }
+
+  void read(json_reader & json) {
+    parse_domain(json, ".", -1);
+  }
+
+  /* Folds runs of consecutive sibling domains with identical signature
+   * into their first domain, except for domains that contain one of the
+   * specified domain tags. Returns whether the subtree contains an
+   * expanded domain. */
+  bool fold(
+    const std::unordered_set<std::string> & expand_tags,
+    int                                     d = 0) {
+    bool expanded = expand_tags.count(_nodes[d].tag) > 0;
+    std::string signature = std::to_string(_nodes[d].scope) + ":" +
+                            std::to_string(_nodes[d].num_cores) + ":" +
+                            std::to_string(_nodes[d].num_threads) + ":" +
+                            std::to_string(_nodes[d].shmem_kb) + ":" +
+                            (_nodes[d].has_domains ? "(" : "");
+    int run_first = -1;
+    for (int c = _nodes[d].first_child; c >= 0; c = _nodes[c].next_sibling) {
+      bool child_expanded = fold(expand_tags, c);
+      expanded  = expanded || child_expanded;
+      signature += std::to_string(_nodes[c].signature) + ",";
+      if (child_expanded) {
+        run_first = -1;
+        continue;
+      }
+      if (run_first >= 0 &&
+          _nodes[run_first].signature == _nodes[c].signature) {
+        _nodes[run_first].multiplicity++;
+        _nodes[c].multiplicity = 0;
+        merge_units(_nodes[run_first].units, _nodes[c].units);
+      } else {
+        run_first = c;
+      }
+    }
+    auto sig_it = _signatures.find(signature);
+    if (sig_it == _signatures.end()) {
+      sig_it = _signatures.insert(
+                 std::make_pair(signature, _signatures.size())).first;
+    }
+    _nodes[d].signature = sig_it->second;
+    return expanded;
+  }
+
+  /* Computes sizes of domains and their positions relative to their
+   * parent domain in post-order: */
+  void layout(int d = 0) {
+    auto & node  = _nodes[d];
+    const auto & scope_name = _scopes[node.scope];
+    int  num_visible = 0;
+    for (int c = node.first_child; c >= 0; c = _nodes[c].next_sibling) {
+      if (_nodes[c].multiplicity > 0) { ++num_visible; }
+    }
+    bool vertical = !(scope_name == "NUMA" || scope_name == "CACHE" ||
+                      scope_name == "PACKAGE");
+    bool nested   = !(scope_name == "CACHE" && num_visible > 0);
+    int  w        = 0;
+    int  h        = 0;
+    int  d_idx    = 0;
+    for (int c = node.first_child; c >= 0; c = _nodes[c].next_sibling) {
+      if (_nodes[c].multiplicity == 0) { continue; }
+      layout(c);
+      auto & child = _nodes[c];
+      int    sep   = (d_idx < num_visible - 1) ? pad : 0;
+      if (nested && vertical) {
+        child.rect.x = pad;
+        child.rect.y = h + label_h;
+        h += child.rect.h + sep;
+        w  = std::max(w, child.rect.w);
+      } else {
+        child.rect.x = w + (nested ? pad : 0);
+        child.rect.y = label_h;
+        w += child.rect.w + sep;
+        h  = std::max(h, child.rect.h);
+      }
+      ++d_idx;
+    }
+    if (node.has_domains) {
+      if (nested) {
+        w += 2 * pad;
+        h += label_h + pad;
+      } else {
+        h += label_h;
+      }
+    }
+    if (scope_name == "CORE" || scope_name == "UNIT") {
+      w = unit_w;
+      h = unit_h;
+    }
+    node.rect.w = w;
+    node.rect.h = h;
+  }
+
+ private:
+  static void merge_units(
+    std::vector<std::pair<int, int> >       & units,
+    const std::vector<std::pair<int, int> > & more_units) {
+    for (const auto & range : more_units) {
+      if (!units.empty() && units.back().second + 1 == range.first) {
+        units.back().second = range.second;
+      } else {
+        units.push_back(range);
+      }
+    }
+  }
+
+  void parse_hwinfo(json_reader & json, domain_node_t & node) {
+    json.object([&](const std::string & key) {
+        if      (key == "numa_id")   { node.numa_id   = json.number(); }
+        else if (key == "shmem")     { node.shmem_kb  = json.number(); }
+        else if (key == "num_cores") { node.num_cores = json.number(); }
+        else if (key == "cpu_id")    { node.cpu_id    = json.number(); }
+        else if (key == "threads") {
+          json.object([&](const std::string & tkey) {
+              if (tkey == "max") { node.num_threads = json.number(); }
+              else               { json.skip_value(); }
+            });
+        }
+        else { json.skip_value(); }
+      });
+  }
+
+  int parse_domain(json_reader & json, const std::string & tag, int parent) {
+    int d = _nodes.size();
+    _nodes.push_back(domain_node_t());
+    _nodes[d].tag = tag;
+    if (parent >= 0) {
+      auto & parent_node = _nodes[parent];
+      if (parent_node.last_child >= 0) {
+        _nodes[parent_node.last_child].next_sibling = d;
+      } else {
+        parent_node.first_child = d;
+      }
+      parent_node.last_child = d;
+      parent_node.num_domains++;
+    }
+    // Domain hwinfo takes precedence over hwinfo of unit locality:
+    domain_node_t unit_node;
+    json.object([&](const std::string & key) {
+        // Note that _nodes may be reallocated while parsing subdomains.
+        if      (key == "scope") { _nodes[d].scope = _scopes.id(json.string()); }
+        else if (key == "host")  { _nodes[d].host  = _hosts.id(json.string()); }
+        else if (key == "level") { _nodes[d].level = json.number(); }
+        else if (key == "units") {
+          std::vector<std::pair<int, int> > units;
+          json.array([&]() {
+              // Unit ids are numbers or ranges [first,last]:
+              if (json.next() == '[') {
+                json.expect('[');
+                int first = json.number();
+                json.expect(',');
+                int last  = json.number();
+                json.expect(']');
+                merge_units(units, { std::make_pair(first, last) });
+              } else {
+                int unit_id = json.number();
+                merge_units(units, { std::make_pair(unit_id, unit_id) });
+              }
+            });
+          _nodes[d].units = std::move(units);
+        }
+        else if (key == "hwinfo") {
+          parse_hwinfo(json, _nodes[d]);
+        }
+        else if (key == "unit_locality") {
+          json.object([&](const std::string & ukey) {
+              if (ukey == "hwinfo") { parse_hwinfo(json, unit_node); }
+              else                  { json.skip_value(); }
+            });
+        }
+        else if (key == "unit_id") {
+          json.object([&](const std::string & ukey) {
+              if (ukey == "local_id") { _nodes[d].unit_id = json.number(); }
+              else                    { json.skip_value(); }
+            });
+        }
+        else if (key == "domains") {
+          _nodes[d].has_domains = true;
+          json.object([&](const std::string & subdomain_tag) {
+              parse_domain(json, subdomain_tag, d);
+            });
+        }
+        else { json.skip_value(); }
+      });
+    auto & node = _nodes[d];
+    if (unit_node.cpu_id      >= 0) { node.cpu_id      = unit_node.cpu_id; }
+    if (unit_node.num_cores   >= 0) { node.num_cores   = unit_node.num_cores; }
+    if (unit_node.num_threads >= 0) { node.num_threads = unit_node.num_threads; }
+    return d;
+  }
+};
+
+#endif // LSLODO__DOMAIN_TREE_H__INCLUDED
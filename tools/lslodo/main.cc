@@ -1,15 +1,35 @@
-
-#include "json.h"
+/*
+ * lslodo - render locality domain hierarchies in JSON format as SVG.
+ *
+ * Usage: lslodo [-f] [-x <domain tag>]... <file.json | ->
+ *
+ *   -f, --fold     Render consecutive sibling domains with identical
+ *                  structure and capacities as a single domain with
+ *                  multiplicity "xN" and the collapsed unit ranges of
+ *                  all folded domains.
+ *   -x, --expand   Do not fold the specified domain, may be repeated.
+ *                  Ancestors of expanded domains are not folded either.
+ *
+ * The input is parsed in a single pass into a compact domain tree that
+ * only holds the properties rendered. Layout is computed in a second
+ * pass over the tree and SVG elements are written to stdout in a third
+ * pass, so memory usage is proportional to the number of domains and
+ * independent of the size of the input and output.
+ */
+#include "domain_tree.h"
 
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_set>
+#include <utility>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 
 
-using json = nlohmann::json;
 using std::cout;
 using std::cerr;
 using std::endl;
@@ -23,7 +43,8 @@ static std::map<std::string, std::string> scope_fills = {
   { "NUMA",    "#c6e9af" },
   { "CACHE",   "#c7dae0" },
   { "GROUP",   "#de8787" },
-  { "CORE",    "#87cdde" }
+  { "CORE",    "#87cdde" },
+  { "UNIT",    "#87cdde" }
 };
 
 static std::map<std::string, std::string> scope_strokes = {
@@ -34,317 +55,215 @@ static std::map<std::string, std::string> scope_strokes = {
   { "NUMA",    "#5aa02c" },
   { "CACHE",   "#83b4c0" },
   { "GROUP",   "#fe9a9a" },
-  { "CORE",    "#287d93" }
+  { "CORE",    "#287d93" },
+  { "UNIT",    "#287d93" }
 };
 
-static std::string fontstyle_regular =
+static const char * fontstyle_regular =
   " style=\"font-family:Lucida Console\" fill=\"#000000\" font-size=\"10\" ";
 
-static std::string fontstyle_bold =
+static const char * fontstyle_bold =
   " style=\"font-family:Lucida Console;font-weight:bold;\" fill=\"#000000\" font-size=\"10\" ";
 
-typedef struct rect_s {
-  int x;
-  int y;
-  int w;
-  int h;
-} rect_t;
-
-typedef struct svg_node_s {
-  rect_t      rect;
-  std::string svg;
-} svg_node_t;
-
-std::string svg_text(
-  const std::string & text,
-  int                 x,
-  int                 y,
-  const std::string & style = fontstyle_regular)
-{
-  std::ostringstream os;
-  os << "<text"
-     << " x=\"" << x << "\""
-     << " y=\"" << y << "\""
-     << style
-     << ">"
-     << text
-     << "</text>" << endl;
-  return os.str();
-}
-
-template <typename T>
-std::string svg_text(
-  const std::string & label,
-  T                   value,
-  int                 x,
-  int                 y,
-  const std::string & style = fontstyle_regular)
-{
-  std::ostringstream os;
-  os << "<text"
-     << " x=\"" << x << "\""
-     << " y=\"" << y << "\""
-     << style
-     << ">"
-     << label << ":" << value
-     << "</text>" << endl;
-  return os.str();
-}
-
-std::string svg_rect(
-  int x,
-  int y,
-  int w,
-  int h,
-  const std::string & fill_color,
-  const std::string & stroke_color,
-  const std::string & attr = "")
-{
-  std::ostringstream os;
-  os << "<rect x=\"" << x << "\" y=\"" << y << "\""
-     << " height=\"" << h << "\" width=\"" << w << "\""
-     << attr
-     << " style=\""
-         << "fill:"   << fill_color   << ";"
-         << "stroke:" << stroke_color << ";"
-         << "stroke-width:1\" >"
-     << "</rect>" << std::endl;
-  return os.str();
-}
-
-std::string render_svg(
-  const std::string & domain_tag,
-  const json &        elem,
-  int                 x,
-  int                 y,
-  int                 w,
-  int                 h,
-  int                 level)
-{
-  std::ostringstream os;
-
-  std::string ind(level * 4, ' ');
-
-  int tpad = 13;
-  int fpad = 10;
+class svg_writer {
+  std::ostream & _os;
+
+ public:
+  explicit svg_writer(std::ostream & os) : _os(os) { }
+
+  void text(
+    const std::string & text,
+    int                 x,
+    int                 y,
+    const char        * style = fontstyle_regular) {
+    _os << "<text"
+        << " x=\"" << x << "\""
+        << " y=\"" << y << "\""
+        << style
+        << ">"
+        << text
+        << "</text>\n";
+  }
 
-  auto scope     = elem.find("scope");
-  auto host      = elem.find("host");
-  auto dom_level = elem.find("level");
+  template <typename T>
+  void text(
+    const std::string & label,
+    T                   value,
+    int                 x,
+    int                 y,
+    const char        * style = fontstyle_regular) {
+    _os << "<text"
+        << " x=\"" << x << "\""
+        << " y=\"" << y << "\""
+        << style
+        << ">"
+        << label << ":" << value
+        << "</text>\n";
+  }
 
-  std::string hostname = "?";
-  if (host != elem.end()) {
-    hostname = *host;
+  void rect(
+    int                 x,
+    int                 y,
+    int                 w,
+    int                 h,
+    const std::string & fill_color,
+    const std::string & stroke_color,
+    const char        * attr = "") {
+    _os << "<rect x=\"" << x << "\" y=\"" << y << "\""
+        << " height=\"" << h << "\" width=\"" << w << "\""
+        << attr
+        << " style=\""
+            << "fill:"   << fill_color   << ";"
+            << "stroke:" << stroke_color << ";"
+            << "stroke-width:1\" >"
+        << "</rect>\n";
   }
 
-  int d_level = -1;
-  if (dom_level != elem.end()) {
-    d_level = *dom_level;
+  /* Writes domains in pre-order, parent domains are drawn first: */
+  void render(const domain_tree & tree, int d = 0, int x = 0, int y = 0) {
+    const auto & node = tree[d];
+    render_domain(tree, node, x + node.rect.x, y + node.rect.y);
+    for (int c = node.first_child; c >= 0; c = tree[c].next_sibling) {
+      if (tree[c].multiplicity > 0) {
+        render(tree, c, x + node.rect.x, y + node.rect.y);
+      }
+    }
   }
 
-  if (scope != elem.end()) {
-    std::string scope_fill   = scope_fills[*scope];
-    std::string scope_stroke = scope_strokes[*scope];
-    std::string scope_name   = *scope;
-    std::string rect_attr    = "";
+ private:
+  static std::string unit_ranges(
+    std::vector<std::pair<int, int> > units) {
+    const size_t max_ranges = 4;
+    std::string  ranges;
+    std::sort(units.begin(), units.end());
+    size_t num_merged = 0;
+    for (size_t r = 0; r < units.size(); ++r) {
+      if (num_merged > 0 &&
+          units[num_merged - 1].second + 1 >= units[r].first) {
+        units[num_merged - 1].second = std::max(units[num_merged - 1].second,
+                                                units[r].second);
+      } else {
+        units[num_merged++] = units[r];
+      }
+    }
+    units.resize(num_merged);
+    for (size_t r = 0; r < units.size() && r < max_ranges; ++r) {
+      if (r > 0) { ranges += ","; }
+      ranges += std::to_string(units[r].first);
+      if (units[r].second > units[r].first) {
+        ranges += "-" + std::to_string(units[r].second);
+      }
+    }
+    if (units.size() > max_ranges) { ranges += ",..."; }
+    return ranges;
+  }
 
+  void render_domain(
+    const domain_tree   & tree,
+    const domain_node_t & node,
+    int                   x,
+    int                   y) {
+    if (node.scope < 0) {
+      return;
+    }
+    const int tpad  = 13;
+    const int fpad  = 10;
+    const int col_0 = 60;
+    const int col_1 = 130;
+
+    std::string scope_name = tree.scope(node);
+    const char * rect_attr = (scope_name == "GROUP") ? " ry=\"8\" " : "";
+    rect(x, y, node.rect.w, node.rect.h,
+         scope_fills[scope_name], scope_strokes[scope_name], rect_attr);
     if (scope_name == "CORE") { scope_name = "UNIT"; }
 
-    int col_0 = 60;
-    int col_1 = 130;
-
-    if (scope_name == "UNIT") {
-      w     = 170;
-      h     = 77;
-    }
-    if (scope_name == "GROUP") {
-      rect_attr = " ry=\"8\" ";
+    text(scope_name, x + tpad, y + tpad + fpad, fontstyle_bold);
+    text("L", node.level, x + tpad + col_0, y + tpad + fpad);
+    text(std::string("[") + node.tag + "]", x + tpad, y + (tpad * 2) + fpad);
+    if (node.multiplicity > 1) {
+      text(std::string("&#215;") + std::to_string(node.multiplicity),
+           x + tpad + col_0 + 40, y + (tpad * 2) + fpad, fontstyle_bold);
+      text("units:" + unit_ranges(node.units),
+           x + tpad + (scope_name == "UNIT" ? 0 : col_1),
+           y + (scope_name == "UNIT" ? tpad * 5 + fpad + 7
+                                     : tpad * 3 + fpad));
     }
-    os << ind << svg_rect(x, y, w, h, scope_fill, scope_stroke, rect_attr);
-    os << ind << svg_text(scope_name,
-                          x + tpad, y + tpad + fpad, fontstyle_bold);
-    os << ind << svg_text("L", d_level,
-                          x + tpad + col_0, y + tpad + fpad);
-    os << ind << svg_text(std::string("[") + domain_tag + "]",
-                          x + tpad, y + (tpad * 2) + fpad);
 
-    auto elem_hwinfo = elem.find("hwinfo");
-    std::ostringstream shared_mem_kb;
-    if (elem_hwinfo != elem.end()) {
-       auto hwinfo_shared_mem_kb = elem_hwinfo->find("shmem");
-       if (hwinfo_shared_mem_kb != elem_hwinfo->end()) {
-         shared_mem_kb << *hwinfo_shared_mem_kb << " KB";
-       }
+    std::string shared_mem_kb;
+    if (node.shmem_kb >= 0) {
+      shared_mem_kb = std::to_string(node.shmem_kb) + " KB";
     }
-
     if (scope_name == "NODE" || scope_name == "MODULE") {
-      std::ostringstream system_mb;
-      system_mb << shared_mem_kb.str();
-      os << ind << svg_text(std::string("host:") + hostname,
-                            x + tpad + col_1, y + tpad + fpad);
-      os << ind << svg_text(system_mb.str(),
-                            x + tpad, y + tpad * 3 + fpad);
+      text(std::string("host:") + tree.host(node),
+           x + tpad + col_1, y + tpad + fpad);
+      text(shared_mem_kb, x + tpad, y + tpad * 3 + fpad);
     }
     if (scope_name == "NUMA") {
-      std::ostringstream numa_mb;
-      numa_mb << shared_mem_kb.str();
-      int numa_id = -1;
-      if (elem_hwinfo != elem.end() &&
-          elem_hwinfo->find("numa_id") != elem_hwinfo->end()) {
-        numa_id = (*elem_hwinfo)["numa_id"];
-      }
-      os << ind << svg_text("id", numa_id,
-                            x + tpad + col_1, y + tpad + fpad);
-      os << ind << svg_text(numa_mb.str(),
-                            x + tpad, y + tpad * 3 + fpad);
+      text("id", node.numa_id, x + tpad + col_1, y + tpad + fpad);
+      text(shared_mem_kb, x + tpad, y + tpad * 3 + fpad);
     }
     if (scope_name == "CACHE") {
-      std::ostringstream cache_size;
-      cache_size << shared_mem_kb.str();
-      os << ind << svg_text(cache_size.str(),
-                            x + tpad, y + tpad * 3 + fpad);
+      text(shared_mem_kb, x + tpad, y + tpad * 3 + fpad);
     }
     if (scope_name == "UNIT") {
-      int ncores   = elem["unit_locality"]["hwinfo"]["num_cores"];
-      int nthreads = elem["unit_locality"]["hwinfo"]["threads"]["max"];
-      int cpu_id   = elem["unit_locality"]["hwinfo"]["cpu_id"];
-      int unit_id  = elem["unit_id"]["local_id"];
-
-      os << ind << svg_text("id", unit_id,
-                            x + tpad, y + tpad * 3 + fpad + 7);
-      os << ind << svg_text("CPU", cpu_id,
-                            x + tpad + 60, y + tpad * 3 + fpad + 7);
-      os << ind << svg_text("cores", ncores,
-                            x + tpad, y + tpad * 4 + fpad + 7);
-      os << ind << svg_text("t/c", nthreads,
-                            x + tpad + 60, y + tpad * 4 + fpad + 7);
+      text("id",    node.unit_id,     x + tpad,      y + tpad * 3 + fpad + 7);
+      text("CPU",   node.cpu_id,      x + tpad + 60, y + tpad * 3 + fpad + 7);
+      text("cores", node.num_cores,   x + tpad,      y + tpad * 4 + fpad + 7);
+      text("t/c",   node.num_threads, x + tpad + 60, y + tpad * 4 + fpad + 7);
     }
   }
+};
 
-  return os.str();
-}
-
-svg_node_t render_domain(
-  const std::string & domain_tag,
-  const json &        elem,
-  int                 x,
-  int                 y,
-  int                 level = 0)
+int main(int argc, char * argv[])
 {
-  int w = 0;
-  int h = 0;
-
-  int pad  = 11;
-
-  std::string ind(level * 4, ' ');
-  std::ostringstream os;
-
-  if (elem.is_object()) {
-    auto scope    = elem.find("scope");
-    auto domains  = elem.find("domains");
-    bool vertical = true;
-    bool nested   = true;
-    if (domains != elem.end()) {
-      auto ndomains = std::distance(domains->begin(), domains->end());
-      if (scope != elem.end() &&
-          (*scope == "NUMA" || *scope == "CACHE" || *scope == "PACKAGE")) {
-        vertical = false;
-      }
-      if (scope != elem.end() && (*scope == "CACHE") && ndomains > 0) {
-        nested = false;
-      }
-      int  d_idx = 0;
-      for (auto d = domains->begin(); d != domains->end(); ++d) {
-        int d_x = x;
-        int d_y = y;
-
-        if (nested) {
-          if (vertical) {
-            d_x += pad;
-            d_y += h + 60;
-          } else {
-            d_x += w + pad;
-            d_y += 60;
-          }
-        } else {
-          // draw stacked domains, horizontal
-          d_x += w;
-          d_y += 60;
-        }
-
-        auto svg_node = render_domain(d.key(), d.value(),
-                                      d_x, d_y,
-                                      level+1);
-        if (nested) {
-          // draw nested domains
-          if (vertical) {
-            h += svg_node.rect.h + (d_idx < ndomains - 1 ? pad : 0);
-            w  = std::max(w, svg_node.rect.w);
-          } else {
-            w += svg_node.rect.w + (d_idx < ndomains - 1 ? pad : 0);
-            h  = std::max(h, svg_node.rect.h);
-          }
-        } else {
-          // draw stacked domains, horizontal
-          w += svg_node.rect.w + (d_idx < ndomains - 1 ? pad : 0);
-          h  = std::max(h, svg_node.rect.h);
-        }
-        os << svg_node.svg;
-        d_idx++;
-      }
-      if (nested) {
-        w += 2 * pad;
-        h += 60 + pad;
-      } else {
-        h += 60;
-      }
-    }
-    else if (scope != elem.end() && *scope == "CORE") {
-      w = 170;
-      h = 77;
+  bool                            fold_domains = false;
+  std::unordered_set<std::string> expand_tags;
+  std::string                     loc_json_file;
+  for (int a = 1; a < argc; ++a) {
+    std::string arg(argv[a]);
+    if (arg == "-f" || arg == "--fold") {
+      fold_domains = true;
+    } else if ((arg == "-x" || arg == "--expand") && a + 1 < argc) {
+      expand_tags.insert(argv[++a]);
+    } else {
+      loc_json_file = arg;
     }
   }
-
-  rect_t     rect;
-  svg_node_t node;
-  rect.w    = w;
-  rect.h    = h;
-  node.rect = rect;
-  node.svg  = render_svg(domain_tag, elem, x, y, rect.w, rect.h, level) +
-              os.str();
-
-  return node;
-}
-
-int main(int argc, char * argv[])
-{
-  if (argc < 2) {
+  if (loc_json_file.empty()) {
     cerr << "no filename specified" << endl;
     return EXIT_FAILURE;
   }
 
-  std::string   loc_json_file(argv[1]);
-  std::ifstream loc_json_ifs(loc_json_file);
-  if (!loc_json_ifs.is_open()) {
+  std::FILE * loc_json_fp = (loc_json_file == "-")
+                            ? stdin
+                            : std::fopen(loc_json_file.c_str(), "rb");
+  if (loc_json_fp == nullptr) {
     cerr << "could not read file " << loc_json_file << endl;
     return EXIT_FAILURE;
   }
-  std::string line;
-  std::string loc_json_str;
-  while (getline(loc_json_ifs, line)) {
-    loc_json_str += line;
-  }
-  loc_json_ifs.close();
 
-  auto loc_hierarchy = json::parse(loc_json_str);
+  domain_tree loc_hierarchy;
+  json_reader json(loc_json_fp);
+  loc_hierarchy.read(json);
+  if (loc_json_fp != stdin) {
+    std::fclose(loc_json_fp);
+  }
+  if (fold_domains) {
+    loc_hierarchy.fold(expand_tags);
+  }
+  loc_hierarchy.layout();
 
-  std::ostringstream os;
-  os << "<svg xmlns=\"http://www.w3.org/2000/svg\"";
-  os << " xmlns:xlink=\"http://www.w3.org/1999/xlink\">\n";
+  std::ios::sync_with_stdio(false);
+  const auto & root = loc_hierarchy[0];
+  cout << "<svg xmlns=\"http://www.w3.org/2000/svg\""
+       << " xmlns:xlink=\"http://www.w3.org/1999/xlink\""
+       << " width=\"" << root.rect.w + 1 << "\""
+       << " height=\"" << root.rect.h + 1 << "\">\n";
 
-  os << render_domain(".", loc_hierarchy, 0, 0, 0).svg;
+  svg_writer(cout).render(loc_hierarchy);
 
-  cout << os.str() << endl;
+  cout << "</svg>" << endl;
 
   return EXIT_SUCCESS;
 }
+